@@ -5,4 +5,7 @@ set cl_flags=-Oi -Z7 -nologo -O2 -GR- -Gm- -EHa- -W3 -wd4505 -wd4100 -wd4189 -WX
 set link_flags=-SUBSYSTEM:WINDOWS -opt:ref -KEYFILE:"cert.pfx"
 set libs=user32.lib gdi32.lib xaudio2.lib xinput.lib Icons.res
 
-cl src\pilot.cpp %cl_flags% -Fe:pilot.exe -link %linker_flags% %libs%
\ No newline at end of file
+cl src\pilot.cpp %cl_flags% -Fe:pilot.exe -link %linker_flags% %libs%
+cl src\packer.cpp -nologo -O2 -D_CRT_SECURE_NO_WARNINGS -Fe:packer.exe
+cl src\replay.cpp -nologo -O2 -D_CRT_SECURE_NO_WARNINGS -Fe:replay.exe
+cl src\tests.cpp -nologo -O2 -D_CRT_SECURE_NO_WARNINGS -Fe:tests.exe
\ No newline at end of file
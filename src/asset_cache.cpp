@@ -0,0 +1,201 @@
+// NOTE: Uitleg asset cache.
+// Elk plaatje en geluid dat we via de cache laden staat er maar een keer in, op naam. Vraag je een
+// asset aan die er al is, dan krijg je een handle naar dezelfde en gaat ref_count omhoog. Met
+// release_asset gaat hij weer omlaag, en de laatste die loslaat geeft het geheugen vrij. Net als
+// bij de loader bevat een handle een generation, zodat een oude handle niks meer doet.
+//
+// De loader thread gebruikt de cache ook, dus alles loopt via lock. Het laden zelf gebeurt buiten
+// lock, zodat de game nooit op een andere thread hoeft te wachten. Vragen twee threads tegelijk
+// hetzelfde bestand aan, dan wacht de tweede tot de eerste klaar is.
+//
+// De sprites die in de atlas komen (zie pack_sprite_atlas) laden we een keer bij het opstarten en
+// houden we tot het einde, die gaan niet via de cache.
+#define MAX_ASSETS 64
+#define ASSET_FILENAME_SIZE 128
+
+enum Asset_Type {
+    ASSET_SPRITE = 1,
+    ASSET_WAVE = 2,
+};
+
+struct Asset_Handle {
+    u32 index;
+    u32 generation;
+};
+
+struct Asset {
+    char filename[ASSET_FILENAME_SIZE];
+    u32 type;
+    // Dezelfde bitmap met of zonder spans of verkleinen zijn verschillende assets.
+    u32 variant;
+    u32 ref_count;
+    u32 generation;
+    volatile LONG loading;
+    // Het geheugen dat deze asset zelf heeft, dingen uit het pack tellen niet mee.
+    u64 bytes;
+
+    Sprite sprite;
+
+    WAVEFORMATEX format;
+    XAUDIO2_BUFFER buffer;
+    // Het geheugen van een los gelezen wave, 0 als het geluid uit het pack komt.
+    void *memory;
+};
+
+struct Asset_Cache {
+    Asset assets[MAX_ASSETS];
+    CRITICAL_SECTION lock;
+
+    u32 live_count;
+    u64 live_bytes;
+};
+
+static Asset_Cache asset_cache;
+
+static void initialize_asset_cache() {
+    InitializeCriticalSection(&asset_cache.lock);
+}
+
+// Hoeveel geheugen een sprite zelf heeft. Een sprite uit het pack of de atlas heeft geen eigen
+// pixels, maar kan wel eigen spans hebben.
+static u64 get_sprite_bytes(Sprite *sprite) {
+    u64 bytes = 0;
+    if (sprite->memory) {
+        bytes += (u64)sprite->pitch * sprite->height * sizeof(u32);
+    }
+    if (sprite->row_spans) {
+        bytes += (u64)(sprite->height + 1) * sizeof(u32) +
+                 (u64)sprite->row_spans[sprite->height] * sizeof(Sprite_Span);
+    }
+    return bytes;
+}
+
+static Asset *get_asset(Asset_Handle handle) {
+    if ((handle.generation == 0) || (handle.index >= MAX_ASSETS)) return 0;
+
+    Asset *asset = asset_cache.assets + handle.index;
+    if ((asset->ref_count == 0) || (asset->generation != handle.generation)) return 0;
+    return asset;
+}
+
+// Zoek de asset op of maak een nieuwe plek. Bij een nieuwe plek is is_new true, en moet de
+// aanroeper hem laden en daarna finish_asset aanroepen.
+static Asset *acquire_asset(const char *filename, u32 type, u32 variant, Asset_Handle *handle,
+                            bool *is_new) {
+    *handle = {};
+    *is_new = false;
+
+    EnterCriticalSection(&asset_cache.lock);
+    Asset *found = 0;
+    Asset *free_asset = 0;
+    for (u32 i = 0; i < MAX_ASSETS; i++) {
+        Asset *asset = asset_cache.assets + i;
+        if (asset->ref_count == 0) {
+            if (!free_asset) free_asset = asset;
+        } else if ((asset->type == type) && (asset->variant == variant) &&
+                   pack_names_equal(asset->filename, filename)) {
+            found = asset;
+            break;
+        }
+    }
+
+    if (found) {
+        found->ref_count++;
+    } else if (free_asset) {
+        found = free_asset;
+        u32 generation = found->generation + 1;
+        *found = {};
+        StringCbCopyA(found->filename, ASSET_FILENAME_SIZE, filename);
+        found->type = type;
+        found->variant = variant;
+        found->ref_count = 1;
+        found->generation = generation ? generation : 1;
+        found->loading = 1;
+        asset_cache.live_count++;
+        *is_new = true;
+    }
+
+    if (found) {
+        handle->index = (u32)(found - asset_cache.assets);
+        handle->generation = found->generation;
+    }
+    LeaveCriticalSection(&asset_cache.lock);
+
+    if (!found) {
+        report_load_error("Asset cache", "De asset cache zit vol!", filename);
+        return 0;
+    }
+
+    // Een andere thread is hem nog aan het laden.
+    if (!*is_new) {
+        while (found->loading) {
+            Sleep(0);
+        }
+    }
+    return found;
+}
+
+static void finish_asset(Asset *asset, u64 bytes) {
+    EnterCriticalSection(&asset_cache.lock);
+    asset->bytes = bytes;
+    asset_cache.live_bytes += bytes;
+    asset->loading = 0;
+    LeaveCriticalSection(&asset_cache.lock);
+}
+
+static void release_asset(Asset_Handle *handle) {
+    EnterCriticalSection(&asset_cache.lock);
+    Asset *asset = get_asset(*handle);
+    if (asset && (--asset->ref_count == 0)) {
+        if (asset->type == ASSET_SPRITE) {
+            free_sprite(&asset->sprite);
+        } else if (asset->memory) {
+            VirtualFree(asset->memory, 0, MEM_RELEASE);
+        }
+        asset_cache.live_count--;
+        asset_cache.live_bytes -= asset->bytes;
+
+        // Bewaar alleen de generation, zodat de volgende asset op deze plek een nieuwe krijgt.
+        u32 generation = asset->generation;
+        *asset = {};
+        asset->generation = generation;
+    }
+    LeaveCriticalSection(&asset_cache.lock);
+    *handle = {};
+}
+
+// Laad een bitmap via de cache, met dezelfde opties als load_bitmap.
+static Asset_Handle acquire_sprite(const char *filename, bool build_spans = false,
+                                   bool scale = true) {
+    Asset_Handle handle;
+    bool is_new;
+    u32 variant = (build_spans ? 1 : 0) | (scale ? 2 : 0);
+    Asset *asset = acquire_asset(filename, ASSET_SPRITE, variant, &handle, &is_new);
+    if (asset && is_new) {
+        asset->sprite = load_bitmap(filename, build_spans, scale);
+        finish_asset(asset, get_sprite_bytes(&asset->sprite));
+    }
+    return handle;
+}
+
+// Job voor run_jobs: laad een bitmap alvast in de cache. destination is een Asset_Handle.
+static void acquire_sprite_job(Job *job) {
+    *(Asset_Handle *)job->destination = acquire_sprite(
+        job->filename, (job->flags & JOB_BUILD_SPANS) != 0, (job->flags & JOB_NO_SCALE) == 0);
+}
+
+// Geeft 0 terug als de handle niet (meer) klopt of als de bitmap niet geladen kon worden.
+static Sprite *get_sprite(Asset_Handle handle) {
+    Asset *asset = get_asset(handle);
+    if (!asset || (asset->type != ASSET_SPRITE) || !asset->sprite.pixels) return 0;
+    return &asset->sprite;
+}
+
+static void log_asset_cache(const char *when) {
+    EnterCriticalSection(&asset_cache.lock);
+    char text[256];
+    StringCbPrintfA(text, 256, "Assets (%s): %u in gebruik, %lluKB\n", when,
+                    asset_cache.live_count, asset_cache.live_bytes / 1024);
+    LeaveCriticalSection(&asset_cache.lock);
+    OutputDebugStringA(text);
+}
@@ -21,6 +21,8 @@ static void close_audio(Audio *audio) {
 struct Sound {
     IXAudio2SourceVoice *source;
     XAUDIO2_BUFFER buffer;
+    // De samples staan in de asset cache, zodat twee Sounds van hetzelfde bestand ze delen.
+    Asset_Handle wave;
 };
 
 #pragma pack(push, 1)
@@ -42,47 +44,126 @@ struct Wave_Header {
 };
 #pragma pack(pop)
 
-static Sound load_sound(Audio *audio, const char *filename, bool loop = false) {
-    Sound sound = {};
+// XAudio2 leest de samples in blokken van nBlockAlign bytes, dus die moeten er precies in passen.
+static bool is_valid_wave(WAVEFORMATEX *format, u64 audio_bytes) {
+    return (format->nChannels > 0) && (format->wBitsPerSample > 0) &&
+           (format->nBlockAlign == format->nChannels * format->wBitsPerSample / 8) &&
+           (audio_bytes > 0) && (audio_bytes <= 0xFFFFFFFF) &&
+           (audio_bytes % format->nBlockAlign == 0);
+}
 
+// Lees een losse wave van de schijf en zoek het formaat en de samples. memory moet met VirtualFree
+// worden vrijgegeven als het geluid niet meer nodig is.
+static bool read_wave_file(const char *filename, WAVEFORMATEX *format, XAUDIO2_BUFFER *buffer,
+                           void **memory) {
     HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
                               FILE_ATTRIBUTE_NORMAL, 0);
     if (file == INVALID_HANDLE_VALUE) {
-        MessageBoxA(0, "[ERROR]: Kan geluidsbestand niet laden!", "Audio laden", MB_OK);
-        return sound;
+        report_load_error("Audio laden", "[ERROR]: Kan geluidsbestand niet laden!", filename);
+        return false;
     }
 
     LARGE_INTEGER file_size;
-    if (!GetFileSizeEx(file, &file_size)) {
-        MessageBoxA(0, "[ERROR]: Kon de grootte niet opvragen!", "Audio laden", MB_OK);
-        return sound;
+    if (!GetFileSizeEx(file, &file_size) || (file_size.QuadPart < (i64)sizeof(Wave_Header))) {
+        report_load_error("Audio laden", "[ERROR]: Kon de grootte niet opvragen!", filename);
+        CloseHandle(file);
+        return false;
     }
-    void *memory = VirtualAlloc(0, file_size.QuadPart, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-    if (!ReadFile(file, memory, (u32)file_size.QuadPart, 0, 0)) {
-        MessageBoxA(0, "[ERROR]: Kon afbeelding niet laden!", "Audio laden", MB_OK);
-        return sound;
+    *memory = VirtualAlloc(0, file_size.QuadPart, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    bool read = ReadFile(file, *memory, (u32)file_size.QuadPart, 0, 0);
+    CloseHandle(file);
+    if (!read) {
+        report_load_error("Audio laden", "[ERROR]: Kon afbeelding niet laden!", filename);
+        VirtualFree(*memory, 0, MEM_RELEASE);
+        *memory = 0;
+        return false;
     }
-    WAVEFORMATEX format = {0};
-    XAUDIO2_BUFFER buffer = {0};
 
-    Wave_Header *header = (Wave_Header *)memory;
+    Wave_Header *header = (Wave_Header *)*memory;
 
-    format.wFormatTag = WAVE_FORMAT_PCM;
-    format.nChannels = header->number_channels;
-    format.nSamplesPerSec = header->samples_per_sec;
-    format.nAvgBytesPerSec = header->bytes_per_sec;
-    format.nBlockAlign = header->block_align;
-    format.wBitsPerSample = header->bits_per_sample;
+    format->wFormatTag = WAVE_FORMAT_PCM;
+    format->nChannels = header->number_channels;
+    format->nSamplesPerSec = header->samples_per_sec;
+    format->nAvgBytesPerSec = header->bytes_per_sec;
+    format->nBlockAlign = header->block_align;
+    format->wBitsPerSample = header->bits_per_sample;
 
-    u8 *data_chunk = (u8 *)memory + sizeof(Wave_Header);
-    u32 data_id = *(u32 *)data_chunk;
-    while (data_id != 'atad') {
+    // Zoek de data chunk, maar lees niet voorbij het einde van het bestand.
+    u8 *data_chunk = (u8 *)*memory + sizeof(Wave_Header);
+    u8 *data_end = (u8 *)*memory + file_size.QuadPart - 8;
+    while ((data_chunk <= data_end) && (*(u32 *)data_chunk != 'atad')) {
         data_chunk++;
-        data_id = *(u32 *)data_chunk;
     }
+    if ((data_chunk > data_end) || (*(u32 *)(data_chunk + 4) > (u64)(data_end - data_chunk))) {
+        report_load_error("Audio laden", "[ERROR]: Geen samples in het geluidsbestand!",
+                          filename);
+        VirtualFree(*memory, 0, MEM_RELEASE);
+        *memory = 0;
+        return false;
+    }
+
+    buffer->AudioBytes = *(u32 *)(data_chunk + 4);
+    buffer->pAudioData = (BYTE *)(data_chunk + 8);
+    if (!is_valid_wave(format, buffer->AudioBytes)) {
+        report_load_error("Audio laden", "[ERROR]: Het formaat van de samples klopt niet!",
+                          filename);
+        VirtualFree(*memory, 0, MEM_RELEASE);
+        *memory = 0;
+        return false;
+    }
+    return true;
+}
+
+// Laad de samples van een wave via de asset cache. Uit het asset pack wijzen we direct naar de
+// samples in het bestand, zie pack.cpp.
+static Asset_Handle acquire_wave(const char *filename) {
+    Asset_Handle handle;
+    bool is_new;
+    Asset *asset = acquire_asset(filename, ASSET_WAVE, 0, &handle, &is_new);
+    if (!asset || !is_new) return handle;
+
+    Pack_Entry *entry = find_pack_entry(asset_pack.header, filename, PACK_SOUND);
+    if (entry) {
+        asset->format.wFormatTag = WAVE_FORMAT_PCM;
+        asset->format.nChannels = entry->channels;
+        asset->format.nSamplesPerSec = entry->samples_per_sec;
+        asset->format.nAvgBytesPerSec = entry->bytes_per_sec;
+        asset->format.nBlockAlign = entry->block_align;
+        asset->format.wBitsPerSample = entry->bits_per_sample;
+
+        if (is_valid_wave(&asset->format, entry->size)) {
+            asset->buffer.AudioBytes = (u32)entry->size;
+            asset->buffer.pAudioData = (BYTE *)get_pack_data(asset_pack.header, entry);
+        } else {
+            report_load_error("Audio laden", "[ERROR]: Het geluid in het pack is kapot!",
+                              filename);
+        }
+        finish_asset(asset, 0);
+    } else if (read_wave_file(filename, &asset->format, &asset->buffer, &asset->memory)) {
+        finish_asset(asset, asset->buffer.AudioBytes);
+    } else {
+        finish_asset(asset, 0);
+    }
+    return handle;
+}
+
+// Job voor run_jobs: laad de samples alvast in de asset cache, zodat load_sound ze daarna alleen
+// nog hoeft op te zoeken. destination is een Asset_Handle.
+static void acquire_wave_job(Job *job) {
+    *(Asset_Handle *)job->destination = acquire_wave(job->filename);
+}
+
+static Sound load_sound(Audio *audio, const char *filename, bool loop = false) {
+    Sound sound = {};
+
+    sound.wave = acquire_wave(filename);
+    Asset *wave = get_asset(sound.wave);
+    if (!wave || !wave->buffer.pAudioData) {
+        return sound;
+    }
+    WAVEFORMATEX format = wave->format;
+    XAUDIO2_BUFFER buffer = wave->buffer;
 
-    buffer.AudioBytes = *(u32 *)(data_chunk + 4);
-    buffer.pAudioData = (BYTE *)(data_chunk + 8);
     buffer.Flags = XAUDIO2_END_OF_STREAM;
     if (loop)
         buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
@@ -0,0 +1,584 @@
+// NOTE: Uitleg blitter.
+// De Offscreen_Buffer en het tekenen van sprites daarin: de rij-kernels, de blit varianten en de
+// dirty rects. Net als walls.cpp gebruikt dit bestand geen Windows functies (behalve de PROFILE
+// tellers), zodat tests.cpp de SIMD kernels ook zonder scherm en op Linux met de scalar kernel kan
+// vergelijken. Het laden van sprites en de render queue staan in draw.cpp.
+
+// Geheugen dat altijd met nullen gevuld is. Net als get_level_chunk in sim.cpp maakt de includer
+// deze: draw.cpp met VirtualAlloc, tests.cpp met calloc.
+static void *allocate_pages(u64 size);
+static void free_pages(void *memory);
+
+struct Rect {
+    i32 min_x, min_y;
+    i32 max_x, max_y;
+};
+
+#define MAX_DIRTY_RECTS 16
+
+struct Offscreen_Buffer {
+#ifdef _WIN32
+    // Voor StretchDIBits, zie resize_buffer.
+    BITMAPINFO info;
+#endif
+    void *memory;
+    u32 width, height;
+    i8 bytes_per_pixel;
+    i32 pitch;
+
+    // De stukken van de buffer die veranderd zijn sinds we de buffer voor het laatst op het
+    // scherm hebben gezet. Als all_dirty aan staat moet de hele buffer opnieuw.
+    Rect dirty_rects[MAX_DIRTY_RECTS];
+    u32 dirty_count;
+    bool all_dirty;
+};
+
+static void resize_buffer(Offscreen_Buffer *buffer, Vector2i dimensions) {
+    // Eerst moeten we het geheugen van de buffer legen als hier al iets in staat.
+    if (buffer->memory) {
+        free_pages(buffer->memory);
+    }
+
+    // Vul de buffer met de nieuwe informatie, voornamelijk de breedte en hoogte.
+    buffer->width = dimensions.x;
+    buffer->height = dimensions.y;
+
+#ifdef _WIN32
+    buffer->info.bmiHeader.biSize = sizeof(buffer->info.bmiHeader);
+    buffer->info.bmiHeader.biWidth = buffer->width;
+    buffer->info.bmiHeader.biHeight = buffer->height;
+    buffer->info.bmiHeader.biPlanes = 1;
+    buffer->info.bmiHeader.biBitCount = 32;
+    buffer->info.bmiHeader.biCompression = BI_RGB;
+#endif
+
+    // 4 bytes per pixel aangezien de bitcount ook op 32 bits staat.
+    buffer->bytes_per_pixel = 4;
+    // Dit is de totale buffer grootte.
+    i32 bitmap_memory_size = buffer->bytes_per_pixel * buffer->width * buffer->height;
+
+    // Alloc het geheugen zodat we het kunnen gaan gebruiken.
+    buffer->memory = allocate_pages(bitmap_memory_size);
+
+    // Dit is een rij aan pixels, dit kunnen we gebruiken om makelijker naar een bepaalde rij te
+    // gaan.
+    buffer->pitch = buffer->width * buffer->bytes_per_pixel;
+
+    buffer->dirty_count = 0;
+    buffer->all_dirty = true;
+}
+
+// Een reeks niet-transparante pixels op een rij van een sprite.
+struct Sprite_Span {
+    u16 start;
+    u16 length;
+};
+
+struct Sprite {
+    u32 *pixels;
+    u32 width;
+    u32 height;
+    u16 bits_per_pixel;
+    // Hoeveel pixels er tussen het begin van twee rijen zitten. Dit is meer dan width als de
+    // sprite in een atlas staat (zie pack_sprite_atlas).
+    u32 pitch;
+    // Het geheugen dat free_sprite vrijgeeft, of 0 als de pixels van een atlas zijn.
+    void *memory;
+    // Teken de sprite gespiegeld (links en rechts omgedraaid), zie mirror_sprite.
+    bool mirror_x;
+    // Geen enkele pixel is transparant, dan kunnen we de rijen gewoon kopieren. Dit bepaalt
+    // load_bitmap.
+    bool opaque;
+
+    // Optioneel, zie build_sprite_spans. De spans van rij y zijn spans[row_spans[y]] tot
+    // spans[row_spans[y + 1]]. De trim waardes geven het kleinste rechthoekje aan waar alle
+    // niet-transparante pixels in liggen.
+    Sprite_Span *spans;
+    u32 *row_spans;
+    u32 trim_min_x, trim_min_y, trim_max_x, trim_max_y;
+};
+
+// NOTE: Uitleg spans.
+// De meeste sprites bestaan voor een groot deel uit transparante pixels. In plaats van elke keer
+// dat we de sprite tekenen elke pixel te testen, slaan we bij het laden per rij op waar de
+// niet-transparante stukken (spans) beginnen en hoe lang ze zijn. Bij het tekenen kunnen we die
+// stukken dan in een keer kopieren en de rest overslaan.
+static void build_sprite_spans(Sprite *sprite) {
+    // Eerst tellen we hoeveel spans er zijn, zodat we alles in een keer kunnen allocen.
+    u32 span_count = 0;
+    for (u32 y = 0; y < sprite->height; y++) {
+        u32 *row = sprite->pixels + y * sprite->pitch;
+        bool inside = false;
+        for (u32 x = 0; x < sprite->width; x++) {
+            bool opaque = (row[x] >> 24) != 0;
+            if (opaque && !inside) span_count++;
+            inside = opaque;
+        }
+    }
+
+    u32 row_bytes = sizeof(u32) * (sprite->height + 1);
+    void *memory = allocate_pages(row_bytes + sizeof(Sprite_Span) * span_count);
+    if (!memory) return;
+
+    sprite->row_spans = (u32 *)memory;
+    sprite->spans = (Sprite_Span *)((u8 *)memory + row_bytes);
+
+    sprite->trim_min_x = sprite->width;
+    sprite->trim_min_y = sprite->height;
+    sprite->trim_max_x = 0;
+    sprite->trim_max_y = 0;
+
+    Sprite_Span *span = sprite->spans;
+    for (u32 y = 0; y < sprite->height; y++) {
+        sprite->row_spans[y] = (u32)(span - sprite->spans);
+
+        u32 *row = sprite->pixels + y * sprite->pitch;
+        u32 x = 0;
+        while (x < sprite->width) {
+            if ((row[x] >> 24) == 0) {
+                x++;
+                continue;
+            }
+
+            u32 start = x;
+            while ((x < sprite->width) && ((row[x] >> 24) != 0)) {
+                x++;
+            }
+
+            span->start = (u16)start;
+            span->length = (u16)(x - start);
+            span++;
+
+            sprite->trim_min_x = minimum(sprite->trim_min_x, start);
+            sprite->trim_max_x = maximum(sprite->trim_max_x, x);
+            sprite->trim_min_y = minimum(sprite->trim_min_y, y);
+            sprite->trim_max_y = y + 1;
+        }
+    }
+    sprite->row_spans[sprite->height] = span_count;
+}
+
+static bool is_sprite_opaque(Sprite *sprite) {
+    for (u32 y = 0; y < sprite->height; y++) {
+        u32 *row = sprite->pixels + y * sprite->pitch;
+        for (u32 x = 0; x < sprite->width; x++) {
+            if ((row[x] >> 24) == 0) return false;
+        }
+    }
+    return true;
+}
+
+// NOTE: Uitleg rij-kernels.
+// Een sprite tekenen komt neer op het kopieren van een aantal rijen pixels, waarbij we de
+// transparante pixels overslaan. Dat doen we per rij met een kernel. De scalar kernel is de
+// referentie, de SSE2 en AVX2 kernels doen hetzelfde maar dan 4 of 8 pixels tegelijk. Welke we
+// gebruiken bepalen we een keer bij het opstarten met initialize_blitter.
+typedef void Blit_Row(u32 *dest, u32 *source, i32 count);
+
+static void blit_row_scalar(u32 *dest, u32 *source, i32 count) {
+    for (i32 x = 0; x < count; x++) {
+        // NOTE(Kay Verbruggen): Uitleg alpha kanaal.
+        // Als het alpha kanaal 0 is, betekent dit dat de pixel transparant hoort te zijn.
+        // Daarom slaan we deze pixel over en gaan we door naar de volgende. Om het alpha kanaal
+        // te lezen, moeten we de source pixel 24 bits naar rechts schuiven, zodat we de RGB
+        // waardes als het waren uit de variabele hebben geschoven. Dan hebben we dus alleen nog
+        // maar de alpha waarde.
+        // AA RR GG BB (elk kleurkanaal 8 bits) 24 bits naar rechts -> 00 00 00 AA. Dus alleen
+        // de alpha waarde blijft over.
+        if (*source >> 24 == 0) {
+            dest++;
+            source++;
+        } else {
+            *dest++ = *source++;
+        }
+    }
+}
+
+// NOTE: Uitleg SSE2 kernel.
+// We maken een masker waarin elke transparante pixel 0xFFFFFFFF is en elke andere pixel 0. Met dat
+// masker kiezen we per pixel de oude waarde uit de buffer of de nieuwe uit de sprite, zonder if.
+// Als alle 4 de pixels transparant zijn hoeven we helemaal niks te schrijven.
+static void blit_row_sse2(u32 *dest, u32 *source, i32 count) {
+    __m128i zero = _mm_setzero_si128();
+
+    for (; count >= 4; count -= 4) {
+        __m128i src = _mm_loadu_si128((__m128i *)source);
+        __m128i transparent = _mm_cmpeq_epi32(_mm_srli_epi32(src, 24), zero);
+
+        if (_mm_movemask_epi8(transparent) != 0xFFFF) {
+            __m128i dst = _mm_loadu_si128((__m128i *)dest);
+            __m128i result =
+                _mm_or_si128(_mm_and_si128(transparent, dst), _mm_andnot_si128(transparent, src));
+            _mm_storeu_si128((__m128i *)dest, result);
+        }
+
+        dest += 4;
+        source += 4;
+    }
+
+    blit_row_scalar(dest, source, count);
+}
+
+// Hetzelfde als de SSE2 kernel, maar dan met 8 pixels tegelijk.
+TARGET_AVX2 static void blit_row_avx2(u32 *dest, u32 *source, i32 count) {
+    __m256i zero = _mm256_setzero_si256();
+
+    for (; count >= 8; count -= 8) {
+        __m256i src = _mm256_loadu_si256((__m256i *)source);
+        __m256i transparent = _mm256_cmpeq_epi32(_mm256_srli_epi32(src, 24), zero);
+
+        if (_mm256_movemask_epi8(transparent) != -1) {
+            __m256i dst = _mm256_loadu_si256((__m256i *)dest);
+            _mm256_storeu_si256((__m256i *)dest, _mm256_blendv_epi8(src, dst, transparent));
+        }
+
+        dest += 8;
+        source += 8;
+    }
+
+    // Voorkom dat de SSE code na deze functie langzamer wordt door de halve AVX registers.
+    _mm256_zeroupper();
+    blit_row_sse2(dest, source, count);
+}
+
+// NOTE: Uitleg gespiegelde kernels.
+// Deze kernels doen hetzelfde als de gewone, maar lezen de source van rechts naar links: source
+// wijst naar de laatste pixel en die komt op dest[0]. De SIMD versies laden 4 of 8 pixels en
+// draaien ze in het register om met een shuffle.
+static void blit_row_reverse_scalar(u32 *dest, u32 *source, i32 count) {
+    for (i32 x = 0; x < count; x++) {
+        if (*source >> 24 != 0) {
+            *dest = *source;
+        }
+        dest++;
+        source--;
+    }
+}
+
+static void blit_row_reverse_sse2(u32 *dest, u32 *source, i32 count) {
+    __m128i zero = _mm_setzero_si128();
+
+    for (; count >= 4; count -= 4) {
+        __m128i src = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)(source - 3)),
+                                        _MM_SHUFFLE(0, 1, 2, 3));
+        __m128i transparent = _mm_cmpeq_epi32(_mm_srli_epi32(src, 24), zero);
+
+        if (_mm_movemask_epi8(transparent) != 0xFFFF) {
+            __m128i dst = _mm_loadu_si128((__m128i *)dest);
+            __m128i result =
+                _mm_or_si128(_mm_and_si128(transparent, dst), _mm_andnot_si128(transparent, src));
+            _mm_storeu_si128((__m128i *)dest, result);
+        }
+
+        dest += 4;
+        source -= 4;
+    }
+
+    blit_row_reverse_scalar(dest, source, count);
+}
+
+TARGET_AVX2 static void blit_row_reverse_avx2(u32 *dest, u32 *source, i32 count) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    for (; count >= 8; count -= 8) {
+        __m256i src = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((__m256i *)(source - 7)),
+                                                  reverse);
+        __m256i transparent = _mm256_cmpeq_epi32(_mm256_srli_epi32(src, 24), zero);
+
+        if (_mm256_movemask_epi8(transparent) != -1) {
+            __m256i dst = _mm256_loadu_si256((__m256i *)dest);
+            _mm256_storeu_si256((__m256i *)dest, _mm256_blendv_epi8(src, dst, transparent));
+        }
+
+        dest += 8;
+        source -= 8;
+    }
+
+    _mm256_zeroupper();
+    blit_row_reverse_sse2(dest, source, count);
+}
+
+// Een span is helemaal niet-transparant, dus hier hoeven we niks te testen. Dit is de gespiegelde
+// versie van de memcpy in blit_sprite.
+static void copy_row_reverse(u32 *dest, u32 *source, i32 count) {
+    for (; count >= 4; count -= 4) {
+        __m128i src = _mm_loadu_si128((__m128i *)(source - 3));
+        _mm_storeu_si128((__m128i *)dest, _mm_shuffle_epi32(src, _MM_SHUFFLE(0, 1, 2, 3)));
+        dest += 4;
+        source -= 4;
+    }
+
+    for (; count > 0; count--) {
+        *dest++ = *source--;
+    }
+}
+
+static Blit_Row *blit_row = blit_row_scalar;
+static Blit_Row *blit_row_reverse = blit_row_reverse_scalar;
+
+#if PROFILE
+// Het aantal bytes dat draw_sprite deze frame heeft gelezen en geschreven.
+static u64 blit_bytes_touched;
+#endif
+
+// Kies de snelste kernel die de processor ondersteunt.
+static void initialize_blitter() {
+    Cpu_Features features = get_cpu_features();
+    if (features.avx2) {
+        blit_row = blit_row_avx2;
+        blit_row_reverse = blit_row_reverse_avx2;
+    } else if (features.sse2) {
+        blit_row = blit_row_sse2;
+        blit_row_reverse = blit_row_reverse_sse2;
+    } else {
+        blit_row = blit_row_scalar;
+        blit_row_reverse = blit_row_reverse_scalar;
+    }
+}
+
+static Rect buffer_rect(Offscreen_Buffer *buffer) {
+    Rect result = {0, 0, (i32)buffer->width, (i32)buffer->height};
+    return result;
+}
+
+// Een hele rij van een niet-transparante sprite. Lange rijen (zoals die van een achtergrond)
+// schrijven we met non-temporal stores, die gaan langs de cache heen zodat ze niet alles eruit
+// duwen wat we daarna nog nodig hebben. Geeft terug of er zo'n store is gedaan, dan moet de
+// aanroeper nog een _mm_sfence doen.
+#define NON_TEMPORAL_MIN_PIXELS 1024
+
+static bool copy_row_opaque(u32 *dest, u32 *source, i32 count) {
+    if (count < NON_TEMPORAL_MIN_PIXELS) {
+        memcpy(dest, source, count * sizeof(u32));
+        return false;
+    }
+
+    // Non-temporal stores moeten op 16 bytes beginnen.
+    for (; ((u64)dest & 15) && (count > 0); count--) {
+        *dest++ = *source++;
+    }
+    for (; count >= 4; count -= 4) {
+        _mm_stream_si128((__m128i *)dest, _mm_loadu_si128((__m128i *)source));
+        dest += 4;
+        source += 4;
+    }
+    for (; count > 0; count--) {
+        *dest++ = *source++;
+    }
+    return true;
+}
+
+// NOTE: Uitleg blit varianten.
+// Er zijn drie manieren om een sprite te tekenen:
+// - BLIT_ALPHA_TEST: elke pixel testen met een blit_row kernel.
+// - BLIT_SPANS: alleen de niet-transparante stukken kopieren, zie build_sprite_spans.
+// - BLIT_OPAQUE: de sprite heeft geen transparante pixels, dus we kopieren hele rijen.
+// Daarnaast hoeven we niet te clippen als de sprite helemaal binnen clip valt (de meeste tiles),
+// en kan de sprite gespiegeld zijn. Voor elke combinatie maakt de compiler met de template een
+// eigen versie, zonder de ifs voor de dingen die niet nodig zijn. blit_sprite kiest de goedkoopste.
+enum Blit_Mode {
+    BLIT_ALPHA_TEST,
+    BLIT_SPANS,
+    BLIT_OPAQUE,
+    BLIT_MODE_COUNT,
+};
+
+typedef void Blit_Sprite(Offscreen_Buffer *buffer, Sprite *sprite, Vector2i min, Vector2i max,
+                         Rect clip);
+
+template <Blit_Mode mode, bool clipped, bool mirrored>
+static void blit_sprite_variant(Offscreen_Buffer *buffer, Sprite *sprite, Vector2i min,
+                                Vector2i max, Rect clip) {
+    Vector2i offset = Vector2i();
+    if (clipped) {
+        if (min.x < clip.min_x) {
+            offset.x = clip.min_x - min.x;
+            min.x = clip.min_x;
+        }
+        if (min.y < clip.min_y) {
+            offset.y = clip.min_y - min.y;
+            min.y = clip.min_y;
+        }
+
+        if (max.x > clip.max_x) {
+            max.x = clip.max_x;
+        }
+        if (max.y > clip.max_y) {
+            max.y = clip.max_y;
+        }
+
+        if ((max.x <= min.x) || (max.y <= min.y)) {
+            return;
+        }
+    }
+
+#if PROFILE
+    u64 bytes_touched = 0;
+#endif
+
+    u8 *dest_row =
+        (u8 *)buffer->memory + (u32)min.x * buffer->bytes_per_pixel + (u32)min.y * buffer->pitch;
+
+    // Bij een gespiegelde sprite hoort kolom x op het scherm bij kolom (width - 1 - x) van de
+    // pixels. De offsets en spans rekenen we in de gespiegelde coordinaten.
+    i32 last_column = (i32)sprite->width - 1;
+
+    if (mode == BLIT_SPANS) {
+        // Het stuk van de sprite dat op het scherm komt, in de coordinaten van de sprite.
+        i32 first_x = offset.x;
+        i32 last_x = offset.x + (max.x - min.x);
+        i32 first_y = maximum(offset.y, (i32)sprite->trim_min_y);
+        i32 last_y = minimum(offset.y + (max.y - min.y), (i32)sprite->trim_max_y);
+
+        dest_row += (first_y - offset.y) * buffer->pitch;
+        for (i32 y = first_y; y < last_y; y++) {
+            u32 *dest = (u32 *)dest_row;
+            u32 *source = sprite->pixels + y * sprite->pitch;
+
+            Sprite_Span *span = sprite->spans + sprite->row_spans[y];
+            Sprite_Span *end = sprite->spans + sprite->row_spans[y + 1];
+            for (; span < end; span++) {
+                i32 start = span->start;
+                i32 stop = span->start + span->length;
+                if (mirrored) {
+                    start = last_column + 1 - (span->start + span->length);
+                    stop = last_column + 1 - span->start;
+                }
+
+                if (clipped) {
+                    start = maximum(start, first_x);
+                    stop = minimum(stop, last_x);
+                    if (start >= stop) continue;
+                }
+
+                if (mirrored) {
+                    copy_row_reverse(dest + (start - first_x), source + last_column - start,
+                                     stop - start);
+                } else {
+                    memcpy(dest + (start - first_x), source + start, (stop - start) * sizeof(u32));
+                }
+#if PROFILE
+                bytes_touched += 2 * (stop - start) * sizeof(u32);
+#endif
+            }
+
+            dest_row += buffer->pitch;
+        }
+    } else {
+        u32 *source_row = sprite->pixels;
+        if (mirrored) {
+            source_row += offset.y * sprite->pitch + (last_column - offset.x);
+        } else {
+            source_row += offset.y * sprite->pitch + offset.x;
+        }
+
+        i32 count = max.x - min.x;
+        bool streamed = false;
+        for (i32 y = min.y; y < max.y; y++) {
+            if (mode == BLIT_OPAQUE) {
+                if (mirrored) {
+                    copy_row_reverse((u32 *)dest_row, source_row, count);
+                } else {
+                    streamed = copy_row_opaque((u32 *)dest_row, source_row, count);
+                }
+            } else if (mirrored) {
+                blit_row_reverse((u32 *)dest_row, source_row, count);
+            } else {
+                blit_row((u32 *)dest_row, source_row, count);
+            }
+#if PROFILE
+            bytes_touched += 2 * count * sizeof(u32);
+#endif
+
+            // We gaan naar de volgende rij in het geheugen.
+            dest_row += buffer->pitch;
+            source_row += sprite->pitch;
+        }
+
+        // Zorg dat de non-temporal stores klaar zijn voordat iemand anders de buffer leest.
+        if (streamed) {
+            _mm_sfence();
+        }
+    }
+
+#if PROFILE
+    InterlockedExchangeAdd64((volatile i64 *)&blit_bytes_touched, (i64)bytes_touched);
+#endif
+}
+
+// Alle varianten, op volgorde van [mode][clipped][mirrored].
+static Blit_Sprite *blit_sprite_variants[BLIT_MODE_COUNT][2][2] = {
+    {{blit_sprite_variant<BLIT_ALPHA_TEST, false, false>,
+      blit_sprite_variant<BLIT_ALPHA_TEST, false, true>},
+     {blit_sprite_variant<BLIT_ALPHA_TEST, true, false>,
+      blit_sprite_variant<BLIT_ALPHA_TEST, true, true>}},
+    {{blit_sprite_variant<BLIT_SPANS, false, false>, blit_sprite_variant<BLIT_SPANS, false, true>},
+     {blit_sprite_variant<BLIT_SPANS, true, false>, blit_sprite_variant<BLIT_SPANS, true, true>}},
+    {{blit_sprite_variant<BLIT_OPAQUE, false, false>,
+      blit_sprite_variant<BLIT_OPAQUE, false, true>},
+     {blit_sprite_variant<BLIT_OPAQUE, true, false>,
+      blit_sprite_variant<BLIT_OPAQUE, true, true>}},
+};
+
+static Blit_Mode get_blit_mode(Sprite *sprite) {
+    if (sprite->opaque) return BLIT_OPAQUE;
+    if (sprite->spans) return BLIT_SPANS;
+    return BLIT_ALPHA_TEST;
+}
+
+// Teken een sprite met de hoeken min en max, maar alleen het deel dat binnen clip valt.
+static void blit_sprite(Offscreen_Buffer *buffer, Sprite *sprite, Vector2i min, Vector2i max,
+                        Rect clip) {
+    // Zonder clippen moet de hele sprite precies tussen min en max passen. Bij een oneven breedte
+    // valt er in draw_sprite een kolom af, dat telt dan ook als clippen.
+    bool clipped = (min.x < clip.min_x) || (min.y < clip.min_y) || (max.x > clip.max_x) ||
+                   (max.y > clip.max_y) || (max.x - min.x != (i32)sprite->width) ||
+                   (max.y - min.y != (i32)sprite->height);
+    blit_sprite_variants[get_blit_mode(sprite)][clipped][sprite->mirror_x](buffer, sprite, min,
+                                                                           max, clip);
+}
+
+// NOTE: Uitleg dirty rects.
+// Schermen zoals het hoofdmenu veranderen bijna nooit. In plaats van elke frame de hele buffer naar
+// het scherm te sturen, houden we bij welke stukken er getekend zijn en sturen we alleen die. Als
+// er niks getekend is sturen we ook niks. Stukken die elkaar raken voegen we samen, en als er te
+// veel stukken zijn sturen we gewoon de hele buffer.
+static void mark_dirty(Offscreen_Buffer *buffer, Rect rect) {
+    if (buffer->all_dirty) return;
+
+    rect.min_x = maximum(rect.min_x, 0);
+    rect.min_y = maximum(rect.min_y, 0);
+    rect.max_x = minimum(rect.max_x, (i32)buffer->width);
+    rect.max_y = minimum(rect.max_y, (i32)buffer->height);
+    if ((rect.max_x <= rect.min_x) || (rect.max_y <= rect.min_y)) return;
+
+    if ((rect.min_x == 0) && (rect.min_y == 0) && (rect.max_x == (i32)buffer->width) &&
+        (rect.max_y == (i32)buffer->height)) {
+        buffer->all_dirty = true;
+        return;
+    }
+
+    for (u32 i = 0; i < buffer->dirty_count; i++) {
+        Rect *other = buffer->dirty_rects + i;
+        if ((rect.min_x <= other->max_x) && (rect.max_x >= other->min_x) &&
+            (rect.min_y <= other->max_y) && (rect.max_y >= other->min_y)) {
+            // Haal de andere weg en probeer het samengevoegde stuk opnieuw toe te voegen, misschien
+            // raakt dat nu weer een ander stuk.
+            rect.min_x = minimum(rect.min_x, other->min_x);
+            rect.min_y = minimum(rect.min_y, other->min_y);
+            rect.max_x = maximum(rect.max_x, other->max_x);
+            rect.max_y = maximum(rect.max_y, other->max_y);
+            *other = buffer->dirty_rects[--buffer->dirty_count];
+            mark_dirty(buffer, rect);
+            return;
+        }
+    }
+
+    if (buffer->dirty_count == MAX_DIRTY_RECTS) {
+        buffer->all_dirty = true;
+        return;
+    }
+
+    buffer->dirty_rects[buffer->dirty_count++] = rect;
+}
@@ -0,0 +1,48 @@
+// NOTE: Uitleg processor.
+// Alles wat per compiler anders is aan het gebruiken van de processor. Het spel bouwen we met MSVC,
+// maar de replay runner (zie replay.cpp) ook met GCC of Clang op Linux. Net als level.cpp gebruikt
+// dit bestand geen Windows functies.
+#ifdef _MSC_VER
+// Met MSVC mag elke functie AVX2 intrinsics gebruiken, GCC en Clang moeten dat per functie weten.
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// GCC en Clang hebben geen _BitScanForward64, dit doet hetzelfde.
+static inline unsigned char _BitScanForward64(unsigned long *index, u64 mask) {
+    if (!mask) return 0;
+    *index = (unsigned long)__builtin_ctzll(mask);
+    return 1;
+}
+#endif
+
+struct Cpu_Features {
+    bool sse2;
+    bool avx2;
+};
+
+// Kijk welke instructies de processor (en het besturingssysteem) ondersteunt.
+static Cpu_Features get_cpu_features() {
+    Cpu_Features features = {};
+#ifdef _MSC_VER
+    i32 info[4];
+    __cpuid(info, 0);
+    i32 max_leaf = info[0];
+
+    __cpuid(info, 1);
+    features.sse2 = (info[3] & (1 << 26)) != 0;
+    bool os_saves_avx = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) &&
+                        ((_xgetbv(0) & 6) == 6);
+
+    if (os_saves_avx && (max_leaf >= 7)) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    // Dit kijkt ook of het besturingssysteem de AVX registers bewaart.
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2") != 0;
+    features.avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    return features;
+}
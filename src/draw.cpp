@@ -1,19 +1,10 @@
-struct Offscreen_Buffer {
-    BITMAPINFO info;
-    void *memory;
-    u32 width, height;
-    i8 bytes_per_pixel;
-    i32 pitch;
-};
+static void *allocate_pages(u64 size) {
+    return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
 
-struct Window {
-    HWND handle;
-    u32 width, height;
-    bool stretch_on_resize;
-    bool resized;
-    HDC device_context;
-    Offscreen_Buffer buffer;
-};
+static void free_pages(void *memory) {
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
 
 // NOTE(Kay Verbruggen): Uitleg pragma pack.
 // We gebruiken pragma pack om te voorkomen dat er padding tussen deze variabele komt. Padding
@@ -37,152 +28,592 @@ struct Bitmap_Header {
 };
 #pragma pack(pop)
 
-struct Sprite {
-    u32 *pixels;
-    u32 width;
-    u32 height;
-    u16 bits_per_pixel;
-};
-
 struct Animation {
     Sprite sprites[8];
     float fps;
     u8 id;
 };
 
-static Sprite load_bitmap(const char *filename) {
+// Een sprite die deze frame getekend moet worden, min en max zijn de hoeken op het scherm voordat
+// er geclipt is. De sprite slaan we op als kopie, omdat sommige sprites (zoals die van de tile
+// map in in_level) alleen op de stack staan.
+struct Draw_Command {
+    Sprite sprite;
+    Vector2i min;
+    Vector2i max;
+    // Geen sprite maar een rechthoek in een kleur, zie draw_rect_corners.
+    bool fill;
+    u32 fill_color;
+};
+
+#define MAX_DRAW_COMMANDS 4096
+#define MAX_RENDER_THREADS 16
+
+struct Render_Queue;
+struct Presenter;
+
+struct Render_Worker {
+    HANDLE thread;
+    HANDLE start_event;
+    HANDLE done_event;
+    Render_Queue *queue;
+    Offscreen_Buffer *buffer;
+    Rect band;
+};
+
+struct Render_Queue {
+    Draw_Command *commands;
+    u32 command_count;
+
+    // Het aantal threads dat we gebruiken om te tekenen, worker 0 is de main thread zelf.
+    u32 thread_count;
+    u32 worker_count;
+    Render_Worker workers[MAX_RENDER_THREADS];
+};
+
+struct Window {
+    HWND handle;
+    u32 width, height;
+    bool resized;
+    HDC device_context;
+    Offscreen_Buffer buffer;
+    Render_Queue queue;
+    Presenter *presenter;
+};
+
+// NOTE: Uitleg render resolutie.
+// Alle posities in het spel (de camera, de speler, de knoppen) zijn in pixels van een 1920x1080
+// scherm. We hoeven alleen niet per se op 1920x1080 te tekenen, de buffer kan ook kleiner zijn
+// (bijvoorbeeld 1280x720). De presenter schaalt de buffer dan op naar de grootte van het venster.
+// Sprites verkleinen we al bij het laden, en draw_sprite rekent de posities om met render_scale.
+#define DESIGN_WIDTH 1920
+#define DESIGN_HEIGHT 1080
+
+static f32 render_scale = 1.0f;
+
+// Reken een coordinaat van het 1920x1080 scherm om naar een pixel in de buffer.
+static i32 to_render_pixels(f32 value) {
+    if (render_scale == 1.0f) return (i32)value;
+
+    // Afronden naar het dichtstbijzijnde getal, ook voor negatieve getallen.
+    f32 scaled = value * render_scale + 0.5f;
+    i32 result = (i32)scaled;
+    if ((f32)result > scaled) result--;
+    return result;
+}
+
+static Vector2i to_render_pixels(Vector2f value) {
+    return Vector2i(to_render_pixels(value.x), to_render_pixels(value.y));
+}
+
+// Verklein een sprite naar render_scale. We pakken gewoon de dichtstbijzijnde pixel, zodat
+// transparante randen niet half doorzichtig worden.
+static Sprite scale_sprite(Sprite *sprite) {
+    Sprite result = {};
+    result.width = maximum(to_render_pixels((f32)sprite->width), 1);
+    result.height = maximum(to_render_pixels((f32)sprite->height), 1);
+    result.bits_per_pixel = sprite->bits_per_pixel;
+    result.opaque = sprite->opaque;
+    result.pitch = result.width;
+    result.pixels = (u32 *)VirtualAlloc(0, sizeof(u32) * result.width * result.height,
+                                        MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    result.memory = result.pixels;
+    if (!result.pixels) return result;
+
+    u32 *dest = result.pixels;
+    for (u32 y = 0; y < result.height; y++) {
+        u32 *source_row = sprite->pixels + ((u64)y * sprite->height / result.height) * sprite->pitch;
+        for (u32 x = 0; x < result.width; x++) {
+            *dest++ = source_row[(u64)x * sprite->width / result.width];
+        }
+    }
+
+    return result;
+}
+
+// Lees een losse bitmap van de schijf.
+static Sprite read_bitmap_file(const char *filename) {
     Sprite sprite = {};
 
     HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
                               FILE_ATTRIBUTE_NORMAL, 0);
     if (file == INVALID_HANDLE_VALUE) {
-        MessageBoxA(0, "Kon afbeelding niet laden!", "Bitmap laden", MB_OK);
+        report_load_error("Bitmap laden", "Kon afbeelding niet laden!", filename);
         return sprite;
     }
     LARGE_INTEGER file_size;
-    if (!GetFileSizeEx(file, &file_size)) {
-        MessageBoxA(0, "Kon de grootte niet opvragen!", "Bitmap laden", MB_OK);
+    if (!GetFileSizeEx(file, &file_size) || (file_size.QuadPart < (i64)sizeof(Bitmap_Header))) {
+        report_load_error("Bitmap laden", "Kon de grootte niet opvragen!", filename);
+        CloseHandle(file);
         return sprite;
     }
     void *memory = VirtualAlloc(0, file_size.QuadPart, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-    if (!ReadFile(file, memory, (u32)file_size.QuadPart, 0, 0)) {
-        MessageBoxA(0, "Kon afbeelding niet laden!", "Bitmap laden", MB_OK);
+    bool read = ReadFile(file, memory, (u32)file_size.QuadPart, 0, 0);
+    CloseHandle(file);
+    if (!read) {
+        report_load_error("Bitmap laden", "Kon afbeelding niet laden!", filename);
+        VirtualFree(memory, 0, MEM_RELEASE);
         return sprite;
     }
 
     Bitmap_Header *header = (Bitmap_Header *)memory;
 
     if (header->bits_per_pixel != 32) {
-        MessageBoxA(0, "We ondersteunen alleen bitmaps met 32 bits per pixel!", "Bitmap", MB_OK);
+        report_load_error("Bitmap", "We ondersteunen alleen bitmaps met 32 bits per pixel!",
+                          filename);
+        VirtualFree(memory, 0, MEM_RELEASE);
         return sprite;
     }
 
     sprite.width = header->width;
     sprite.height = header->height;
     sprite.bits_per_pixel = header->bits_per_pixel;
+    sprite.pitch = sprite.width;
     sprite.pixels = (u32 *)((u8 *)memory + header->bitmap_offset);
+    sprite.memory = memory;
+    sprite.opaque = is_sprite_opaque(&sprite);
+
     return sprite;
 }
 
+#if PROFILE
+// Hoeveel tijd en pixels het uitpakken van sprites uit het pack heeft gekost, zie load_bitmap.
+static volatile i64 sprite_decode_cycles;
+static volatile i64 sprite_decode_bytes;
+#endif
+
+// Met scale = false verkleinen we de sprite niet, bijvoorbeeld voor het ontwerp van een level.
+static Sprite load_bitmap(const char *filename, bool build_spans = false, bool scale = true) {
+    Sprite sprite = {};
+
+    // Uit het asset pack wijst de sprite direct naar de pixels in het bestand, zie pack.cpp. Alleen
+    // een ingepakte sprite pakken we uit in eigen geheugen.
+    Pack_Entry *entry = find_pack_entry(asset_pack.header, filename, PACK_SPRITE);
+    if (entry) {
+        sprite.width = entry->width;
+        sprite.height = entry->height;
+        sprite.bits_per_pixel = 32;
+        sprite.pitch = entry->width;
+        sprite.pixels = (u32 *)get_pack_data(asset_pack.header, entry);
+        sprite.opaque = (entry->flags & PACK_OPAQUE) != 0;
+
+        // Een kapot pack mag ons niet voorbij de data van de entry laten lezen.
+        u64 pixel_bytes = sizeof(u32) * (u64)entry->width * entry->height;
+        if ((pixel_bytes == 0) || (pixel_bytes > 0xFFFFFFFF) ||
+            (!(entry->flags & PACK_COMPRESSED) && (entry->size < pixel_bytes))) {
+            report_load_error("Bitmap laden", "De sprite in het pack is kapot!", filename);
+            return {};
+        }
+
+        if (entry->flags & PACK_COMPRESSED) {
+#if PROFILE
+            i64 decode_start = __rdtsc();
+#endif
+            u32 *pixels = (u32 *)VirtualAlloc(0, sizeof(u32) * sprite.width * sprite.height,
+                                              MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+            if (!pixels || !decode_sprite_pixels((u8 *)sprite.pixels, entry->size, pixels,
+                                                 sprite.width, sprite.height)) {
+                report_load_error("Bitmap laden", "Kon de sprite niet uitpakken!", filename);
+                if (pixels) VirtualFree(pixels, 0, MEM_RELEASE);
+                return {};
+            }
+            sprite.pixels = pixels;
+            sprite.memory = pixels;
+#if PROFILE
+            InterlockedExchangeAdd64(&sprite_decode_cycles, __rdtsc() - decode_start);
+            InterlockedExchangeAdd64(&sprite_decode_bytes,
+                                     (i64)sizeof(u32) * sprite.width * sprite.height);
+#endif
+        }
+    } else {
+        sprite = read_bitmap_file(filename);
+        if (!sprite.pixels) return sprite;
+    }
+
+    if (scale && (render_scale != 1.0f)) {
+        Sprite scaled = scale_sprite(&sprite);
+        if (sprite.memory) {
+            VirtualFree(sprite.memory, 0, MEM_RELEASE);
+        }
+        sprite = scaled;
+    }
+
+    // Een sprite zonder transparante pixels heeft niks aan spans.
+    if (build_spans && !sprite.opaque) {
+        build_sprite_spans(&sprite);
+    }
+    return sprite;
+}
+
+// Job voor run_jobs: laad een bitmap in de Sprite waar destination naar wijst.
+static void load_sprite_job(Job *job) {
+    *(Sprite *)job->destination = load_bitmap(job->filename, (job->flags & JOB_BUILD_SPANS) != 0);
+}
+
+static void add_sprite_job(Job_Batch *batch, const char *filename, Sprite *sprite) {
+    add_job(batch, load_sprite_job, filename, sprite, JOB_BUILD_SPANS);
+}
+
+// NOTE: Uitleg spiegelen.
+// Veel sprites (zoals de speler) hebben een versie die naar links kijkt en een die naar rechts
+// kijkt. In plaats van beide te laden, maken we van de ene een gespiegelde kopie die naar dezelfde
+// pixels en spans wijst. blit_sprite leest de rijen dan van achter naar voren. Omdat de kopie
+// niks eigen heeft, mag free_sprite alleen op het origineel worden aangeroepen.
+static Sprite mirror_sprite(Sprite *sprite) {
+    Sprite result = *sprite;
+    result.mirror_x = !sprite->mirror_x;
+    result.memory = 0;
+    return result;
+}
+
+// De pixels van een geladen bitmap staan achter de header in het geheugen, dus geven we memory
+// vrij en niet pixels.
 static void free_sprite(Sprite *sprite) {
-    if (sprite->pixels) {
-        VirtualFree(sprite->pixels, 0, MEM_RELEASE);
+    if (sprite->memory) {
+        VirtualFree(sprite->memory, 0, MEM_RELEASE);
     }
+    if (sprite->row_spans) {
+        free_pages(sprite->row_spans);
+    }
+    *sprite = {};
 }
 
-static void draw_sprite(Window *window, Vector2f camera, Sprite *sprite,
-                        Vector2f pos = Vector2f(0.0f, 0.0f)) {
-    Offscreen_Buffer *buffer = &window->buffer;
-
-    Vector2i min = Vector2i((i32)pos.x - (sprite->width / 2), (i32)pos.y - (sprite->height / 2)) -
-                   Vector2i(camera);
-    Vector2i max = Vector2i((i32)pos.x + (sprite->width / 2), (i32)pos.y + (sprite->height / 2)) -
-                   Vector2i(camera);
-
-    Vector2i offset = Vector2i();
-    if (min.x < 0) {
-        offset.x = -min.x;
-        min.x = 0;
-    }
-    if (min.y < 0) {
-        offset.y = -min.y;
-        min.y = 0;
-    }
-
-    if (max.x > (i32)buffer->width) {
-        max.x = buffer->width;
-    }
-    if (max.y > (i32)buffer->height) {
-        max.y = buffer->height;
-    }
-
-    u8 *dest_row =
-        (u8 *)buffer->memory + (u32)min.x * buffer->bytes_per_pixel + (u32)min.y * buffer->pitch;
-    u32 *source_row = sprite->pixels;
-    source_row += offset.y * sprite->width + offset.x;
-
-    for (i32 y = min.y; y < max.y; y++) {
-        // Pak de pixel.
-        u32 *dest = (u32 *)dest_row;
-        u32 *source = source_row;
-
-        for (i32 x = min.x; x < max.x; x++) {
-            // NOTE(Kay Verbruggen): Uitleg alpha kanaal.
-            // Als het alpha kanaal 0 is, betekent dit dat de pixel transparant hoort te zijn.
-            // Daarom slaan we deze pixel over en gaan we door naar de volgende. Om het alpha kanaal
-            // te lezen, moeten we de source pixel 24 bits naar rechts schuiven, zodat we de RGB
-            // waardes als het waren uit de variabele hebben geschoven. Dan hebben we dus alleen nog
-            // maar de alpha waarde.
-            // AA RR GG BB (elk kleurkanaal 8 bits) 24 bits naar rechts -> 00 00 00 AA. Dus alleen
-            // de alpha waarde blijft over.
-            if (*source >> 24 == 0) {
-                dest++;
-                source++;
+// NOTE: Uitleg atlas.
+// Elke load_bitmap heeft zijn eigen VirtualAlloc, dus de kleine sprites (de speler, de tiles, de
+// knoppen) staan verspreid over een hoop losse pagina's. Daarom kopieren we ze bij het opstarten
+// samen naar een grote atlas. De sprites worden dan een stukje van de atlas, met de pitch van de
+// atlas. We pakken in "planken": de sprites staan gesorteerd op hoogte naast elkaar, en als een
+// plank vol is beginnen we een nieuwe plank erboven. Elke sprite begint op een cache line, zodat
+// elke rij van een sprite ook op een cache line begint.
+#define ATLAS_WIDTH 2048
+#define ATLAS_ALIGN 16
+
+struct Sprite_Atlas {
+    u32 *pixels;
+    u32 width;
+    u32 height;
+};
+
+static Sprite_Atlas pack_sprite_atlas(Sprite **sprites, u32 count) {
+    Sprite_Atlas atlas = {};
+    atlas.width = ATLAS_WIDTH;
+
+    // Sorteer van hoog naar laag, dan verspillen we het minste ruimte boven de sprites op een plank.
+    Sprite **sorted = push_array(&frame_arena, Sprite *, count * 2);
+    if (!sorted) return atlas;
+    u32 *positions = (u32 *)(sorted + count);
+
+    for (u32 i = 0; i < count; i++) {
+        u32 j = i;
+        while ((j > 0) && (sorted[j - 1]->height < sprites[i]->height)) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = sprites[i];
+    }
+
+    // Eerst bepalen we waar elke sprite komt, zodat we weten hoe groot de atlas moet worden.
+    u32 x = 0;
+    u32 shelf_y = 0;
+    u32 shelf_height = 0;
+    for (u32 i = 0; i < count; i++) {
+        Sprite *sprite = sorted[i];
+        u32 width = (sprite->width + ATLAS_ALIGN - 1) & ~(ATLAS_ALIGN - 1);
+        if ((x + width > atlas.width) && (x > 0)) {
+            shelf_y += shelf_height;
+            shelf_height = 0;
+            x = 0;
+        }
+
+        positions[2 * i + 0] = x;
+        positions[2 * i + 1] = shelf_y;
+        x += width;
+        shelf_height = maximum(shelf_height, sprite->height);
+        atlas.width = maximum(atlas.width, x);
+    }
+    atlas.height = shelf_y + shelf_height;
+
+    atlas.pixels = push_array(&permanent_arena, u32, atlas.width * atlas.height);
+    if (!atlas.pixels) {
+        MessageBoxA(0, "Kon de atlas niet maken!", "Atlas", MB_OK);
+        return atlas;
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        Sprite *sprite = sorted[i];
+        u32 *dest = atlas.pixels + positions[2 * i + 1] * atlas.width + positions[2 * i + 0];
+        for (u32 y = 0; y < sprite->height; y++) {
+            memcpy(dest + y * atlas.width, sprite->pixels + y * sprite->pitch,
+                   sizeof(u32) * sprite->width);
+        }
+
+        if (sprite->memory) {
+            VirtualFree(sprite->memory, 0, MEM_RELEASE);
+        }
+        sprite->pixels = dest;
+        sprite->pitch = atlas.width;
+        sprite->memory = 0;
+    }
+
+    return atlas;
+}
+
+#if PROFILE
+// Teken een sprite met elke variant een paar honderd keer en laat zien hoe lang dat duurt. De
+// clipped varianten tekenen de sprite half over de linkeronderhoek van de buffer.
+static void benchmark_blit_variants(Offscreen_Buffer *buffer, Sprite *sprite, const char *name) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    const char *mode_names[] = {"alpha test", "spans", "opaque"};
+    Rect clip = buffer_rect(buffer);
+    Vector2i size = Vector2i(sprite->width, sprite->height);
+    Vector2i center = Vector2i((buffer->width - sprite->width) / 2,
+                               (buffer->height - sprite->height) / 2);
+
+    for (u32 mode = 0; mode < BLIT_MODE_COUNT; mode++) {
+        if ((mode == BLIT_SPANS) && !sprite->spans) continue;
+
+        for (u32 clipped = 0; clipped < 2; clipped++) {
+            for (u32 mirrored = 0; mirrored < 2; mirrored++) {
+                Vector2i min = clipped ? Vector2i(-(i32)sprite->width / 2,
+                                                  -(i32)sprite->height / 2)
+                                       : center;
+                Blit_Sprite *variant = blit_sprite_variants[mode][clipped][mirrored];
+
+                LARGE_INTEGER start, end;
+                QueryPerformanceCounter(&start);
+                for (u32 run = 0; run < 256; run++) {
+                    variant(buffer, sprite, min, min + size, clip);
+                }
+                QueryPerformanceCounter(&end);
+
+                f64 us = (f64)(end.QuadPart - start.QuadPart) * 1000000.0 /
+                         (f64)frequency.QuadPart / 256.0;
+                char text[256];
+                StringCbPrintfA(text, 256, "Blit %s %ux%u, %s%s%s: %.3fus\n", name,
+                                sprite->width, sprite->height, mode_names[mode],
+                                clipped ? ", clipped" : "", mirrored ? ", mirrored" : "", us);
+                OutputDebugStringA(text);
+            }
+        }
+    }
+
+    buffer->all_dirty = true;
+}
+#endif
+
+// Vul de rechthoek min tot max met een kleur, maar alleen het deel dat binnen clip valt.
+static void fill_rect(Offscreen_Buffer *buffer, Vector2i min, Vector2i max, u32 color, Rect clip) {
+    i32 min_x = maximum(min.x, clip.min_x);
+    i32 min_y = maximum(min.y, clip.min_y);
+    i32 max_x = minimum(max.x, clip.max_x);
+    i32 max_y = minimum(max.y, clip.max_y);
+    if ((max_x <= min_x) || (max_y <= min_y)) return;
+
+    __m128i colors = _mm_set1_epi32((i32)color);
+    for (i32 y = min_y; y < max_y; y++) {
+        u32 *row = (u32 *)((u8 *)buffer->memory + y * buffer->pitch);
+        i32 x = min_x;
+        for (; x + 4 <= max_x; x += 4) {
+            _mm_storeu_si128((__m128i *)(row + x), colors);
+        }
+        for (; x < max_x; x++) {
+            row[x] = color;
+        }
+    }
+}
+
+// Voer alle draw commands van deze frame uit, maar alleen binnen de band.
+static void render_band(Render_Queue *queue, Offscreen_Buffer *buffer, Rect band) {
+    for (u32 i = 0; i < queue->command_count; i++) {
+        Draw_Command *command = queue->commands + i;
+        if ((command->max.y > band.min_y) && (command->min.y < band.max_y)) {
+            if (command->fill) {
+                fill_rect(buffer, command->min, command->max, command->fill_color, band);
             } else {
-                *dest++ = *source++;
+                blit_sprite(buffer, &command->sprite, command->min, command->max, band);
             }
         }
+    }
+}
+
+static DWORD WINAPI render_worker_proc(LPVOID parameter) {
+    Render_Worker *worker = (Render_Worker *)parameter;
 
-        // We gaan naar de volgende rij in het geheugen.
-        dest_row += buffer->pitch;
-        source_row += sprite->width;
+    for (;;) {
+        WaitForSingleObject(worker->start_event, INFINITE);
+        render_band(worker->queue, worker->buffer, worker->band);
+        SetEvent(worker->done_event);
     }
 }
 
-static void resize_buffer(Offscreen_Buffer *buffer, Vector2i dimensions) {
-    // Eerst moeten we het geheugen van de buffer legen als hier al iets in staat.
-    if (buffer->memory) {
-        VirtualFree(buffer->memory, 0, MEM_RELEASE);
+// NOTE: Uitleg banden.
+// We delen de buffer op in horizontale banden, een per thread. Elke thread voert alle draw commands
+// van de frame in dezelfde volgorde uit, maar alleen binnen zijn eigen band. Omdat de banden niet
+// overlappen hoeven de threads niet op elkaar te wachten, en omdat de volgorde per pixel hetzelfde
+// blijft is het resultaat precies hetzelfde als wanneer een thread alles tekent.
+static void render_queue_with_threads(Render_Queue *queue, Offscreen_Buffer *buffer,
+                                      u32 thread_count) {
+    if (thread_count > queue->worker_count) thread_count = queue->worker_count;
+    if (thread_count < 1) thread_count = 1;
+
+    i32 band_height = ((i32)buffer->height + thread_count - 1) / thread_count;
+
+    for (u32 i = 1; i < thread_count; i++) {
+        Render_Worker *worker = queue->workers + i;
+        worker->buffer = buffer;
+        worker->band = buffer_rect(buffer);
+        worker->band.min_y = minimum((i32)i * band_height, (i32)buffer->height);
+        worker->band.max_y = minimum((i32)(i + 1) * band_height, (i32)buffer->height);
+        SetEvent(worker->start_event);
     }
 
-    // Vul de buffer met de nieuwe informatie, voornamelijk de breedte en hoogte.
-    buffer->width = dimensions.x;
-    buffer->height = dimensions.y;
+    // De main thread doet zelf de eerste band.
+    Rect band = buffer_rect(buffer);
+    band.max_y = minimum(band_height, (i32)buffer->height);
+    render_band(queue, buffer, band);
 
-    buffer->info.bmiHeader.biSize = sizeof(buffer->info.bmiHeader);
-    buffer->info.bmiHeader.biWidth = buffer->width;
-    buffer->info.bmiHeader.biHeight = buffer->height;
-    buffer->info.bmiHeader.biPlanes = 1;
-    buffer->info.bmiHeader.biBitCount = 32;
-    buffer->info.bmiHeader.biCompression = BI_RGB;
+    for (u32 i = 1; i < thread_count; i++) {
+        WaitForSingleObject(queue->workers[i].done_event, INFINITE);
+    }
+}
+
+#if PROFILE
+// Teken de huidige frame opnieuw met 1, 2, 4 en 8 threads en laat zien hoe lang dat duurt. Omdat
+// elke pixel gewoon het laatste commando krijgt dat hem raakt, maakt het niet uit dat we dezelfde
+// frame een paar keer tekenen.
+static void benchmark_render_queue(Render_Queue *queue, Offscreen_Buffer *buffer) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    u32 thread_counts[] = {1, 2, 4, 8};
+    for (u32 i = 0; i < 4; i++) {
+        if (thread_counts[i] > queue->worker_count) break;
+
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        for (u32 run = 0; run < 10; run++) {
+            render_queue_with_threads(queue, buffer, thread_counts[i]);
+        }
+        QueryPerformanceCounter(&end);
+
+        f64 ms = (f64)(end.QuadPart - start.QuadPart) * 1000.0 / (f64)frequency.QuadPart / 10.0;
+        char text[256];
+        StringCbPrintfA(text, 256, "Render %ux%u, %u commands, %u threads: %.3fms\n",
+                        buffer->width, buffer->height, queue->command_count, thread_counts[i], ms);
+        OutputDebugStringA(text);
+    }
+}
+#endif
+
+static void flush_render_queue(Window *window) {
+    Render_Queue *queue = &window->queue;
+    if (queue->command_count == 0) return;
 
-    // 4 bytes per pixel aangezien de bitcount ook op 32 bits staat.
-    buffer->bytes_per_pixel = 4;
-    // Dit is de totale buffer grootte.
-    i32 bitmap_memory_size = buffer->bytes_per_pixel * buffer->width * buffer->height;
+#if PROFILE
+    static u32 frames_until_benchmark = 600;
+    if (--frames_until_benchmark == 0) {
+        frames_until_benchmark = 600;
+        benchmark_render_queue(queue, &window->buffer);
+    }
+#endif
+
+    render_queue_with_threads(queue, &window->buffer, queue->thread_count);
+    queue->command_count = 0;
+}
+
+static void initialize_renderer(Window *window) {
+    Render_Queue *queue = &window->queue;
+
+    queue->commands = push_array(&permanent_arena, Draw_Command, MAX_DRAW_COMMANDS);
+    queue->command_count = 0;
 
-    // Alloc het geheugen zodat we het kunnen gaan gebruiken.
-    buffer->memory = VirtualAlloc(0, bitmap_memory_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    queue->worker_count = minimum((u32)info.dwNumberOfProcessors, (u32)MAX_RENDER_THREADS);
+    if (queue->worker_count < 1) queue->worker_count = 1;
+    queue->thread_count = queue->worker_count;
 
-    // Dit is een rij aan pixels, dit kunnen we gebruiken om makelijker naar een bepaalde rij te
-    // gaan.
-    buffer->pitch = buffer->width * buffer->bytes_per_pixel;
+    for (u32 i = 1; i < queue->worker_count; i++) {
+        Render_Worker *worker = queue->workers + i;
+        worker->queue = queue;
+        worker->start_event = CreateEventA(0, FALSE, FALSE, 0);
+        worker->done_event = CreateEventA(0, FALSE, FALSE, 0);
+        worker->thread = CreateThread(0, 0, render_worker_proc, worker, 0, 0);
+    }
 }
 
-static void update_window(Window *window) {
-    // PatBlt(window->device_context, 0, 0, window->width, window->height, BLACKNESS);
+// Teken een sprite tussen de hoeken min en max, in pixels van de buffer.
+static void draw_sprite_corners(Window *window, Sprite *sprite, Vector2i min, Vector2i max) {
+    Rect rect = {min.x, min.y, max.x, max.y};
+    mark_dirty(&window->buffer, rect);
+
+    Render_Queue *queue = &window->queue;
+    if (!queue->commands) {
+        blit_sprite(&window->buffer, sprite, min, max, buffer_rect(&window->buffer));
+        return;
+    }
+
+    if (queue->command_count == MAX_DRAW_COMMANDS) {
+        flush_render_queue(window);
+    }
 
-    StretchDIBits(window->device_context, 0, 0, window->width, window->height, 0, 0,
-                  window->buffer.width, window->buffer.height, window->buffer.memory,
-                  &window->buffer.info, DIB_RGB_COLORS, SRCCOPY);
-}
\ No newline at end of file
+    Draw_Command *command = queue->commands + queue->command_count++;
+    command->sprite = *sprite;
+    command->min = min;
+    command->max = max;
+    command->fill = false;
+}
+
+// Vul een rechthoek tussen de hoeken min en max met een kleur, in pixels van de buffer.
+static void draw_rect_corners(Window *window, Vector2i min, Vector2i max, u32 color) {
+    Rect rect = {min.x, min.y, max.x, max.y};
+    mark_dirty(&window->buffer, rect);
+
+    Render_Queue *queue = &window->queue;
+    if (!queue->commands) {
+        fill_rect(&window->buffer, min, max, color, buffer_rect(&window->buffer));
+        return;
+    }
+
+    if (queue->command_count == MAX_DRAW_COMMANDS) {
+        flush_render_queue(window);
+    }
+
+    Draw_Command *command = queue->commands + queue->command_count++;
+    command->sprite = {};
+    command->min = min;
+    command->max = max;
+    command->fill = true;
+    command->fill_color = color;
+}
+
+// Maak het hele scherm een kleur, bijvoorbeeld als een achtergrond nog niet geladen is.
+static void clear_screen(Window *window, u32 color) {
+    Rect rect = buffer_rect(&window->buffer);
+    draw_rect_corners(window, Vector2i(rect.min_x, rect.min_y), Vector2i(rect.max_x, rect.max_y),
+                      color);
+}
+
+// Teken een sprite met de linkeronderhoek op min, in pixels van de buffer.
+static void draw_sprite_at(Window *window, Sprite *sprite, Vector2i min) {
+    Vector2i max = min + Vector2i(sprite->width, sprite->height);
+    draw_sprite_corners(window, sprite, min, max);
+}
+
+static void draw_sprite(Window *window, Vector2f camera, Sprite *sprite,
+                        Vector2f pos = Vector2f(0.0f, 0.0f)) {
+    Vector2i center = to_render_pixels(pos);
+    Vector2i half_size = Vector2i(sprite->width / 2, sprite->height / 2);
+
+    // Bij een oneven breedte valt de laatste kolom weg, net als vroeger.
+    Vector2i min = center - half_size - to_render_pixels(camera);
+    Vector2i max = center + half_size - to_render_pixels(camera);
+    draw_sprite_corners(window, sprite, min, max);
+}
+
+static void set_render_resolution(Window *window, Vector2i dimensions) {
+    render_scale = (f32)dimensions.y / (f32)DESIGN_HEIGHT;
+    resize_buffer(&window->buffer, dimensions);
+}
@@ -0,0 +1,134 @@
+// NOTE: Uitleg jobs.
+// Bij het opstarten laden we tientallen plaatjes en geluiden die niks met elkaar te maken hebben.
+// In plaats van ze een voor een te laden, zetten we ze als jobs in een Job_Batch en laat run_jobs
+// ze over een paar threads verdelen. Elke thread pakt met een InterlockedIncrement de volgende job
+// tot ze op zijn, en run_jobs wacht tot alle threads klaar zijn. Pas daarna gebruiken we de
+// resultaten.
+//
+// Een job schrijft alleen naar zijn eigen destination, dus de jobs hoeven niet op elkaar te
+// wachten. Wat een job aanroept moet wel thread safe zijn, de arenas zijn dat bijvoorbeeld niet.
+#define MAX_JOBS 128
+#define MAX_JOB_THREADS 8
+
+// Flags van een job.
+#define JOB_BUILD_SPANS 1
+#define JOB_NO_SCALE 2
+
+struct Job;
+typedef void Job_Proc(Job *job);
+
+struct Job {
+    Job_Proc *proc;
+    const char *filename;
+    void *destination;
+    u32 flags;
+};
+
+struct Job_Batch {
+    Job jobs[MAX_JOBS];
+    u32 job_count;
+    volatile LONG next_job;
+};
+
+// NOTE: Uitleg laadfouten.
+// Als er bij het opstarten tien bestanden missen, willen we niet tien MessageBoxen, en al helemaal
+// niet vanaf verschillende threads. Tussen begin_load_errors en show_load_errors verzamelen we de
+// fouten daarom, en laten we ze daarna in een keer zien. Daarbuiten doet report_load_error gewoon
+// een MessageBoxA zoals vroeger.
+#define LOAD_ERRORS_SIZE 2048
+
+struct Load_Errors {
+    CRITICAL_SECTION lock;
+    bool initialized;
+    bool collecting;
+    u32 count;
+    char text[LOAD_ERRORS_SIZE];
+};
+
+static Load_Errors load_errors;
+
+static void report_load_error(const char *title, const char *message, const char *filename) {
+    char text[512];
+    StringCbPrintfA(text, 512, "%s\n%s", message, filename);
+
+    if (!load_errors.collecting) {
+        MessageBoxA(0, text, title, MB_OK);
+        return;
+    }
+
+    EnterCriticalSection(&load_errors.lock);
+    load_errors.count++;
+    size_t length = strlen(load_errors.text);
+    StringCbPrintfA(load_errors.text + length, LOAD_ERRORS_SIZE - length, "%s: %s\n", filename,
+                    message);
+    LeaveCriticalSection(&load_errors.lock);
+}
+
+static void begin_load_errors() {
+    if (!load_errors.initialized) {
+        InitializeCriticalSection(&load_errors.lock);
+        load_errors.initialized = true;
+    }
+    load_errors.count = 0;
+    load_errors.text[0] = 0;
+    load_errors.collecting = true;
+}
+
+static void show_load_errors() {
+    load_errors.collecting = false;
+    if (load_errors.count == 0) return;
+
+    char text[LOAD_ERRORS_SIZE + 128];
+    StringCbPrintfA(text, sizeof(text), "%u bestanden konden niet geladen worden:\n\n%s",
+                    load_errors.count, load_errors.text);
+    MessageBoxA(0, text, "Laden", MB_OK);
+}
+
+static void add_job(Job_Batch *batch, Job_Proc *proc, const char *filename, void *destination,
+                    u32 flags = 0) {
+    if (batch->job_count == MAX_JOBS) {
+        // Dan doen we hem maar meteen, op deze thread.
+        Job job = {proc, filename, destination, flags};
+        proc(&job);
+        return;
+    }
+
+    Job *job = batch->jobs + batch->job_count++;
+    job->proc = proc;
+    job->filename = filename;
+    job->destination = destination;
+    job->flags = flags;
+}
+
+static DWORD WINAPI job_thread_proc(LPVOID parameter) {
+    Job_Batch *batch = (Job_Batch *)parameter;
+
+    for (;;) {
+        u32 index = (u32)InterlockedIncrement(&batch->next_job) - 1;
+        if (index >= batch->job_count) break;
+
+        Job *job = batch->jobs + index;
+        job->proc(job);
+    }
+    return 0;
+}
+
+// Voer alle jobs uit met thread_count threads, waarvan een de aanroepende thread is, en wacht tot
+// ze allemaal klaar zijn.
+static void run_jobs(Job_Batch *batch, u32 thread_count) {
+    thread_count = minimum(maximum(thread_count, 1u), (u32)MAX_JOB_THREADS);
+    batch->next_job = 0;
+
+    HANDLE threads[MAX_JOB_THREADS];
+    for (u32 i = 1; i < thread_count; i++) {
+        threads[i] = CreateThread(0, 0, job_thread_proc, batch, 0, 0);
+    }
+
+    job_thread_proc(batch);
+
+    for (u32 i = 1; i < thread_count; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    batch->job_count = 0;
+}
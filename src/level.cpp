@@ -0,0 +1,207 @@
+// NOTE: Uitleg level bestanden.
+// De levels zijn getekend als kleine bitmaps, een pixel per tile. Voor levels van duizenden tiles
+// breed is dat niet handig, want dan moeten we de hele bitmap lezen voordat we kunnen spelen. De
+// packer (zie packer.cpp) zet een ontwerp daarom om naar een level bestand (.lvl), waarin de map
+// in chunks van LEVEL_CHUNK_TILES bij LEVEL_CHUNK_TILES tiles staat. Het spel hoeft dan alleen de
+// chunks rond de speler uit te pakken, zie de level streamer in tile_map.cpp.
+//
+// Het bestand ziet er zo uit:
+// - Level_Header
+// - Een Level_Chunk_Entry per chunk, rij voor rij van onder naar boven. Een chunk zonder tiles
+//   heeft size 0 en staat niet in het bestand.
+// - De data van de chunks. Elke chunk is een lijst van (aantal, tile) paren van een byte, die
+//   samen alle tiles van de chunk geven, rij voor rij van onder naar boven.
+//
+// Net als pack.cpp gebruikt dit bestand alleen vaste types en geen Windows functies, zodat de
+// packer het ook kan gebruiken.
+#define LEVEL_MAGIC 0x314C564C // "LVL1"
+#define LEVEL_VERSION 1
+#define LEVEL_CHUNK_SHIFT 6
+#define LEVEL_CHUNK_TILES (1 << LEVEL_CHUNK_SHIFT)
+
+enum {
+    EMPTY_TILE = shift(0),
+    GROUND_TILE = shift(1),
+    START_TILE = shift(2),
+    END_TILE = shift(3),
+    COIN_TILE = shift(4),
+    DEATH_TILE = shift(5),
+    SPIKES_TILE = shift(6),
+};
+
+struct Level_Header {
+    u32 magic;
+    u32 version;
+    u32 width;
+    u32 height;
+    u32 chunks_x;
+    u32 chunks_y;
+    // De tile waar de speler begint.
+    u32 start_x;
+    u32 start_y;
+    u64 file_size;
+};
+
+struct Level_Chunk_Entry {
+    u64 offset;
+    u32 size;
+    u32 reserved;
+};
+
+// Welke tile hoort bij de kleur van een pixel in het ontwerp. Alleen helemaal dekkende pixels
+// zijn een tile.
+static u8 get_design_tile(u32 color) {
+    u8 a = (u8)(color >> 24);
+    u8 r = (u8)(color >> 16);
+    u8 g = (u8)(color >> 8);
+    u8 b = (u8)color;
+    if (a != 255) return 0;
+
+    if ((r == 0) && (g == 255) && (b == 0)) return GROUND_TILE;
+    if ((r == 0) && (g == 0) && (b == 255)) return START_TILE;
+    if ((r == 255) && (g == 0) && (b == 255)) return END_TILE;
+    if ((r == 255) && (g == 255) && (b == 0)) return COIN_TILE;
+    if ((r == 255) && (g == 0) && (b == 0)) return DEATH_TILE;
+    if ((r == 127) && (g == 127) && (b == 127)) return SPIKES_TILE;
+    return 0;
+}
+
+// Zoveel bytes heeft encode_level hooguit nodig: in het slechtste geval twee per tile.
+static u64 get_level_size_bound(u32 width, u32 height) {
+    u64 chunks_x = (width + LEVEL_CHUNK_TILES - 1) >> LEVEL_CHUNK_SHIFT;
+    u64 chunks_y = (height + LEVEL_CHUNK_TILES - 1) >> LEVEL_CHUNK_SHIFT;
+    return sizeof(Level_Header) + chunks_x * chunks_y * sizeof(Level_Chunk_Entry) +
+           chunks_x * chunks_y * LEVEL_CHUNK_TILES * LEVEL_CHUNK_TILES * 2;
+}
+
+// Zet width * height tiles (rij voor rij van onder naar boven) om naar een level bestand in
+// output, dat minstens get_level_size_bound groot is. Geeft de grootte van het bestand terug.
+static u64 encode_level(const u8 *tiles, u32 width, u32 height, u8 *output) {
+    Level_Header *header = (Level_Header *)output;
+    memset(header, 0, sizeof(*header));
+    header->magic = LEVEL_MAGIC;
+    header->version = LEVEL_VERSION;
+    header->width = width;
+    header->height = height;
+    header->chunks_x = (width + LEVEL_CHUNK_TILES - 1) >> LEVEL_CHUNK_SHIFT;
+    header->chunks_y = (height + LEVEL_CHUNK_TILES - 1) >> LEVEL_CHUNK_SHIFT;
+
+    Level_Chunk_Entry *entries = (Level_Chunk_Entry *)(header + 1);
+    u32 chunk_count = header->chunks_x * header->chunks_y;
+    u64 offset = sizeof(Level_Header) + (u64)chunk_count * sizeof(Level_Chunk_Entry);
+
+    for (u32 chunk_y = 0; chunk_y < header->chunks_y; chunk_y++) {
+        for (u32 chunk_x = 0; chunk_x < header->chunks_x; chunk_x++) {
+            Level_Chunk_Entry *entry = entries + chunk_y * header->chunks_x + chunk_x;
+            entry->offset = offset;
+            entry->size = 0;
+            entry->reserved = 0;
+
+            u8 *data = output + offset;
+            u32 size = 0;
+            u32 count = 0;
+            u8 run_tile = 0;
+            bool has_tiles = false;
+
+            for (u32 y = 0; y < LEVEL_CHUNK_TILES; y++) {
+                for (u32 x = 0; x < LEVEL_CHUNK_TILES; x++) {
+                    u32 tile_x = chunk_x * LEVEL_CHUNK_TILES + x;
+                    u32 tile_y = chunk_y * LEVEL_CHUNK_TILES + y;
+                    u8 tile = 0;
+                    if ((tile_x < width) && (tile_y < height)) {
+                        tile = tiles[(u64)tile_y * width + tile_x];
+                    }
+
+                    if (tile == START_TILE) {
+                        header->start_x = tile_x;
+                        header->start_y = tile_y;
+                    }
+                    if (tile) has_tiles = true;
+
+                    if ((count > 0) && ((tile != run_tile) || (count == 255))) {
+                        data[size++] = (u8)count;
+                        data[size++] = run_tile;
+                        count = 0;
+                    }
+                    run_tile = tile;
+                    count++;
+                }
+            }
+            data[size++] = (u8)count;
+            data[size++] = run_tile;
+
+            // Een lege chunk hoeft niet in het bestand.
+            if (has_tiles) {
+                entry->size = size;
+                offset += size;
+            } else {
+                entry->offset = 0;
+            }
+        }
+    }
+
+    header->file_size = offset;
+    return offset;
+}
+
+// Controleer of het geheugen een geldig level bestand is, anders geven we 0 terug.
+static Level_Header *get_level_header(void *memory, u64 size) {
+    if (!memory || (size < sizeof(Level_Header))) return 0;
+
+    Level_Header *header = (Level_Header *)memory;
+    if ((header->magic != LEVEL_MAGIC) || (header->version != LEVEL_VERSION) ||
+        (header->file_size != size) || (header->width == 0) || (header->height == 0) ||
+        (header->chunks_x != (header->width + LEVEL_CHUNK_TILES - 1) >> LEVEL_CHUNK_SHIFT) ||
+        (header->chunks_y != (header->height + LEVEL_CHUNK_TILES - 1) >> LEVEL_CHUNK_SHIFT)) {
+        return 0;
+    }
+
+    u64 chunk_count = (u64)header->chunks_x * header->chunks_y;
+    if ((size - sizeof(Level_Header)) / sizeof(Level_Chunk_Entry) < chunk_count) return 0;
+
+    Level_Chunk_Entry *entries = (Level_Chunk_Entry *)(header + 1);
+    for (u64 i = 0; i < chunk_count; i++) {
+        if ((entries[i].offset > size) || (entries[i].size > size - entries[i].offset)) return 0;
+    }
+    return header;
+}
+
+static Level_Chunk_Entry *get_level_chunk_entry(Level_Header *header, u32 chunk_x, u32 chunk_y) {
+    return (Level_Chunk_Entry *)(header + 1) + chunk_y * header->chunks_x + chunk_x;
+}
+
+// Een hash van de header en de lijst chunks, zodat een opname weet op welk level hij gemaakt is.
+// De chunks zelf lezen we niet, want dan haalt het spel het hele level uit het bestand. Twee
+// levels met even grote chunks op precies dezelfde plekken zien we dus als hetzelfde.
+static u32 hash_level_layout(Level_Header *header) {
+    const u8 *bytes = (const u8 *)header;
+    u64 size = sizeof(Level_Header) +
+               (u64)header->chunks_x * header->chunks_y * sizeof(Level_Chunk_Entry);
+
+    u32 hash = 2166136261u;
+    for (u64 i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Pak een chunk uit naar LEVEL_CHUNK_TILES * LEVEL_CHUNK_TILES tiles, rij voor rij. Geeft false
+// terug als de data niet klopt.
+static bool decode_level_chunk(Level_Header *header, Level_Chunk_Entry *entry, u8 *tiles) {
+    const u8 *data = (const u8 *)header + entry->offset;
+    const u8 *end = data + entry->size;
+    u32 tile_count = LEVEL_CHUNK_TILES * LEVEL_CHUNK_TILES;
+
+    u32 i = 0;
+    while (i < tile_count) {
+        if (end - data < 2) return false;
+        u32 count = data[0];
+        u8 tile = data[1];
+        data += 2;
+        if ((count == 0) || (count > tile_count - i)) return false;
+
+        memset(tiles + i, tile, count);
+        i += count;
+    }
+    return data == end;
+}
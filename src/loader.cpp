@@ -0,0 +1,245 @@
+// NOTE: Uitleg asset loader.
+// De grote plaatjes (de achtergrond en de menu's) lieten we eerst pas laden op het moment dat we
+// van state wisselden, en dan stond de frame stil tot de bitmap van de schijf was. Nu vragen we ze
+// van tevoren aan met request_sprite. Een eigen thread laadt ze een voor een in de asset cache, en
+// de game kijkt elke frame met get_loaded_sprite of ze al klaar zijn. Dat wacht nooit: is een
+// sprite nog niet klaar, dan tekent de game die frame iets anders (zie clear_screen).
+//
+// Een aanvraag krijg je terug als een Load_Handle. Die bevat naast de plek in requests ook een
+// generation, zodat een oude handle niet per ongeluk een nieuwe aanvraag op dezelfde plek
+// gebruikt. Een handle met generation 0 is leeg.
+//
+// Alleen de state van een aanvraag wordt door beide threads gebruikt. Die veranderen we alleen
+// binnen lock, en de worker zet de asset in de aanvraag voordat hij de state op LOAD_READY zet.
+#define MAX_LOAD_REQUESTS 16
+#define LOAD_FILENAME_SIZE 128
+
+// Hiermee maken we het scherm leeg zolang een plaatje nog niet geladen is.
+#define LOADING_COLOR 0xFF000000
+
+enum Load_State {
+    LOAD_FREE,
+    LOAD_QUEUED,
+    LOAD_LOADING,
+    LOAD_READY,
+};
+
+struct Load_Handle {
+    u32 index;
+    u32 generation;
+};
+
+struct Load_Request {
+    char filename[LOAD_FILENAME_SIZE];
+    bool build_spans;
+    u32 generation;
+    volatile LONG state;
+    // Als de game de sprite niet meer nodig heeft terwijl hij nog geladen wordt, geeft de worker
+    // hem vrij als hij klaar is.
+    bool released;
+    Asset_Handle asset;
+
+#if PROFILE
+    i64 queued_time;
+#endif
+};
+
+struct Asset_Loader {
+    Load_Request requests[MAX_LOAD_REQUESTS];
+
+    // De indices van de aanvragen die nog geladen moeten worden, op volgorde van aanvragen.
+    u32 queue[MAX_LOAD_REQUESTS];
+    u32 queue_read;
+    u32 queue_write;
+    u32 queue_depth;
+
+    CRITICAL_SECTION lock;
+    HANDLE semaphore;
+    HANDLE thread;
+    bool quit;
+
+#if PROFILE
+    i64 frequency;
+    u32 max_queue_depth;
+#endif
+};
+
+static DWORD WINAPI loader_proc(LPVOID parameter) {
+    Asset_Loader *loader = (Asset_Loader *)parameter;
+
+    for (;;) {
+        WaitForSingleObject(loader->semaphore, INFINITE);
+
+        EnterCriticalSection(&loader->lock);
+        if (loader->quit) {
+            LeaveCriticalSection(&loader->lock);
+            return 0;
+        }
+        u32 index = loader->queue[loader->queue_read];
+        loader->queue_read = (loader->queue_read + 1) % MAX_LOAD_REQUESTS;
+        loader->queue_depth--;
+        Load_Request *request = loader->requests + index;
+        request->state = LOAD_LOADING;
+        LeaveCriticalSection(&loader->lock);
+
+#if PROFILE
+        LARGE_INTEGER load_start;
+        QueryPerformanceCounter(&load_start);
+#endif
+
+        // Er mag maar een thread tegelijk aan een aanvraag zitten, dus dit kan buiten lock.
+        Asset_Handle asset = acquire_sprite(request->filename, request->build_spans);
+
+#if PROFILE
+        LARGE_INTEGER load_end;
+        QueryPerformanceCounter(&load_end);
+        char text[256];
+        StringCbPrintfA(text, 256, "Loader %s: %.3fms in de rij, %.3fms laden, rij %u (max %u)\n",
+                        request->filename,
+                        (f64)(load_start.QuadPart - request->queued_time) * 1000.0 /
+                            (f64)loader->frequency,
+                        (f64)(load_end.QuadPart - load_start.QuadPart) * 1000.0 /
+                            (f64)loader->frequency,
+                        loader->queue_depth, loader->max_queue_depth);
+        OutputDebugStringA(text);
+#endif
+
+        EnterCriticalSection(&loader->lock);
+        if (request->released) {
+            release_asset(&asset);
+            request->state = LOAD_FREE;
+        } else {
+            request->asset = asset;
+            request->state = LOAD_READY;
+        }
+        LeaveCriticalSection(&loader->lock);
+    }
+}
+
+static void initialize_asset_loader(Asset_Loader *loader) {
+    InitializeCriticalSection(&loader->lock);
+    loader->semaphore = CreateSemaphoreA(0, 0, MAX_LOAD_REQUESTS + 1, 0);
+    loader->thread = CreateThread(0, 0, loader_proc, loader, 0, 0);
+
+#if PROFILE
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    loader->frequency = frequency.QuadPart;
+#endif
+}
+
+// Stop de worker en geef alle geladen sprites vrij. Dit moet voor close_asset_pack, want de
+// sprites kunnen naar het pack wijzen.
+static void close_asset_loader(Asset_Loader *loader) {
+    EnterCriticalSection(&loader->lock);
+    loader->quit = true;
+    LeaveCriticalSection(&loader->lock);
+    ReleaseSemaphore(loader->semaphore, 1, 0);
+    WaitForSingleObject(loader->thread, INFINITE);
+
+    for (u32 i = 0; i < MAX_LOAD_REQUESTS; i++) {
+        if (loader->requests[i].state == LOAD_READY) {
+            release_asset(&loader->requests[i].asset);
+        }
+    }
+    CloseHandle(loader->thread);
+    CloseHandle(loader->semaphore);
+    DeleteCriticalSection(&loader->lock);
+}
+
+static Load_Request *get_load_request(Asset_Loader *loader, Load_Handle handle) {
+    if ((handle.generation == 0) || (handle.index >= MAX_LOAD_REQUESTS)) return 0;
+
+    Load_Request *request = loader->requests + handle.index;
+    if (request->generation != handle.generation) return 0;
+    return request;
+}
+
+// Zet een bitmap in de rij om geladen te worden. Als alle plekken vol zijn krijg je een lege
+// handle terug, en blijft de game gewoon zijn fallback tekenen.
+static Load_Handle request_sprite(Asset_Loader *loader, const char *filename,
+                                  bool build_spans = false) {
+    Load_Handle handle = {};
+
+    EnterCriticalSection(&loader->lock);
+    for (u32 i = 0; i < MAX_LOAD_REQUESTS; i++) {
+        Load_Request *request = loader->requests + i;
+        if (request->state != LOAD_FREE) continue;
+
+        StringCbCopyA(request->filename, LOAD_FILENAME_SIZE, filename);
+        request->build_spans = build_spans;
+        request->released = false;
+        request->asset = {};
+        request->generation++;
+        if (request->generation == 0) request->generation = 1;
+        request->state = LOAD_QUEUED;
+
+#if PROFILE
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        request->queued_time = now.QuadPart;
+#endif
+
+        loader->queue[loader->queue_write] = i;
+        loader->queue_write = (loader->queue_write + 1) % MAX_LOAD_REQUESTS;
+        loader->queue_depth++;
+#if PROFILE
+        loader->max_queue_depth = maximum(loader->max_queue_depth, loader->queue_depth);
+#endif
+
+        handle.index = i;
+        handle.generation = request->generation;
+        break;
+    }
+    LeaveCriticalSection(&loader->lock);
+
+    if (handle.generation) {
+        ReleaseSemaphore(loader->semaphore, 1, 0);
+    } else {
+        OutputDebugStringA("De loader zit vol, de sprite wordt niet geladen.\n");
+    }
+    return handle;
+}
+
+// Vraag een sprite alleen aan als de handle nog leeg is, zodat we dezelfde state meerdere keren
+// mogen prefetchen.
+static void prefetch_sprite(Asset_Loader *loader, Load_Handle *handle, const char *filename) {
+    if (!get_load_request(loader, *handle)) {
+        *handle = request_sprite(loader, filename);
+    }
+}
+
+// Geeft de sprite terug als hij klaar is, en anders 0. Dit wacht nooit op de worker.
+static Sprite *get_loaded_sprite(Asset_Loader *loader, Load_Handle handle) {
+    Load_Request *request = get_load_request(loader, handle);
+    if (!request || (request->state != LOAD_READY)) return 0;
+
+    // Als de bitmap niet geladen kon worden geeft get_sprite ook 0.
+    return get_sprite(request->asset);
+}
+
+// Staat de sprite nog in de rij of wordt hij nu geladen? Dan heeft het zin om het de volgende frame
+// opnieuw te proberen.
+static bool is_sprite_loading(Asset_Loader *loader, Load_Handle handle) {
+    Load_Request *request = get_load_request(loader, handle);
+    return request && (request->state != LOAD_READY);
+}
+
+static void release_sprite(Asset_Loader *loader, Load_Handle *handle) {
+    EnterCriticalSection(&loader->lock);
+    Load_Request *request = get_load_request(loader, *handle);
+    if (request) {
+        if (request->state == LOAD_READY) {
+            release_asset(&request->asset);
+            request->state = LOAD_FREE;
+        } else {
+            // De worker heeft hem nog, die geeft hem vrij als hij klaar is.
+            request->released = true;
+        }
+        // Zo werkt een oude handle niet meer, ook niet als de worker nog bezig is.
+        request->generation++;
+        if (request->generation == 0) request->generation = 1;
+    }
+    LeaveCriticalSection(&loader->lock);
+    *handle = {};
+}
@@ -0,0 +1,93 @@
+// NOTE: Uitleg arenas.
+// In plaats van voor alles een eigen VirtualAlloc te doen en dat later weer los vrij te geven,
+// zetten we dingen die even lang leven samen in een arena. Een arena reserveert in een keer een
+// groot stuk adresruimte en geeft daar met push_size steeds het volgende stukje van uit. Vrijgeven
+// doe je niet per stukje, maar met reset_arena voor alles tegelijk, en dat is alleen used op 0
+// zetten.
+//
+// We hebben er drie:
+// - permanent_arena: dingen die het hele spel blijven bestaan (de render queue, de atlas).
+// - level_arena: de tile maps, die gaan in een keer weg als we de levels opnieuw laden.
+// - frame_arena: tijdelijk geheugen, aan het begin van elke frame leeg.
+//
+// De arenas zijn niet thread safe, gebruik ze alleen op de main thread.
+#define ARENA_COMMIT_SIZE (64 * 1024)
+
+struct Arena {
+    const char *name;
+    u8 *base;
+    u64 reserved;
+    u64 committed;
+    u64 used;
+    // Het meeste dat ooit tegelijk in gebruik was, zodat we weten hoe groot de arena moet zijn.
+    u64 high_water;
+};
+
+static Arena permanent_arena;
+static Arena level_arena;
+static Arena frame_arena;
+
+static void initialize_arena(Arena *arena, const char *name, u64 reserve_size) {
+    arena->name = name;
+    arena->base = (u8 *)VirtualAlloc(0, reserve_size, MEM_RESERVE, PAGE_READWRITE);
+    arena->reserved = arena->base ? reserve_size : 0;
+    arena->committed = 0;
+    arena->used = 0;
+    arena->high_water = 0;
+}
+
+static void initialize_arenas() {
+    initialize_arena(&permanent_arena, "permanent", 256ull * 1024 * 1024);
+    initialize_arena(&level_arena, "level", 64ull * 1024 * 1024);
+    initialize_arena(&frame_arena, "frame", 64ull * 1024 * 1024);
+}
+
+// Geeft size bytes terug, uitgelijnd op align (een macht van 2), en altijd leeg. Geheugen boven
+// high_water is nog nooit gebruikt en dus al 0, alleen wat daaronder zit moeten we leegmaken.
+static void *push_size(Arena *arena, u64 size, u64 align = 16) {
+    u64 start = (arena->used + align - 1) & ~(align - 1);
+    u64 end = start + size;
+    if (end > arena->reserved) {
+        char text[256];
+        StringCbPrintfA(text, 256, "De %s arena is vol!", arena->name);
+        MessageBoxA(0, text, "Geheugen", MB_OK);
+        return 0;
+    }
+
+    // We committen pas als we het geheugen echt nodig hebben, in stukken van ARENA_COMMIT_SIZE.
+    if (end > arena->committed) {
+        u64 commit_end = (end + ARENA_COMMIT_SIZE - 1) & ~(u64)(ARENA_COMMIT_SIZE - 1);
+        commit_end = minimum(commit_end, arena->reserved);
+        if (!VirtualAlloc(arena->base + arena->committed, commit_end - arena->committed,
+                          MEM_COMMIT, PAGE_READWRITE)) {
+            MessageBoxA(0, "Kon geen geheugen krijgen!", "Geheugen", MB_OK);
+            return 0;
+        }
+        arena->committed = commit_end;
+    }
+
+    if (start < arena->high_water) {
+        memset(arena->base + start, 0, minimum(end, arena->high_water) - start);
+    }
+
+    arena->used = end;
+    arena->high_water = maximum(arena->high_water, arena->used);
+    return arena->base + start;
+}
+
+#define push_array(arena, type, count) ((type *)push_size((arena), sizeof(type) * (count)))
+
+static void reset_arena(Arena *arena) {
+    arena->used = 0;
+}
+
+static void log_arenas() {
+    Arena *arenas[] = {&permanent_arena, &level_arena, &frame_arena};
+    for (u32 i = 0; i < 3; i++) {
+        char text[256];
+        StringCbPrintfA(text, 256, "Arena %s: %lluKB in gebruik, hoogste %lluKB, %lluKB gecommit\n",
+                        arenas[i]->name, arenas[i]->used / 1024, arenas[i]->high_water / 1024,
+                        arenas[i]->committed / 1024);
+        OutputDebugStringA(text);
+    }
+}
@@ -0,0 +1,263 @@
+// NOTE: Uitleg asset pack.
+// In plaats van elk plaatje en geluid los van de schijf te lezen (en elke keer de headers te
+// ontleden), zet de packer (zie packer.cpp) alles uit assets en levels in een bestand. Het spel
+// mapt dat bestand in het geheugen en geeft Sprites en Sounds die direct naar de data in het
+// bestand wijzen, er wordt niks gekopieerd.
+//
+// Het bestand ziet er zo uit:
+// - Pack_Header
+// - De data van alle entries, elk op PACK_ALIGN bytes. Voor een sprite zijn dat de pixels (32 bits,
+//   de onderste rij eerst, net als in een bitmap), of de ingepakte pixels als de sprite de flag
+//   PACK_COMPRESSED heeft (zie decode_sprite_pixels). Voor een geluid de PCM samples.
+// - De Pack_Entry tabel.
+//
+// Dit bestand gebruikt alleen vaste types en geen Windows functies, zodat de packer het ook op
+// Linux kan gebruiken. Het mappen van het bestand staat onderaan, buiten de packer.
+#define PACK_MAGIC 0x314B4150 // "PAK1"
+#define PACK_VERSION 2
+#define PACK_ALIGN 64
+#define PACK_NAME_SIZE 64
+
+enum Pack_Type {
+    PACK_SPRITE = 1,
+    PACK_SOUND = 2,
+};
+
+// Flags van een sprite.
+#define PACK_OPAQUE 1
+#define PACK_COMPRESSED 2
+
+struct Pack_Header {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 reserved;
+    u64 entries_offset;
+    u64 file_size;
+};
+
+struct Pack_Entry {
+    // De naam zoals het spel hem vraagt, bijvoorbeeld "assets\walk_right\0.bmp".
+    char name[PACK_NAME_SIZE];
+    u32 name_hash;
+    u32 type;
+    u64 offset;
+    u64 size;
+
+    // Sprite. Bij een ingepakte sprite is size de grootte van de ingepakte data.
+    u32 width;
+    u32 height;
+    u32 flags;
+
+    // Geluid, dezelfde velden als WAVEFORMATEX.
+    u16 format_tag;
+    u16 channels;
+    u32 samples_per_sec;
+    u32 bytes_per_sec;
+    u16 block_align;
+    u16 bits_per_sample;
+};
+
+// Namen vergelijken we zonder op hoofdletters te letten, en / is hetzelfde als \, net als bij
+// bestanden op Windows.
+static char normalize_pack_char(char c) {
+    if (c == '/') return '\\';
+    if ((c >= 'A') && (c <= 'Z')) return c - 'A' + 'a';
+    return c;
+}
+
+// FNV-1a.
+static u32 hash_pack_name(const char *name) {
+    u32 hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (u8)normalize_pack_char(*name);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool pack_names_equal(const char *a, const char *b) {
+    for (; *a && *b; a++, b++) {
+        if (normalize_pack_char(*a) != normalize_pack_char(*b)) return false;
+    }
+    return *a == *b;
+}
+
+// Controleer of het geheugen een geldig pack is, anders geven we 0 terug.
+static Pack_Header *get_pack_header(void *memory, u64 size) {
+    if (!memory || (size < sizeof(Pack_Header))) return 0;
+
+    Pack_Header *header = (Pack_Header *)memory;
+    if ((header->magic != PACK_MAGIC) || (header->version != PACK_VERSION) ||
+        (header->file_size != size) || (header->entries_offset > size) ||
+        ((size - header->entries_offset) / sizeof(Pack_Entry) < header->entry_count)) {
+        return 0;
+    }
+
+    Pack_Entry *entries = (Pack_Entry *)((u8 *)memory + header->entries_offset);
+    for (u32 i = 0; i < header->entry_count; i++) {
+        if ((entries[i].offset > size) || (entries[i].size > size - entries[i].offset)) return 0;
+    }
+    return header;
+}
+
+static Pack_Entry *get_pack_entries(Pack_Header *header) {
+    return (Pack_Entry *)((u8 *)header + header->entries_offset);
+}
+
+static void *get_pack_data(Pack_Header *header, Pack_Entry *entry) {
+    return (u8 *)header + entry->offset;
+}
+
+// Er zijn maar een paar honderd entries, dus we zoeken gewoon van voor naar achter en vergelijken
+// eerst de hash.
+static Pack_Entry *find_pack_entry(Pack_Header *header, const char *name, u32 type) {
+    if (!header) return 0;
+
+    u32 hash = hash_pack_name(name);
+    Pack_Entry *entries = get_pack_entries(header);
+    for (u32 i = 0; i < header->entry_count; i++) {
+        Pack_Entry *entry = entries + i;
+        if ((entry->name_hash == hash) && (entry->type == type) &&
+            pack_names_equal(entry->name, name)) {
+            return entry;
+        }
+    }
+    return 0;
+}
+
+// NOTE: Uitleg ingepakte sprites.
+// De grote plaatjes (tips en menu's) bestaan vooral uit lange stukken dezelfde kleur, zoals de
+// doorzichtige rand, en uit rijen die bijna hetzelfde zijn als de rij eronder. Daarom pakt de
+// packer zulke sprites in als een lijst runs van 32 bits woorden. Elke run begint met een woord
+// met bovenin het soort run en onderin het aantal pixels:
+// - PACK_RUN_FILL: een woord met een kleur, die count keer herhaald wordt.
+// - PACK_RUN_COPY: count woorden met losse pixels.
+// - PACK_RUN_ROW: count pixels die hetzelfde zijn als in de rij eronder.
+// Een run gaat nooit over het einde van een rij heen, dus een PACK_RUN_ROW overlapt nooit met de
+// pixels die hij schrijft en kunnen we hem net als de andere runs met 4 pixels tegelijk doen.
+#define PACK_RUN_FILL 0
+#define PACK_RUN_COPY 1
+#define PACK_RUN_ROW 2
+#define PACK_RUN_SHIFT 30
+#define PACK_RUN_COUNT_MASK ((1u << PACK_RUN_SHIFT) - 1)
+
+static void copy_pixels_sse2(u32 *dest, const u32 *source, u32 count) {
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_loadu_si128((__m128i *)(source + i)));
+    }
+    for (; i < count; i++) {
+        dest[i] = source[i];
+    }
+}
+
+// Pak de runs uit naar width * height pixels. Geeft false terug als de data niet klopt, dan is de
+// inhoud van pixels onbepaald.
+static bool decode_sprite_pixels(const u8 *data, u64 size, u32 *pixels, u32 width, u32 height) {
+    const u32 *word = (const u32 *)data;
+    const u32 *end = word + size / 4;
+
+    for (u32 y = 0; y < height; y++) {
+        u32 *row = pixels + (u64)y * width;
+        u32 x = 0;
+        while (x < width) {
+            if (word >= end) return false;
+            u32 token = *word++;
+            u32 count = token & PACK_RUN_COUNT_MASK;
+            if ((count == 0) || (count > width - x)) return false;
+
+            u32 *dest = row + x;
+            switch (token >> PACK_RUN_SHIFT) {
+                case PACK_RUN_FILL: {
+                    if (word >= end) return false;
+                    u32 color = *word++;
+                    __m128i colors = _mm_set1_epi32((i32)color);
+                    u32 i = 0;
+                    for (; i + 8 <= count; i += 8) {
+                        _mm_storeu_si128((__m128i *)(dest + i), colors);
+                        _mm_storeu_si128((__m128i *)(dest + i + 4), colors);
+                    }
+                    for (; i < count; i++) {
+                        dest[i] = color;
+                    }
+                    break;
+                }
+
+                case PACK_RUN_COPY: {
+                    if (count > (u64)(end - word)) return false;
+                    copy_pixels_sse2(dest, word, count);
+                    word += count;
+                    break;
+                }
+
+                case PACK_RUN_ROW: {
+                    if (y == 0) return false;
+                    copy_pixels_sse2(dest, dest - width, count);
+                    break;
+                }
+
+                default: {
+                    return false;
+                }
+            }
+            x += count;
+        }
+    }
+    return word == end;
+}
+
+#if !PACKER
+struct Asset_Pack {
+    HANDLE file;
+    HANDLE mapping;
+    Pack_Header *header;
+};
+
+// Als er een pack is, halen load_bitmap en load_sound alles hieruit. Anders lezen ze de losse
+// bestanden zoals vroeger.
+static Asset_Pack asset_pack;
+
+static bool open_asset_pack(const char *filename) {
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        OutputDebugStringA("Geen asset pack gevonden, we laden de losse bestanden.\n");
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    HANDLE mapping = 0;
+    void *memory = 0;
+    if (GetFileSizeEx(file, &file_size)) {
+        mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    }
+    if (mapping) {
+        memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    Pack_Header *header = get_pack_header(memory, (u64)file_size.QuadPart);
+    if (!header) {
+        MessageBoxA(0, "Het asset pack is kapot, we laden de losse bestanden.", "Asset pack",
+                    MB_OK);
+        if (memory) UnmapViewOfFile(memory);
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    asset_pack.file = file;
+    asset_pack.mapping = mapping;
+    asset_pack.header = header;
+    return true;
+}
+
+static void close_asset_pack() {
+    if (!asset_pack.header) return;
+
+    UnmapViewOfFile(asset_pack.header);
+    CloseHandle(asset_pack.mapping);
+    CloseHandle(asset_pack.file);
+    asset_pack = {};
+}
+#endif
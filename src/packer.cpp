@@ -0,0 +1,711 @@
+// De packer zet alle bitmaps en geluiden uit assets en levels in een asset pack (zie pack.cpp).
+// Draai hem vanuit de map van het spel:
+//     packer [assets.pak]           maak het pack
+//     packer -verify [assets.pak]   controleer een pack tegen de losse bestanden, en laat zien hoe
+//                                   snel de ingepakte sprites uitpakken
+//     packer -levels                zet elk ontwerp in levels om naar een level bestand (zie
+//                                   level.cpp), dus levels\1.bmp naar levels\1.lvl
+//     packer -synthetic 10000x1000 levels\groot.lvl
+//                                   maak een groot level om de level streamer mee te testen,
+//                                   speel het met pilot -level levels\groot.lvl
+//
+// Bouwen op Windows gaat met build.bat, op Linux met:
+//     g++ -O2 -o packer src/packer.cpp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <emmintrin.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#define i8 char
+#define i16 short
+#define i32 int
+#define i64 long long
+
+#define u8 unsigned char
+#define u16 unsigned short
+#define u32 unsigned int
+#define u64 unsigned long long
+
+#define f32 float
+#define f64 double
+
+#define shift(x) 1 << (x)
+
+#define PACKER 1
+#include "pack.cpp"
+#include "level.cpp"
+
+#define MAX_PACK_ENTRIES 1024
+
+// Dezelfde headers als in draw.cpp en audio.cpp.
+#pragma pack(push, 1)
+struct Bitmap_Header {
+    u16 file_type;
+    u32 file_size;
+    u16 reserved1;
+    u16 reserved2;
+    u32 bitmap_offset;
+
+    u32 size;
+    u32 width;
+    i32 height;
+    u16 planes;
+    u16 bits_per_pixel;
+    u32 compression;
+};
+
+struct Wave_Header {
+    u8 RIFF[4];
+    u32 chunk_size;
+    u8 WAVE[4];
+
+    u8 fmt[4];
+    u32 subchunk1_size;
+    u16 audio_format;
+    u16 number_channels;
+    u32 samples_per_sec;
+    u32 bytes_per_sec;
+    u16 block_align;
+    u16 bits_per_sample;
+};
+#pragma pack(pop)
+
+struct File_List {
+    char names[MAX_PACK_ENTRIES][PACK_NAME_SIZE];
+    u32 count;
+};
+
+static bool has_extension(const char *name, const char *extension) {
+    size_t length = strlen(name);
+    size_t extension_length = strlen(extension);
+    if (length < extension_length) return false;
+
+    const char *end = name + length - extension_length;
+    for (size_t i = 0; i < extension_length; i++) {
+        if (normalize_pack_char(end[i]) != normalize_pack_char(extension[i])) return false;
+    }
+    return true;
+}
+
+static void add_file(File_List *list, const char *name) {
+    if (!has_extension(name, ".bmp") && !has_extension(name, ".wav")) return;
+
+    if (strlen(name) >= PACK_NAME_SIZE) {
+        fprintf(stderr, "Naam te lang, overgeslagen: %s\n", name);
+        return;
+    }
+    if (list->count == MAX_PACK_ENTRIES) {
+        fprintf(stderr, "Te veel bestanden, overgeslagen: %s\n", name);
+        return;
+    }
+
+    strcpy(list->names[list->count++], name);
+}
+
+// Zoek alle bestanden in een map en de mappen daaronder. De namen krijgen backslashes, net als in
+// het spel.
+static void find_files(File_List *list, const char *directory) {
+    char path[512];
+
+#ifdef _WIN32
+    snprintf(path, sizeof(path), "%s\\*", directory);
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(path, &data);
+    if (find == INVALID_HANDLE_VALUE) return;
+
+    do {
+        if (!strcmp(data.cFileName, ".") || !strcmp(data.cFileName, "..")) continue;
+        snprintf(path, sizeof(path), "%s\\%s", directory, data.cFileName);
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            find_files(list, path);
+        } else {
+            add_file(list, path);
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    char disk_path[512];
+    strcpy(disk_path, directory);
+    for (char *c = disk_path; *c; c++) {
+        if (*c == '\\') *c = '/';
+    }
+
+    DIR *dir = opendir(disk_path);
+    if (!dir) return;
+
+    struct dirent *item;
+    while ((item = readdir(dir))) {
+        if (!strcmp(item->d_name, ".") || !strcmp(item->d_name, "..")) continue;
+        snprintf(path, sizeof(path), "%s\\%s", directory, item->d_name);
+
+        char item_path[512];
+        snprintf(item_path, sizeof(item_path), "%s/%s", disk_path, item->d_name);
+        struct stat info;
+        if (stat(item_path, &info) != 0) continue;
+
+        if (S_ISDIR(info.st_mode)) {
+            find_files(list, path);
+        } else {
+            add_file(list, path);
+        }
+    }
+    closedir(dir);
+#endif
+}
+
+// Lees een heel bestand. De naam heeft backslashes, die maken we op Linux weer slashes.
+static u8 *read_entire_file(const char *name, u64 *size) {
+    char path[PACK_NAME_SIZE];
+    strcpy(path, name);
+#ifndef _WIN32
+    for (char *c = path; *c; c++) {
+        if (*c == '\\') *c = '/';
+    }
+#endif
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return 0;
+
+    fseek(file, 0, SEEK_END);
+    *size = (u64)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8 *memory = (u8 *)malloc(*size ? *size : 1);
+    if (fread(memory, 1, *size, file) != *size) {
+        free(memory);
+        memory = 0;
+    }
+    fclose(file);
+    return memory;
+}
+
+// Haal de pixels uit een bitmap, met de onderste rij eerst net als load_bitmap.
+static bool parse_bitmap(u8 *file, u64 file_size, Pack_Entry *entry, u8 **data) {
+    if (file_size < sizeof(Bitmap_Header)) return false;
+
+    Bitmap_Header *header = (Bitmap_Header *)file;
+    if ((header->file_type != 0x4D42) || (header->bits_per_pixel != 32) ||
+        (header->compression != 0)) {
+        return false;
+    }
+
+    u32 height = (u32)(header->height < 0 ? -header->height : header->height);
+    u64 size = (u64)header->width * height * 4;
+    if ((header->bitmap_offset > file_size) || (size > file_size - header->bitmap_offset)) {
+        return false;
+    }
+
+    u32 *pixels = (u32 *)malloc(size ? size : 1);
+    u32 *source = (u32 *)(file + header->bitmap_offset);
+    for (u32 y = 0; y < height; y++) {
+        // Een negatieve hoogte betekent dat de bovenste rij eerst staat, die draaien we om.
+        u32 source_y = (header->height < 0) ? (height - 1 - y) : y;
+        memcpy(pixels + (u64)y * header->width, source + (u64)source_y * header->width,
+               header->width * 4);
+    }
+
+    entry->type = PACK_SPRITE;
+    entry->width = header->width;
+    entry->height = height;
+    entry->size = size;
+    entry->flags = PACK_OPAQUE;
+    for (u64 i = 0; i < (u64)header->width * height; i++) {
+        if ((pixels[i] >> 24) == 0) {
+            entry->flags &= ~PACK_OPAQUE;
+            break;
+        }
+    }
+
+    *data = (u8 *)pixels;
+    return true;
+}
+
+// Zoek het data stuk van een wave bestand, net als load_sound.
+static bool parse_wave(u8 *file, u64 file_size, Pack_Entry *entry, u8 **data) {
+    if (file_size < sizeof(Wave_Header) + 8) return false;
+
+    Wave_Header *header = (Wave_Header *)file;
+    if (memcmp(header->RIFF, "RIFF", 4) || memcmp(header->WAVE, "WAVE", 4)) return false;
+
+    u64 position = sizeof(Wave_Header);
+    while ((position + 8 <= file_size) && memcmp(file + position, "data", 4)) {
+        position++;
+    }
+    if (position + 8 > file_size) return false;
+
+    u32 size = *(u32 *)(file + position + 4);
+    if (size > file_size - position - 8) return false;
+
+    entry->type = PACK_SOUND;
+    entry->size = size;
+    entry->format_tag = header->audio_format;
+    entry->channels = header->number_channels;
+    entry->samples_per_sec = header->samples_per_sec;
+    entry->bytes_per_sec = header->bytes_per_sec;
+    entry->block_align = header->block_align;
+    entry->bits_per_sample = header->bits_per_sample;
+
+    *data = (u8 *)malloc(size ? size : 1);
+    memcpy(*data, file + position + 8, size);
+    return true;
+}
+
+// Hoeveel pixels vanaf het begin hetzelfde zijn.
+static u32 get_match_length(u32 *a, u32 *b, u32 count) {
+    u32 length = 0;
+    while ((length < count) && (a[length] == b[length])) {
+        length++;
+    }
+    return length;
+}
+
+static void write_run(u32 *output, u32 *size, u32 type, u32 count) {
+    output[(*size)++] = (type << PACK_RUN_SHIFT) | count;
+}
+
+static void write_literals(u32 *output, u32 *size, u32 *pixels, u32 count) {
+    if (count == 0) return;
+    write_run(output, size, PACK_RUN_COPY, count);
+    memcpy(output + *size, pixels, count * 4);
+    *size += count;
+}
+
+// Pak de pixels in met de runs uit pack.cpp. We kiezen steeds de langste run: een kopie van de rij
+// eronder kost een woord, een kleur herhalen twee. Wat in geen van beide past komt in een
+// PACK_RUN_COPY. Geeft het aantal woorden terug.
+static u32 encode_sprite_pixels(u32 *pixels, u32 width, u32 height, u32 *output) {
+    u32 size = 0;
+    for (u32 y = 0; y < height; y++) {
+        u32 *row = pixels + (u64)y * width;
+        u32 *below = y ? row - width : 0;
+
+        u32 literal_start = 0;
+        u32 x = 0;
+        while (x < width) {
+            u32 remaining = width - x;
+            u32 fill = 1 + get_match_length(row + x, row + x + 1, remaining - 1);
+            u32 copy = below ? get_match_length(row + x, below + x, remaining) : 0;
+
+            if ((copy >= 2) && (copy >= fill)) {
+                write_literals(output, &size, row + literal_start, x - literal_start);
+                write_run(output, &size, PACK_RUN_ROW, copy);
+                x += copy;
+                literal_start = x;
+            } else if (fill >= 3) {
+                write_literals(output, &size, row + literal_start, x - literal_start);
+                write_run(output, &size, PACK_RUN_FILL, fill);
+                output[size++] = row[x];
+                x += fill;
+                literal_start = x;
+            } else {
+                x++;
+            }
+        }
+        write_literals(output, &size, row + literal_start, x - literal_start);
+    }
+    return size;
+}
+
+// Een sprite pakken we alleen in als dat veel scheelt. Anders laten we hem zoals hij is, dan kan
+// het spel direct naar de pixels in het pack wijzen.
+static void compress_sprite(Pack_Entry *entry, u8 **data) {
+    u64 pixel_count = (u64)entry->width * entry->height;
+    if (pixel_count < 1024) return;
+
+    // Per pixel hooguit een woord plus de kop van de run.
+    u32 *output = (u32 *)malloc(pixel_count * 8 + 16);
+    u32 words = encode_sprite_pixels((u32 *)*data, entry->width, entry->height, output);
+    if ((u64)words * 4 * 4 > entry->size * 3) {
+        free(output);
+        return;
+    }
+
+    free(*data);
+    *data = (u8 *)output;
+    entry->size = (u64)words * 4;
+    entry->flags |= PACK_COMPRESSED;
+}
+
+static f64 get_seconds() {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (f64)time.tv_sec + (f64)time.tv_nsec * 1e-9;
+}
+
+static bool parse_file(const char *name, Pack_Entry *entry, u8 **data) {
+    u64 file_size;
+    u8 *file = read_entire_file(name, &file_size);
+    if (!file) return false;
+
+    bool result = has_extension(name, ".bmp") ? parse_bitmap(file, file_size, entry, data)
+                                              : parse_wave(file, file_size, entry, data);
+    free(file);
+    return result;
+}
+
+static void write_padding(FILE *file, u64 *offset) {
+    static u8 zeros[PACK_ALIGN];
+    u64 padding = (PACK_ALIGN - (*offset % PACK_ALIGN)) % PACK_ALIGN;
+    fwrite(zeros, 1, padding, file);
+    *offset += padding;
+}
+
+static int write_pack(const char *output) {
+    static File_List list;
+    find_files(&list, "assets");
+    find_files(&list, "levels");
+
+    FILE *file = fopen(output, "wb");
+    if (!file) {
+        fprintf(stderr, "Kan %s niet schrijven.\n", output);
+        return 1;
+    }
+
+    static Pack_Entry entries[MAX_PACK_ENTRIES];
+    Pack_Header header = {};
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    fwrite(&header, sizeof(header), 1, file);
+    u64 offset = sizeof(header);
+    u64 raw_bytes = 0;
+    u32 compressed_count = 0;
+
+    for (u32 i = 0; i < list.count; i++) {
+        Pack_Entry *entry = entries + header.entry_count;
+        memset(entry, 0, sizeof(*entry));
+
+        u8 *data = 0;
+        if (!parse_file(list.names[i], entry, &data)) {
+            fprintf(stderr, "Overgeslagen (geen 32 bits bitmap of PCM wave): %s\n",
+                    list.names[i]);
+            continue;
+        }
+
+        raw_bytes += entry->size;
+        if (entry->type == PACK_SPRITE) {
+            compress_sprite(entry, &data);
+            if (entry->flags & PACK_COMPRESSED) compressed_count++;
+        }
+
+        strcpy(entry->name, list.names[i]);
+        entry->name_hash = hash_pack_name(entry->name);
+
+        write_padding(file, &offset);
+        entry->offset = offset;
+        fwrite(data, 1, entry->size, file);
+        offset += entry->size;
+        free(data);
+
+        header.entry_count++;
+    }
+
+    write_padding(file, &offset);
+    header.entries_offset = offset;
+    fwrite(entries, sizeof(Pack_Entry), header.entry_count, file);
+    header.file_size = offset + sizeof(Pack_Entry) * header.entry_count;
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fclose(file);
+
+    printf("%u bestanden in %s gezet (%llu KB, zonder inpakken %llu KB, %u sprites ingepakt).\n",
+           header.entry_count, output, header.file_size / 1024, raw_bytes / 1024,
+           compressed_count);
+    return 0;
+}
+
+// Lees het pack terug met dezelfde code als het spel, en vergelijk elke entry met het losse
+// bestand.
+static int verify_pack(const char *input) {
+    u64 size;
+    u8 *memory = read_entire_file(input, &size);
+    Pack_Header *header = get_pack_header(memory, memory ? size : 0);
+    if (!header) {
+        fprintf(stderr, "%s is geen geldig pack.\n", input);
+        return 1;
+    }
+
+    static File_List list;
+    find_files(&list, "assets");
+    find_files(&list, "levels");
+
+    u32 errors = 0;
+    u32 checked = 0;
+    f64 read_seconds = 0.0;
+    u64 compressed_pixel_bytes = 0;
+    for (u32 i = 0; i < list.count; i++) {
+        Pack_Entry expected = {};
+        u8 *data = 0;
+        f64 read_start = get_seconds();
+        if (!parse_file(list.names[i], &expected, &data)) continue;
+        f64 read_time = get_seconds() - read_start;
+
+        Pack_Entry *entry = find_pack_entry(header, list.names[i], expected.type);
+        u8 *pixels = 0;
+        if (entry && (entry->flags & PACK_COMPRESSED)) {
+            // Zo lang duurt het om dezelfde sprite als losse bitmap te lezen.
+            read_seconds += read_time;
+            compressed_pixel_bytes += expected.size;
+
+            pixels = (u8 *)malloc(expected.size);
+            if (!decode_sprite_pixels((u8 *)get_pack_data(header, entry), entry->size,
+                                      (u32 *)pixels, entry->width, entry->height)) {
+                fprintf(stderr, "Kan niet uitpakken: %s\n", list.names[i]);
+                free(pixels);
+                pixels = 0;
+                errors++;
+            }
+        }
+
+        if (!entry) {
+            fprintf(stderr, "Niet in het pack: %s\n", list.names[i]);
+            errors++;
+        } else if (entry->flags & PACK_COMPRESSED) {
+            if ((entry->offset % PACK_ALIGN) || (entry->width != expected.width) ||
+                (entry->height != expected.height) ||
+                (entry->flags != (expected.flags | PACK_COMPRESSED)) ||
+                (pixels && memcmp(pixels, data, expected.size))) {
+                fprintf(stderr, "Anders in het pack: %s\n", list.names[i]);
+                errors++;
+            }
+        } else if ((entry->offset % PACK_ALIGN) || (entry->size != expected.size) ||
+                   (entry->width != expected.width) || (entry->height != expected.height) ||
+                   (entry->flags != expected.flags) ||
+                   (entry->samples_per_sec != expected.samples_per_sec) ||
+                   (entry->channels != expected.channels) ||
+                   memcmp(get_pack_data(header, entry), data, entry->size)) {
+            fprintf(stderr, "Anders in het pack: %s\n", list.names[i]);
+            errors++;
+        }
+        checked++;
+        free(pixels);
+        free(data);
+    }
+
+    // Hoe snel is uitpakken, vergeleken met de losse bitmaps lezen.
+    if (compressed_pixel_bytes) {
+        Pack_Entry *entries = get_pack_entries(header);
+        u32 *pixels = 0;
+        u64 pixels_size = 0;
+        u32 runs = 20;
+        f64 decode_start = get_seconds();
+        for (u32 run = 0; run < runs; run++) {
+            for (u32 i = 0; i < header->entry_count; i++) {
+                Pack_Entry *entry = entries + i;
+                if (!(entry->flags & PACK_COMPRESSED)) continue;
+
+                u64 size = (u64)entry->width * entry->height * 4;
+                if (size > pixels_size) {
+                    free(pixels);
+                    pixels = (u32 *)malloc(size);
+                    pixels_size = size;
+                }
+                decode_sprite_pixels((u8 *)get_pack_data(header, entry), entry->size, pixels,
+                                     entry->width, entry->height);
+            }
+        }
+        f64 decode_seconds = (get_seconds() - decode_start) / runs;
+        free(pixels);
+
+        f64 megabytes = (f64)compressed_pixel_bytes / (1024.0 * 1024.0);
+        printf("Ingepakte sprites: %.1f MB pixels, uitpakken %.2fms (%.0f MB/s), losse bitmaps "
+               "lezen %.2fms (%.0f MB/s).\n",
+               megabytes, decode_seconds * 1000.0, megabytes / decode_seconds,
+               read_seconds * 1000.0, megabytes / read_seconds);
+    }
+
+    // Ook met andere hoofdletters en slashes moeten we de entries vinden.
+    if (header->entry_count > 0) {
+        Pack_Entry *first = get_pack_entries(header);
+        char name[PACK_NAME_SIZE];
+        strcpy(name, first->name);
+        for (char *c = name; *c; c++) {
+            if (*c == '\\') *c = '/';
+            if ((*c >= 'a') && (*c <= 'z')) *c = *c - 'a' + 'A';
+        }
+        if (find_pack_entry(header, name, first->type) != first) {
+            fprintf(stderr, "Kan %s niet vinden als %s\n", first->name, name);
+            errors++;
+        }
+    }
+    if (find_pack_entry(header, "assets\\bestaat niet.bmp", PACK_SPRITE)) {
+        fprintf(stderr, "Een bestand dat niet bestaat is gevonden.\n");
+        errors++;
+    }
+
+    free(memory);
+    printf("%u bestanden gecontroleerd, %u fouten.\n", checked, errors);
+    return errors ? 1 : 0;
+}
+
+// Lees het level terug met dezelfde code als het spel en vergelijk alle tiles.
+static bool check_level(u8 *memory, u64 size, u8 *tiles, u32 width, u32 height) {
+    Level_Header *header = get_level_header(memory, size);
+    if (!header) return false;
+
+    static u8 chunk_tiles[LEVEL_CHUNK_TILES * LEVEL_CHUNK_TILES];
+    for (u32 chunk_y = 0; chunk_y < header->chunks_y; chunk_y++) {
+        for (u32 chunk_x = 0; chunk_x < header->chunks_x; chunk_x++) {
+            Level_Chunk_Entry *entry = get_level_chunk_entry(header, chunk_x, chunk_y);
+            if (entry->size == 0) {
+                memset(chunk_tiles, 0, sizeof(chunk_tiles));
+            } else if (!decode_level_chunk(header, entry, chunk_tiles)) {
+                return false;
+            }
+
+            for (u32 y = 0; y < LEVEL_CHUNK_TILES; y++) {
+                for (u32 x = 0; x < LEVEL_CHUNK_TILES; x++) {
+                    u32 tile_x = chunk_x * LEVEL_CHUNK_TILES + x;
+                    u32 tile_y = chunk_y * LEVEL_CHUNK_TILES + y;
+                    u8 expected = 0;
+                    if ((tile_x < width) && (tile_y < height)) {
+                        expected = tiles[(u64)tile_y * width + tile_x];
+                    }
+                    if (chunk_tiles[y * LEVEL_CHUNK_TILES + x] != expected) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Schrijf width * height tiles als level bestand.
+static bool write_level(const char *name, u8 *tiles, u32 width, u32 height, u64 *size) {
+    u8 *output = (u8 *)malloc(get_level_size_bound(width, height));
+    *size = encode_level(tiles, width, height, output);
+    if (!check_level(output, *size, tiles, width, height)) {
+        fprintf(stderr, "Het level klopt niet na het omzetten: %s\n", name);
+        free(output);
+        return false;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s", name);
+#ifndef _WIN32
+    for (char *c = path; *c; c++) {
+        if (*c == '\\') *c = '/';
+    }
+#endif
+
+    FILE *file = fopen(path, "wb");
+    bool result = file && (fwrite(output, 1, *size, file) == *size);
+    if (file) fclose(file);
+    free(output);
+    return result;
+}
+
+static int convert_levels() {
+    static File_List list;
+    find_files(&list, "levels");
+
+    u32 errors = 0;
+    for (u32 i = 0; i < list.count; i++) {
+        if (!has_extension(list.names[i], ".bmp")) continue;
+
+        Pack_Entry entry = {};
+        u8 *data = 0;
+        if (!parse_file(list.names[i], &entry, &data)) {
+            fprintf(stderr, "Overgeslagen (geen 32 bits bitmap): %s\n", list.names[i]);
+            errors++;
+            continue;
+        }
+
+        u32 *pixels = (u32 *)data;
+        u8 *tiles = (u8 *)malloc((u64)entry.width * entry.height);
+        for (u64 j = 0; j < (u64)entry.width * entry.height; j++) {
+            tiles[j] = get_design_tile(pixels[j]);
+        }
+
+        char name[PACK_NAME_SIZE];
+        strcpy(name, list.names[i]);
+        strcpy(name + strlen(name) - 4, ".lvl");
+        u64 size;
+        if (write_level(name, tiles, entry.width, entry.height, &size)) {
+            printf("%s: %ux%u tiles, %llu bytes\n", name, entry.width, entry.height, size);
+        } else {
+            fprintf(stderr, "Kan %s niet schrijven.\n", name);
+            errors++;
+        }
+        free(tiles);
+        free(data);
+    }
+    return errors ? 1 : 0;
+}
+
+static u32 random_state = 1;
+
+static u32 random_range(u32 min, u32 max) {
+    random_state = random_state * 1664525u + 1013904223u;
+    return min + (random_state >> 8) % (max - min + 1);
+}
+
+// Een lang level met een vloer, spikes en overal zwevende platforms, zodat ook de chunks hoog in
+// het level tiles hebben. Met dezelfde afmetingen krijg je altijd hetzelfde level.
+static int write_synthetic_level(u32 width, u32 height, const char *name) {
+    if ((width < 32) || (height < 16)) {
+        fprintf(stderr, "Een level moet minstens 32x16 tiles zijn.\n");
+        return 1;
+    }
+
+    u8 *tiles = (u8 *)calloc((u64)width * height, 1);
+    for (u32 x = 0; x < width; x++) {
+        tiles[x] = GROUND_TILE;
+    }
+
+    for (u32 x = 10; x + 16 < width; x += random_range(6, 14)) {
+        // Spikes op de vloer, een tile breed zodat je eroverheen kunt springen.
+        if (random_range(0, 3) == 0) tiles[width + x] = SPIKES_TILE;
+
+        // De helft van de platforms laag genoeg om op te springen, de rest ergens in de lucht.
+        u32 y = random_range(0, 1) ? random_range(3, 8) : random_range(3, height - 2);
+        u32 length = random_range(3, 8);
+        for (u32 i = 0; (i < length) && (x + i + 16 < width); i++) {
+            tiles[(u64)y * width + x + i] = GROUND_TILE;
+        }
+    }
+
+    tiles[width + 2] = START_TILE;
+    tiles[width + width - 12] = COIN_TILE;
+    tiles[width + width - 4] = END_TILE;
+
+    u64 size;
+    bool written = write_level(name, tiles, width, height, &size);
+    free(tiles);
+    if (!written) {
+        fprintf(stderr, "Kan %s niet schrijven.\n", name);
+        return 1;
+    }
+    printf("%s: %ux%u tiles, %llu bytes\n", name, width, height, size);
+    return 0;
+}
+
+int main(int argument_count, char **arguments) {
+    bool verify = false;
+    const char *filename = "assets.pak";
+    for (int i = 1; i < argument_count; i++) {
+        if (!strcmp(arguments[i], "-verify")) {
+            verify = true;
+        } else if (!strcmp(arguments[i], "-levels")) {
+            return convert_levels();
+        } else if (!strcmp(arguments[i], "-synthetic") && (i + 2 < argument_count)) {
+            u32 width, height;
+            if (sscanf(arguments[i + 1], "%ux%u", &width, &height) != 2) {
+                fprintf(stderr, "Gebruik: packer -synthetic 10000x1000 levels\\groot.lvl\n");
+                return 1;
+            }
+            return write_synthetic_level(width, height, arguments[i + 2]);
+        } else {
+            filename = arguments[i];
+        }
+    }
+
+    return verify ? verify_pack(filename) : write_pack(filename);
+}
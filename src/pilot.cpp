@@ -2,6 +2,7 @@
 #include <Xinput.h>
 #include <xaudio2.h>
 #include <strsafe.h>
+#include <intrin.h>
 
 #define i8 char
 #define i16 short
@@ -25,15 +26,8 @@ enum {
 
 #define shift(x) 1 << (x)
 
-enum {
-    EMPTY_TILE = shift(0),
-    GROUND_TILE = shift(1),
-    START_TILE = shift(2),
-    END_TILE = shift(3),
-    COIN_TILE = shift(4),
-    DEATH_TILE = shift(5),
-    SPIKES_TILE = shift(6),
-};
+#define minimum(A, B) ((A < B) ? (A) : (B))
+#define maximum(A, B) ((A > B) ? (A) : (B))
 
 enum State {
     MAIN_MENU,
@@ -45,31 +39,38 @@ enum State {
 
 // Include alle cpp bestanden hier.
 #include "math.cpp"
-#include "audio.cpp"
+#include "cpu.cpp"
+#include "memory.cpp"
+#include "jobs.cpp"
+#include "pack.cpp"
+#include "level.cpp"
+#include "walls.cpp"
+#include "sim.cpp"
+#include "recording.cpp"
 #include "input.cpp"
+#include "blit.cpp"
 #include "draw.cpp"
+#include "present.cpp"
+#include "asset_cache.cpp"
+#include "loader.cpp"
+#include "audio.cpp"
 
 struct Engine {
     Input input;
     Audio audio;
     Window window;
+    Asset_Loader loader;
 
     bool running;
     f32 delta_time;
     f32 target_time;
+    // Dezelfde frame tijd in tellen van QueryPerformanceCounter, voor advance_tick_time.
+    i64 delta_counter;
+    i64 counter_frequency;
 };
 
 #include "ui.cpp"
-
-#define minimum(A, B) ((A < B) ? (A) : (B))
-#define maximum(A, B) ((A > B) ? (A) : (B))
-
-struct Tile_Map {
-    i32 width, height, tile_size;
-    i32 *tiles;
-    Sprite ground, end, coin, spikes;
-    Vector2f start_pos;
-};
+#include "tile_map.cpp"
 
 struct Player {
     Animation walk_right;
@@ -79,41 +80,34 @@ struct Player {
     Animation current_anim;
 
     float frame;
-
-    f32 width, height;
-
-    Vector2f position;
-    Vector2f velocity;
-    Vector2f acceleration;
-    float max_speed;
-};
-
-struct Collision {
-    i32 coin_index;
-    i32 tile;
-    bool on_ground;
 };
 
 #define NUM_LEVELS 10
 struct Game {
-    f32 gravity;
+    // De natuurkunde van het level dat we spelen, zie sim.cpp.
+    Level_Sim sim;
     Vector2f camera;
 
     Player *player;
 
+    Tile_Sprites tile_sprites;
     Tile_Map tile_maps[NUM_LEVELS];
+    Tile_Chunk_Cache chunk_cache;
     u32 level;
     u32 coin_count;
 
-    Sprite background;
-    Sprite main_menu;
-    Sprite level_complete;
-    Sprite level_failed;
-    Sprite end_game;
+    // De grote plaatjes laadt de loader op de achtergrond, zie loader.cpp.
+    Load_Handle background;
+    Load_Handle main_menu;
+    Load_Handle level_complete;
+    Load_Handle level_failed;
+    Load_Handle end_game;
 
     Sprite tips_pc[3];
     Sprite tips_console[3];
 
+    Sprite_Atlas atlas;
+
     Button quit_button;
     Button restart_button;
     Button next_button;
@@ -127,230 +121,27 @@ struct Game {
     Sound select_sound;
     Sound failed_sound;
 
-    bool coin_collected;
-    int coin_index;
-    bool dead;
-    float death_timer;
+    // Met -record nemen we elke poging op, met -play spelen we een opname af (zie recording.cpp).
+    bool recording;
+    Recorder recorder;
+    u8 *recording_buffer;
+    u32 recording_count;
+    bool playing;
+    Playback playback;
+    u8 *playback_memory;
+    u64 playback_size;
+
+    // Zie de uitleg van de vaste tick bij in_level, en advance_tick_time voor de eenheid.
+    i64 tick_time;
+    Vector2f previous_position;
+    Vector2f previous_camera;
 
     State state;
-    Collision collision;
+    // Staat aan als het scherm van een menu opnieuw getekend moet worden, bijvoorbeeld omdat we net
+    // van state zijn gewisseld.
+    bool redraw_screen;
 };
 
-static Tile_Map load_tile_map(const char *filename) {
-    Tile_Map result = {};
-
-    Sprite level_design = load_bitmap(filename);
-    result.height = level_design.height;
-    result.width = level_design.width;
-    result.tile_size = 96;
-    result.ground = load_bitmap("assets\\grass.bmp");
-    result.end = load_bitmap("assets\\door.bmp");
-    result.coin = load_bitmap("assets\\coin.bmp");
-    result.spikes = load_bitmap("assets\\spikes.bmp");
-    result.tiles = (i32 *)VirtualAlloc(0, sizeof(i32) * result.width * result.height,
-                                       MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-
-    i32 *tile = result.tiles;
-    for (i32 y = 0; y < result.height; y++) {
-        for (i32 x = 0; x < result.width; x++) {
-            i32 value = 0;
-
-            u32 color = level_design.pixels[level_design.width * y + x];
-            u8 a = (u8)(color >> 24);
-            u8 r = (u8)(color >> 16);
-            u8 g = (u8)(color >> 8);
-            u8 b = (u8)color;
-            if (a == 255) {
-                if ((r == 0) && (g == 255) && (b == 0)) {
-                    value = GROUND_TILE;
-                }
-
-                if ((r == 0) && (g == 0) && (b == 255)) {
-                    value = START_TILE;
-                    result.start_pos =
-                        Vector2f(f32(x * result.tile_size), f32(y * result.tile_size + 40));
-                }
-
-                if ((r == 255) && (g == 0) && (b == 255)) {
-                    value = END_TILE;
-                }
-
-                if ((r == 255) && (g == 255) && (b == 0)) {
-                    value = COIN_TILE;
-                }
-
-                if ((r == 255) && (g == 0) && (b == 0)) {
-                    value = DEATH_TILE;
-                }
-
-                if ((r == 127) && (g == 127) && (b == 127)) {
-                    value = SPIKES_TILE;
-                }
-            }
-
-            *tile++ = value;
-        }
-    }
-
-    return result;
-}
-
-static bool test_wall(f32 *t_lowest, f32 wall_coord, f32 wall_min, f32 wall_max, f32 rel_x,
-                      f32 rel_y, f32 delta_x, f32 delta_y) {
-    f32 t_epsilon = 0.01f;
-
-    if (delta_x != 0.0f) {
-        // Reken uit wanneer de speler de muur raakt coordinaat.
-        f32 t_result = (wall_coord - rel_x) / delta_x;
-
-        // We willen alleen de dichstbijzijnde botsing, dus slaan we telkens de laagste tijd op.
-        if ((t_result < *t_lowest) && (t_result >= 0)) {
-            // Check of de y coordinaat ook op de muur ligt.
-            f32 y = rel_y + t_result * delta_y;
-            if ((y >= wall_min) && (y <= wall_max)) {
-                *t_lowest = maximum(0.0f, t_result - t_epsilon);
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-static Collision update_player_position(Tile_Map *tile_map, Player *player, f32 delta_time) {
-    Collision result = {};
-
-    Vector2f old_pos = player->position;
-
-    // Maak gebruik van de formules uit Binas Tabel 35.
-    // s = 0.5*a*t^2 + v*t + s
-    Vector2f new_pos = player->acceleration * delta_time * delta_time * .5f +
-                       player->velocity * delta_time + player->position;
-    // v = a*t + v
-    player->velocity = player->acceleration * delta_time + player->velocity;
-
-    Vector2f delta_pos = new_pos - old_pos;
-
-    Vector2f old_tile = Vector2f(old_pos.x, old_pos.y) / (f32)tile_map->tile_size;
-    Vector2f new_tile = Vector2f(new_pos.x, new_pos.y) / (f32)tile_map->tile_size;
-
-    Vector2i min_tile =
-        Vector2i((i32)minimum(old_tile.x, new_tile.x), (i32)minimum(old_tile.y, new_tile.y));
-    Vector2i max_tile =
-        Vector2i((i32)maximum(old_tile.x, new_tile.x), (i32)maximum(old_tile.y, new_tile.y));
-
-    Vector2i player_tile_size = Vector2i((i32)(player->width / (f32)tile_map->tile_size) + 1,
-                                         (i32)(player->height / (f32)tile_map->tile_size) + 1);
-
-    min_tile = min_tile - player_tile_size;
-    max_tile = max_tile + player_tile_size;
-
-    // Dit is zijn de hoeken linksonder en rechtsboven ten opzichte van het midden van de tile.
-    Vector2f diameter = Vector2f((f32)tile_map->tile_size + player->width,
-                                 (f32)tile_map->tile_size + player->height);
-    Vector2f min_corner = diameter * -0.5f;
-    Vector2f max_corner = diameter * 0.5f;
-
-    f32 t_remaining = 1.0f;
-
-    // TODO(Kay Verbruggen): Hoe vaak moeten we deze loop uitvoeren.
-    for (i32 i = 0; (i < 4) && (t_remaining > 0.0f); i++) {
-        f32 t_lowest = 1.0f;
-        Vector2f normal = Vector2f();
-
-        // Loop door alle mogelijke tiles heen. Dit zijn er eigenlijk te veel, dit dus kan nog
-        // sneller.
-        for (i32 tile_y = min_tile.y; tile_y <= max_tile.y; tile_y++) {
-            for (i32 tile_x = min_tile.x; tile_x <= max_tile.x; tile_x++) {
-                if ((tile_x >= 0) && (tile_y >= 0) && (tile_x < tile_map->width) &&
-                    tile_y < tile_map->height) {
-                    i32 tile_index = tile_y * tile_map->width + tile_x;
-                    i32 tile = tile_map->tiles[tile_index];
-
-                    // Reken het midden van de tile uit, en de positie van de speler ten
-                    // opzichte van dat midden.
-                    Vector2f tile_center =
-                        Vector2f((f32)tile_x, (f32)tile_y) * (f32)tile_map->tile_size;
-                    Vector2f rel_pos = player->position - tile_center;
-
-                    if ((tile == COIN_TILE) || (tile == DEATH_TILE) || (tile == SPIKES_TILE) ||
-                        (tile == END_TILE)) {
-                        Vector2f temp_max_corner = max_corner;
-                        Vector2f temp_min_corner = min_corner;
-                        if (tile == SPIKES_TILE) {
-                            temp_max_corner.y -= 40;
-
-                            temp_max_corner.x -= 15;
-                            temp_min_corner.x += 15;
-                        }
-
-                        if (test_wall(&t_lowest, temp_min_corner.x, temp_min_corner.y,
-                                      temp_max_corner.y, rel_pos.x, rel_pos.y, delta_pos.x,
-                                      delta_pos.y) ||
-                            test_wall(&t_lowest, temp_max_corner.x, temp_min_corner.y,
-                                      temp_max_corner.y, rel_pos.x, rel_pos.y, delta_pos.x,
-                                      delta_pos.y) ||
-                            test_wall(&t_lowest, temp_min_corner.y, temp_min_corner.x,
-                                      temp_max_corner.x, rel_pos.y, rel_pos.x, delta_pos.y,
-                                      delta_pos.x) ||
-                            test_wall(&t_lowest, temp_max_corner.y, temp_min_corner.x,
-                                      temp_max_corner.x, rel_pos.y, rel_pos.x, delta_pos.y,
-                                      delta_pos.x)) {
-                            result.tile |= tile;
-
-                            if (tile == COIN_TILE) {
-                                tile_map->tiles[tile_index] = EMPTY_TILE;
-                                result.coin_index = tile_index;
-                            }
-                        }
-                    } else if ((tile == GROUND_TILE)) {
-                        // Verticale muren.
-                        if (test_wall(&t_lowest, min_corner.x, min_corner.y, max_corner.y,
-                                      rel_pos.x, rel_pos.y, delta_pos.x, delta_pos.y)) {
-                            normal = Vector2f(-1.0f, 0.0f);
-                            result.tile |= tile;
-                        }
-
-                        if (test_wall(&t_lowest, max_corner.x, min_corner.y, max_corner.y,
-                                      rel_pos.x, rel_pos.y, delta_pos.x, delta_pos.y)) {
-                            normal = Vector2f(1.0f, 0.0f);
-                            result.tile |= tile;
-                        }
-
-                        // Horizontale muren.
-                        if (test_wall(&t_lowest, min_corner.y, min_corner.x, max_corner.x,
-                                      rel_pos.y, rel_pos.x, delta_pos.y, delta_pos.x)) {
-                            normal = Vector2f(0.0f, -1.0f);
-                            result.tile |= tile;
-                        }
-
-                        if (test_wall(&t_lowest, max_corner.y, min_corner.x, max_corner.x,
-                                      rel_pos.y, rel_pos.x, delta_pos.y, delta_pos.x)) {
-                            normal = Vector2f(0.0f, 1.0f);
-                            result.on_ground = true;
-                            result.tile |= tile;
-                        }
-                    }
-                }
-            }
-        }
-
-        if (normal == Vector2f()) {
-            player->position = player->position + delta_pos;
-            // t_remaining = 0;
-        } else {
-            player->position = player->position + delta_pos * t_lowest;
-            player->velocity = player->velocity - normal * dot(player->velocity, normal);
-            player->acceleration =
-                player->acceleration - normal * dot(player->acceleration, normal);
-            delta_pos = delta_pos - normal * dot(delta_pos, normal);
-        }
-        t_remaining -= t_lowest * t_remaining;
-    }
-
-    return result;
-}
-
 // Dit is de functie die berichten van Windows afhandeld. Op dit moment doen we alleen iets met QUIT
 // en DESTROY berichten. Als we een van deze twee aantreffen stoppen we het programma.
 LRESULT CALLBACK window_callback(HWND window, UINT msg, WPARAM wparam, LPARAM lparam) {
@@ -389,6 +180,14 @@ LRESULT CALLBACK window_callback(HWND window, UINT msg, WPARAM wparam, LPARAM lp
             break;
         }
 
+        case WM_PAINT: {
+            // Windows wil (een deel van) het venster opnieuw hebben, dus de volgende keer sturen we
+            // de hele buffer.
+            engine->window.buffer.all_dirty = true;
+            result = DefWindowProcA(window, msg, wparam, lparam);
+            break;
+        }
+
         case WM_KEYDOWN: {
             if ((lparam >> 30) == 0 && (!engine->input.use_gamepad)) {
                 process_key_down(&engine->input, (u32)wparam);
@@ -419,141 +218,238 @@ LRESULT CALLBACK window_callback(HWND window, UINT msg, WPARAM wparam, LPARAM lp
     return result;
 }
 
-void in_level(Engine *engine, Game *game) {
-    if (game->dead)
-        game->death_timer += engine->delta_time;
-    else
-        game->death_timer = 0;
-
-    Player *player = game->player;
+// NOTE: Uitleg vaste tick.
+// Vroeger deden we de natuurkunde een keer per frame met de gemeten delta_time. Dan springt de
+// speler bij 30 fps anders dan bij 144 fps, en een trage frame geeft een andere sprong. Nu doet
+// simulate_level steeds een tick van precies SIM_DELTA_TIME, en doet in_level zoveel ticks als er
+// sinds de vorige frame in tick_time zijn bijgekomen. Met dezelfde input per tick komt er dus
+// altijd precies hetzelfde uit, hoe snel we ook tekenen.
+//
+// Het tekenen loopt meestal tussen twee ticks in. Daarom onthouden we de positie van de speler en
+// de camera van voor de laatste tick, en tekenen we ze op het stuk tussen die twee waar we in de
+// tijd zijn.
+//
+// De tick zelf staat in sim.cpp (simulate_tick en advance_tick_time), zodat de replay runner en de
+// fps test in tests.cpp hem ook kunnen doen. Hier doen we alleen wat bij het spel hoort: de input,
+// de camera, het geluid en de schermen.
+
+// Zoveel mag een opname van een poging worden, met een controller is dat ruim een uur.
+#define RECORDING_BUFFER_SIZE (1024 * 1024)
+
+// Met -record opnames\poging schrijven we elke poging naar opnames\poging1.rec en verder, met
+// -play opnames\poging1.rec spelen we die poging af in plaats van de input van de speler.
+static char record_prefix[MAX_PATH];
+static char playback_filename[MAX_PATH];
+
+// Lees de opname van -play in de permanent arena, en ga naar zijn level.
+static void load_playback(Game *game) {
+    FILE *file = fopen(playback_filename, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        game->playback_size = (u64)ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        game->playback_memory = push_array(&permanent_arena, u8, game->playback_size);
+        if (!game->playback_memory ||
+            (fread(game->playback_memory, 1, game->playback_size, file) != game->playback_size)) {
+            game->playback_memory = 0;
+        }
+        fclose(file);
+    }
 
-    // Zwaartekracht
-    player->acceleration.y = -game->gravity;
+    if (!game->playback_memory ||
+        !begin_playback(&game->playback, game->playback_memory, game->playback_size) ||
+        (game->playback.header->level >= NUM_LEVELS)) {
+        report_load_error("Opname", "De opname kon niet geladen worden!", playback_filename);
+        game->playback_memory = 0;
+        return;
+    }
+    if (!is_recording_of_level(&game->playback,
+                               &game->tile_maps[game->playback.header->level])) {
+        report_load_error("Opname", "De opname is op een ander level bestand gemaakt!",
+                          playback_filename);
+        game->playback_memory = 0;
+        return;
+    }
+    game->level = game->playback.header->level;
+}
 
-    // De horizontale beweging door de speler.
-    player->acceleration.x = engine->input.movement * 3000;
-    if (game->dead) player->acceleration.x = 0;
+// Begin aan het opnemen of afspelen van de poging die nu begint.
+static void begin_level_recording(Game *game) {
+    if (game->recording_buffer) {
+        begin_recording(&game->recorder, game->recording_buffer, RECORDING_BUFFER_SIZE);
+        game->recording = true;
+    }
 
-    // Spring systeem: https://www.youtube.com/watch?v=7KiK0Aqtmzc
-    if (engine->input.jump) {
-        engine->input.jump = false;
+    game->playing = false;
+    if (game->playback_memory &&
+        begin_playback(&game->playback, game->playback_memory, game->playback_size)) {
+        game->playing = (game->playback.header->level == game->level) &&
+                        is_recording_of_level(&game->playback, &game->tile_maps[game->level]);
+    }
+}
 
-        if (game->collision.on_ground) {
-            player->acceleration.y = 1200.0f / engine->delta_time;
-            play_sound(&game->jump_sound);  // Speel het geluidje af!
+// De poging is voorbij: schrijf de opname weg, of laat zien of het afspelen klopte.
+static void end_level_recording(Engine *engine, Game *game) {
+    char text[512];
+    if (game->recording) {
+        game->recording = false;
+        u64 size = finish_recording(&game->recorder, &game->sim, game->level);
+
+        char filename[MAX_PATH];
+        StringCbPrintfA(filename, MAX_PATH, "%s%u.rec", record_prefix, ++game->recording_count);
+        FILE *file = size ? fopen(filename, "wb") : 0;
+        if (file && (fwrite(game->recording_buffer, 1, size, file) == size)) {
+            StringCbPrintfA(text, 512, "Opname %s: %u ticks, %llu bytes\n", filename,
+                            game->sim.tick, size);
+        } else {
+            StringCbPrintfA(text, 512, "Opname %s kon niet geschreven worden.\n", filename);
         }
+        if (file) fclose(file);
+        OutputDebugStringA(text);
     }
 
-    if (player->velocity.y > 0.0f) {
-        player->acceleration.y -= game->gravity * 2.0f;
-    } else if (player->velocity.y < 0.0f && !engine->input.space) {
-        player->acceleration.y -= game->gravity;
+    if (game->playing) {
+        game->playing = false;
+        if (finish_playback(&game->playback, &game->sim)) {
+            StringCbPrintfA(text, 512, "Afspelen %s: %u ticks, %u checkpoints kloppen\n",
+                            playback_filename, game->sim.tick, game->playback.checkpoints);
+        } else {
+            StringCbPrintfA(text, 512, "Afspelen %s: KLOPT NIET vanaf tick %u\n",
+                            playback_filename, game->playback.first_mismatch);
+        }
+        OutputDebugStringA(text);
+
+        // Vanaf nu speelt de speler zelf weer.
+        engine->input.movement = 0.0f;
+        engine->input.jump = false;
+        engine->input.space = false;
     }
+}
 
-    // Wrijving
-    player->acceleration.x -= player->velocity.x * 5.0f;
+// Zet de speler op het begin van het level, zonder dat we hem de eerste frame tussen de oude en
+// de nieuwe plek tekenen.
+static void reset_player(Game *game) {
+    reset_level_sim(&game->sim, &game->tile_maps[game->level]);
+    game->previous_position = game->sim.player.position;
+    game->previous_camera = game->camera;
+    game->tick_time = 0;
+    begin_level_recording(game);
+}
 
-    // Zorg dat we niet boven de maximale snelheid gaan.
-    if (player->velocity.x > player->max_speed) {
-        player->velocity.x = player->max_speed;
-    } else if (player->velocity.x < -player->max_speed) {
-        player->velocity.x = -player->max_speed;
+// Een tick van het level. Geeft false terug als we het level uit zijn.
+static bool simulate_level(Engine *engine, Game *game) {
+    Player_Body *player = &game->sim.player;
+    game->previous_position = player->position;
+    game->previous_camera = game->camera;
+
+    // Bij het afspelen komt de input van deze tick uit de opname, niet van de speler.
+    if (game->playing) {
+        Sim_Input recorded;
+        if (play_tick(&game->playback, &game->sim, &recorded)) {
+            engine->input.movement = recorded.movement;
+            engine->input.jump = recorded.jump;
+            engine->input.space = recorded.space;
+        } else {
+            end_level_recording(engine, game);
+        }
     }
 
-    Tile_Map cur_map = game->tile_maps[game->level];
-    game->collision = update_player_position(&cur_map, player, engine->delta_time);
+    Sim_Input input;
+    input.movement = engine->input.movement;
+    input.jump = engine->input.jump;
+    input.space = engine->input.space;
+    engine->input.jump = false;
+    if (game->recording) record_tick(&game->recorder, &game->sim, &input);
+
+    u32 events = simulate_tick(&game->sim, &input);
+    if (events & (SIM_COMPLETED | SIM_FAILED)) end_level_recording(engine, game);
+    if (events & SIM_JUMPED) play_sound(&game->jump_sound);  // Speel het geluidje af!
 
     // game->camera.x = player->position.x - 0.5f*engine->window.buffer.width;
 
-    float follow_speed = (7.0f * engine->delta_time);
-    Vector2f target = player->position - Vector2f(engine->window.buffer.width / 2.0f,
-                                                  engine->window.buffer.height / 2.0f);
+    // De camera werkt in design pixels, hoe groot de buffer ook is (zie set_render_resolution).
+    float follow_speed = (7.0f * SIM_DELTA_TIME);
+    Vector2f target =
+        player->position - Vector2f(DESIGN_WIDTH / 2.0f, DESIGN_HEIGHT / 2.0f);
     Vector2f delta_camera = (target - game->camera) * follow_speed;
     game->camera = game->camera + delta_camera;
 
+    Tile_Map *cur_map = &game->tile_maps[game->level];
+
     // Ga naar het volgende level als we het level hebben gehaald.
-    // TODO(Kay Verbruggen): Als we het level halen en menu of knop er tussen hebben om verder
-    // te gaan, blijft de delta tijd voorlopig oplopen, misschien moeten we hier een oplossing
-    // voor bedenken. Het kan ook zijn dat het probleem sowieso al niet meer bestaat als we een
-    // in-engine menu hebben.
-    if ((game->collision.tile & END_TILE) && (game->coin_collected)) {
-        player->velocity = Vector2f();
-
-        engine->window.stretch_on_resize = true;
-        free_sprite(&game->background);
+    if (events & SIM_COMPLETED) {
         play_sound(&game->completed_sound);
+        game->redraw_screen = true;
 
         if (game->level < NUM_LEVELS - 1) {
             game->state = LEVEL_COMPLETE;
-            game->level_complete = load_bitmap("assets\\level complete.bmp");
         } else {
             game->state = END;
-            game->end_game = load_bitmap("assets\\end game.bmp");
+            // Na het einde gaan we terug naar het hoofdmenu.
+            prefetch_sprite(&engine->loader, &game->main_menu, "assets\\main menu.bmp");
         }
 
-        return;
+        return false;
     }
 
-    if ((game->collision.tile & DEATH_TILE) || (game->collision.tile & SPIKES_TILE)) {
-        if (game->coin_collected) {
-            cur_map.tiles[game->coin_index] = COIN_TILE;
+    if (events & SIM_FAILED) {
+        // simulate_tick heeft de munt al teruggelegd, hier tekenen we hem weer.
+        if (game->sim.coin_collected) {
+            invalidate_tile(&game->chunk_cache, cur_map, game->sim.coin_index);
         }
         play_sound(&game->failed_sound);
-        engine->window.stretch_on_resize = true;
         game->state = LEVEL_FAILED;
-        game->level_failed = load_bitmap("assets\\level failed.bmp");
-        free_sprite(&game->background);
-        return;
+        game->redraw_screen = true;
+        return false;
     }
 
-    if (game->collision.tile & COIN_TILE) {
-        game->coin_index = game->collision.coin_index;
+    if (events & SIM_COIN) {
+        invalidate_tile(&game->chunk_cache, cur_map, game->sim.coin_index);
         play_sound(&game->coin_sound);
-        game->coin_collected = true;
         char buffer[256];
         StringCbPrintfA(buffer, 256, "Coins: %d\n", game->coin_count);
         OutputDebugStringA(buffer);
     }
+    return true;
+}
 
-    draw_sprite(&engine->window, Vector2f(), &game->background,
-                Vector2f(1920.0f / 2.0f, 1080.0f / 2.0f));
+void in_level(Engine *engine, Game *game) {
+    Player *player = game->player;
+    Player_Body *body = &game->sim.player;
+    Tile_Map *cur_map = &game->tile_maps[game->level];
+    update_level_streaming(cur_map, game->camera);
+
+    u32 ticks =
+        advance_tick_time(&game->tick_time, engine->delta_counter, engine->counter_frequency);
+    for (u32 i = 0; i < ticks; i++) {
+        if (!simulate_level(engine, game)) return;
+    }
 
-    // De tilemap op het scherm zetten.
-    for (i32 y = cur_map.height - 1; y >= 0; y--) {
-        for (i32 x = 0; x < cur_map.width; x++) {
-            i32 tile = cur_map.tiles[y * cur_map.width + x];
-            f32 real_x = (f32)(x * cur_map.tile_size);
-            f32 real_y = (f32)(y * cur_map.tile_size);
-            if ((real_x > game->camera.x - 100) &&
-                (real_x < game->camera.x + engine->window.buffer.width + 100) &&
-                (real_y > game->camera.y - 100) &&
-                (real_y < game->camera.y + engine->window.buffer.height + 100)) {
-                if (tile == GROUND_TILE) {
-                    draw_sprite(&engine->window, game->camera, &cur_map.ground,
-                                Vector2f(real_x, real_y));
-                } else if (tile == END_TILE) {
-                    // TODO: Fix hardcoden van de deur offset op de y-as.
-                    draw_sprite(&engine->window, game->camera, &cur_map.end,
-                                Vector2f(real_x, real_y + 60));
-                } else if (tile == COIN_TILE) {
-                    draw_sprite(&engine->window, game->camera, &cur_map.coin,
-                                Vector2f(real_x, real_y));
-                } else if (tile == SPIKES_TILE) {
-                    draw_sprite(&engine->window, game->camera, &cur_map.spikes,
-                                Vector2f(real_x, real_y - 10));
-                }
-            }
-        }
+    // Hoe ver we van de vorige naar de laatste tick zijn.
+    f32 t = (f32)((f64)game->tick_time / (f64)engine->counter_frequency);
+    Vector2f camera = lerp(game->previous_camera, game->camera, t);
+    Vector2f position = lerp(game->previous_position, body->position, t);
+
+    Sprite *background = get_loaded_sprite(&engine->loader, game->background);
+    if (background) {
+        draw_sprite(&engine->window, Vector2f(), background,
+                    Vector2f(1920.0f / 2.0f, 1080.0f / 2.0f));
+    } else {
+        clear_screen(&engine->window, LOADING_COLOR);
     }
 
+    // De tilemap op het scherm zetten.
+    draw_tile_map(&engine->window, &game->chunk_cache, cur_map, camera);
+
     player->frame += engine->delta_time * player->current_anim.fps;
     if (player->frame >= 8.0f) player->frame = 0.0f;
 
     // Wissel van animatie als de speler van kant wisselt of stopt met lopen.
     // TODO(Kay Verbruggen): Hardcoded!
-    if (player->velocity.x > 7.0f) {
+    if (body->velocity.x > 7.0f) {
         player->current_anim = player->walk_right;
-    } else if (player->velocity.x < -7.0f) {
+    } else if (body->velocity.x < -7.0f) {
         player->current_anim = player->walk_left;
     } else {
         if (player->current_anim.id == WALK_RIGHT)
@@ -563,15 +459,73 @@ void in_level(Engine *engine, Game *game) {
     }
 
     if (engine->input.use_gamepad && game->level < 3) {
-        draw_sprite(&engine->window, game->camera, &game->tips_console[game->level],
+        draw_sprite(&engine->window, camera, &game->tips_console[game->level],
                     Vector2f(1400.0f, 800.0f));
     } else if (game->level < 3) {
-        draw_sprite(&engine->window, game->camera, &game->tips_pc[game->level],
+        draw_sprite(&engine->window, camera, &game->tips_pc[game->level],
                     Vector2f(1400.0f, 800.0f));
     }
 
-    draw_sprite(&engine->window, game->camera, &player->current_anim.sprites[(u8)player->frame],
-                player->position);
+    draw_sprite(&engine->window, camera, &player->current_anim.sprites[(u8)player->frame],
+                position);
+}
+
+// Laad alle levels (opnieuw).
+// TODO(Kay Verbruggen): Laad alle levels uit een mapje met FindFirstFile en FindNextFile.
+static const char *level_filenames[NUM_LEVELS] = {
+    "levels\\1.bmp", "levels\\2.bmp", "levels\\3.bmp", "levels\\4.bmp", "levels\\5.bmp",
+    "levels\\6.bmp", "levels\\7.bmp", "levels\\8.bmp", "levels\\9.bmp", "levels\\10.bmp",
+};
+
+// Met -level kun je een eigen level (een .lvl of een ontwerp) als eerste level spelen.
+static char custom_level[MAX_PATH];
+
+static const char *get_level_design(u32 level) {
+    if ((level == 0) && custom_level[0]) return custom_level;
+    return level_filenames[level];
+}
+
+static void close_levels(Game *game) {
+    for (u32 i = 0; i < NUM_LEVELS; i++) {
+        close_tile_map(&game->tile_maps[i]);
+    }
+}
+
+static void load_levels(Game *game) {
+    // Alle maps staan in de level arena, dus de oude maps zijn in een keer weg.
+    close_levels(game);
+    reset_arena(&level_arena);
+    for (u32 i = 0; i < NUM_LEVELS; i++) {
+        game->tile_maps[i] = load_tile_map(get_level_design(i), &game->tile_sprites);
+    }
+
+    // De nieuwe maps kunnen op hetzelfde adres staan als de oude, dus de chunks moeten opnieuw.
+    game->chunk_cache.level_chunks = 0;
+}
+
+// Vraag alles aan wat we vanuit een level nodig kunnen hebben. Dit blijft geladen tot het einde
+// van het spel, want na elk level komen we er weer langs.
+static void prefetch_level_sprites(Engine *engine, Game *game) {
+    prefetch_sprite(&engine->loader, &game->background, "assets\\background.bmp");
+    prefetch_sprite(&engine->loader, &game->level_failed, "assets\\level failed.bmp");
+    if (game->level < NUM_LEVELS - 1) {
+        prefetch_sprite(&engine->loader, &game->level_complete, "assets\\level complete.bmp");
+    } else {
+        prefetch_sprite(&engine->loader, &game->end_game, "assets\\end game.bmp");
+    }
+}
+
+// Teken het plaatje van een menu over het hele scherm. Is het nog niet geladen, dan maken we het
+// scherm leeg en proberen we het de volgende frame opnieuw.
+static void draw_menu_screen(Engine *engine, Game *game, Load_Handle handle) {
+    Sprite *sprite = get_loaded_sprite(&engine->loader, handle);
+    if (sprite) {
+        draw_sprite(&engine->window, game->camera, sprite,
+                    Vector2f(DESIGN_WIDTH / 2.0f, DESIGN_HEIGHT / 2.0f));
+    } else {
+        clear_screen(&engine->window, LOADING_COLOR);
+        game->redraw_screen = is_sprite_loading(&engine->loader, handle);
+    }
 }
 
 i32 read_progress() {
@@ -607,7 +561,6 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
     // Maak de initiële game state.
     Engine engine = {};
 
-    engine.window.stretch_on_resize = false;
     engine.window.resized = false;
     engine.running = true;
     engine.input.use_gamepad = false;
@@ -648,74 +601,158 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
 
     engine.window.handle = window;
     engine.window.device_context = hdc;
-    resize_buffer(&engine.window.buffer, Vector2i(1920, 1080));
+
+    initialize_arenas();
+
+    // Met -render 1280x720 tekenen we op een kleinere buffer, die de presenter opschaalt naar het
+    // venster. Dit moet voor het laden van de sprites, want die worden dan meteen verkleind.
+    Vector2i render_resolution = Vector2i(DESIGN_WIDTH, DESIGN_HEIGHT);
+    char *render_option = strstr(cmd_line, "-render ");
+    if (render_option) {
+        i32 render_width, render_height;
+        if ((sscanf(render_option, "-render %dx%d", &render_width, &render_height) == 2) &&
+            (render_width > 0) && (render_height > 0)) {
+            render_resolution = Vector2i(render_width, render_height);
+        }
+    }
+#if PROFILE
+    LARGE_INTEGER load_start;
+    QueryPerformanceCounter(&load_start);
+#endif
+
+    // Alle plaatjes en geluiden komen uit assets.pak als die er is (maak hem met packer.cpp).
+    // Met -nopack lezen we toch de losse bestanden.
+    if (!strstr(cmd_line, "-nopack")) {
+        open_asset_pack("assets.pak");
+    }
+    initialize_asset_cache();
+
+    set_render_resolution(&engine.window, render_resolution);
+    initialize_blitter();
+    initialize_wall_solver();
+    initialize_renderer(&engine.window);
+    // Met -nodisplay laten we de frames niet zien, maar houden we ze alleen in het geheugen.
+    // Met -bilinear schalen we zacht op in plaats van met blokjes.
+    initialize_presenter(&engine.window, !strstr(cmd_line, "-nodisplay"),
+                         strstr(cmd_line, "-bilinear") ? UPSCALE_BILINEAR : UPSCALE_NEAREST);
+    initialize_asset_loader(&engine.loader);
 
     // Audio.
     initialize_audio(&engine.audio);
 
+    // Met -loadthreads 4 laden we met 4 threads, zie run_jobs. Standaard een per core.
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    u32 load_threads = (u32)system_info.dwNumberOfProcessors;
+    char *load_threads_option = strstr(cmd_line, "-loadthreads ");
+    if (load_threads_option) {
+        sscanf(load_threads_option, "-loadthreads %u", &load_threads);
+    }
+
+    // Alles wat we bij het opstarten nodig hebben laden we als jobs, tegelijk op meerdere threads.
+    // Fouten verzamelen we en laten we daarna in een keer zien.
+    Job_Batch *startup_jobs = push_array(&frame_arena, Job_Batch, 1);
+    begin_load_errors();
+
     Player player = {};
+    Game game = {};
 
     // Right animation
-    player.walk_right.sprites[0] = load_bitmap("assets\\walk_right\\0.bmp");
-    player.walk_right.sprites[1] = load_bitmap("assets\\walk_right\\1.bmp");
-    player.walk_right.sprites[2] = load_bitmap("assets\\walk_right\\2.bmp");
-    player.walk_right.sprites[3] = load_bitmap("assets\\walk_right\\3.bmp");
-    player.walk_right.sprites[4] = load_bitmap("assets\\walk_right\\4.bmp");
-    player.walk_right.sprites[5] = load_bitmap("assets\\walk_right\\5.bmp");
-    player.walk_right.sprites[6] = load_bitmap("assets\\walk_right\\6.bmp");
-    player.walk_right.sprites[7] = load_bitmap("assets\\walk_right\\7.bmp");
-    player.walk_right.fps = 8;
-    player.walk_right.id = WALK_RIGHT;
+    add_sprite_job(startup_jobs, "assets\\walk_right\\0.bmp", &player.walk_right.sprites[0]);
+    add_sprite_job(startup_jobs, "assets\\walk_right\\1.bmp", &player.walk_right.sprites[1]);
+    add_sprite_job(startup_jobs, "assets\\walk_right\\2.bmp", &player.walk_right.sprites[2]);
+    add_sprite_job(startup_jobs, "assets\\walk_right\\3.bmp", &player.walk_right.sprites[3]);
+    add_sprite_job(startup_jobs, "assets\\walk_right\\4.bmp", &player.walk_right.sprites[4]);
+    add_sprite_job(startup_jobs, "assets\\walk_right\\5.bmp", &player.walk_right.sprites[5]);
+    add_sprite_job(startup_jobs, "assets\\walk_right\\6.bmp", &player.walk_right.sprites[6]);
+    add_sprite_job(startup_jobs, "assets\\walk_right\\7.bmp", &player.walk_right.sprites[7]);
 
     // Left animation
-    player.walk_left.sprites[0] = load_bitmap("assets\\walk_left\\0.bmp");
-    player.walk_left.sprites[1] = load_bitmap("assets\\walk_left\\1.bmp");
-    player.walk_left.sprites[2] = load_bitmap("assets\\walk_left\\2.bmp");
-    player.walk_left.sprites[3] = load_bitmap("assets\\walk_left\\3.bmp");
-    player.walk_left.sprites[4] = load_bitmap("assets\\walk_left\\4.bmp");
-    player.walk_left.sprites[5] = load_bitmap("assets\\walk_left\\5.bmp");
-    player.walk_left.sprites[6] = load_bitmap("assets\\walk_left\\6.bmp");
-    player.walk_left.sprites[7] = load_bitmap("assets\\walk_left\\7.bmp");
-    player.walk_left.fps = 8;
-    player.walk_left.id = WALK_LEFT;
+    // De linker animaties zijn spiegelbeelden van de rechter, die maken we na het maken van de
+    // atlas met mirror_sprite. Alleen het eerste plaatje van lopen is anders getekend.
+    add_sprite_job(startup_jobs, "assets\\walk_left\\0.bmp", &player.walk_left.sprites[0]);
 
     // Idle right animation.
-    player.idle_right.sprites[0] = load_bitmap("assets\\idle_right\\0.bmp");
-    player.idle_right.sprites[1] = load_bitmap("assets\\idle_right\\1.bmp");
-    player.idle_right.sprites[2] = load_bitmap("assets\\idle_right\\2.bmp");
-    player.idle_right.sprites[3] = load_bitmap("assets\\idle_right\\3.bmp");
-    player.idle_right.sprites[4] = load_bitmap("assets\\idle_right\\4.bmp");
-    player.idle_right.sprites[5] = load_bitmap("assets\\idle_right\\5.bmp");
-    player.idle_right.sprites[6] = load_bitmap("assets\\idle_right\\6.bmp");
-    player.idle_right.sprites[7] = load_bitmap("assets\\idle_right\\7.bmp");
+    add_sprite_job(startup_jobs, "assets\\idle_right\\0.bmp", &player.idle_right.sprites[0]);
+    add_sprite_job(startup_jobs, "assets\\idle_right\\1.bmp", &player.idle_right.sprites[1]);
+    add_sprite_job(startup_jobs, "assets\\idle_right\\2.bmp", &player.idle_right.sprites[2]);
+    add_sprite_job(startup_jobs, "assets\\idle_right\\3.bmp", &player.idle_right.sprites[3]);
+    add_sprite_job(startup_jobs, "assets\\idle_right\\4.bmp", &player.idle_right.sprites[4]);
+    add_sprite_job(startup_jobs, "assets\\idle_right\\5.bmp", &player.idle_right.sprites[5]);
+    add_sprite_job(startup_jobs, "assets\\idle_right\\6.bmp", &player.idle_right.sprites[6]);
+    add_sprite_job(startup_jobs, "assets\\idle_right\\7.bmp", &player.idle_right.sprites[7]);
+
+    // De knoppen.
+    add_sprite_job(startup_jobs, "assets\\quit button.bmp", &game.quit_button.sprite);
+    add_sprite_job(startup_jobs, "assets\\next button.bmp", &game.next_button.sprite);
+    add_sprite_job(startup_jobs, "assets\\play button.bmp", &game.play_button.sprite);
+    add_sprite_job(startup_jobs, "assets\\restart button.bmp", &game.restart_button.sprite);
+
+    // De tips.
+    add_sprite_job(startup_jobs, "assets\\console tip 1.bmp", &game.tips_console[0]);
+    add_sprite_job(startup_jobs, "assets\\console tip 2.bmp", &game.tips_console[1]);
+    add_sprite_job(startup_jobs, "assets\\console tip 3.bmp", &game.tips_console[2]);
+    add_sprite_job(startup_jobs, "assets\\pc tip 1.bmp", &game.tips_pc[0]);
+    add_sprite_job(startup_jobs, "assets\\pc tip 2.bmp", &game.tips_pc[1]);
+    add_sprite_job(startup_jobs, "assets\\pc tip 3.bmp", &game.tips_pc[2]);
+
+    // Met -level levels\groot.lvl spelen we eerst dat level.
+    char *level_option = strstr(cmd_line, "-level ");
+    if (level_option) {
+        sscanf(level_option, "-level %259s", custom_level);
+    }
+    char *record_option = strstr(cmd_line, "-record ");
+    if (record_option) {
+        sscanf(record_option, "-record %259s", record_prefix);
+    }
+    char *play_option = strstr(cmd_line, "-play ");
+    if (play_option) {
+        sscanf(play_option, "-play %259s", playback_filename);
+    }
+
+    // De tiles en de ontwerpen van de levels zonder level bestand. De tile maps zelf maken we na
+    // de join, want die komen in de level arena. Zolang we de handles vasthouden blijven de
+    // ontwerpen in de asset cache.
+    add_tile_sprite_jobs(startup_jobs, &game.tile_sprites);
+    Asset_Handle level_designs[NUM_LEVELS] = {};
+    for (u32 i = 0; i < NUM_LEVELS; i++) {
+        if (!has_level_file(get_level_design(i))) {
+            add_job(startup_jobs, acquire_sprite_job, get_level_design(i), &level_designs[i],
+                    JOB_NO_SCALE);
+        }
+    }
+
+    // De geluiden komen ook in de asset cache. De voices maakt load_sound daarna.
+    const char *wave_filenames[] = {
+        "assets\\hit.wav",  "assets\\completed.wav", "assets\\failed.wav", "assets\\jump 1.wav",
+        "assets\\coin.wav", "assets\\select.wav",    "assets\\song.wav",
+    };
+    Asset_Handle waves[ARRAYSIZE(wave_filenames)];
+    for (u32 i = 0; i < ARRAYSIZE(wave_filenames); i++) {
+        add_job(startup_jobs, acquire_wave_job, wave_filenames[i], &waves[i]);
+    }
+
+    run_jobs(startup_jobs, load_threads);
+    show_load_errors();
+
+    player.walk_right.fps = 8;
+    player.walk_right.id = WALK_RIGHT;
+    player.walk_left.fps = 8;
+    player.walk_left.id = WALK_LEFT;
     player.idle_right.fps = 4;
     player.idle_right.id = IDLE_RIGHT;
-
-    // Idle left animation.
-    player.idle_left.sprites[0] = load_bitmap("assets\\idle_left\\0.bmp");
-    player.idle_left.sprites[1] = load_bitmap("assets\\idle_left\\1.bmp");
-    player.idle_left.sprites[2] = load_bitmap("assets\\idle_left\\2.bmp");
-    player.idle_left.sprites[3] = load_bitmap("assets\\idle_left\\3.bmp");
-    player.idle_left.sprites[4] = load_bitmap("assets\\idle_left\\4.bmp");
-    player.idle_left.sprites[5] = load_bitmap("assets\\idle_left\\5.bmp");
-    player.idle_left.sprites[6] = load_bitmap("assets\\idle_left\\6.bmp");
-    player.idle_left.sprites[7] = load_bitmap("assets\\idle_left\\7.bmp");
     player.idle_left.fps = 4;
     player.idle_left.id = IDLE_LEFT;
 
-    player.current_anim = player.idle_right;
-
-    player.max_speed = 750.0f;
-    player.width = 31 * 3;
-    player.height = 56 * 3;
-
     // Fill out the game struct.
-    Game game = {};
-    game.gravity = 1500.0f;
+    game.sim.player.max_speed = 750.0f;
+    game.sim.player.width = 31 * 3;
+    game.sim.player.height = 56 * 3;
+    game.sim.gravity = 1500.0f;
     game.player = &player;
     game.camera = Vector2f();
-    game.collision = {};
     game.state = MAIN_MENU;
+    game.redraw_screen = true;
 
     game.hit_sound = load_sound(&engine.audio, "assets\\hit.wav");
     game.completed_sound = load_sound(&engine.audio, "assets\\completed.wav");
@@ -723,17 +760,12 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
     game.jump_sound = load_sound(&engine.audio, "assets\\jump 1.wav");
     game.coin_sound = load_sound(&engine.audio, "assets\\coin.wav");
 
-    // Laad de plaatjes.
-    game.main_menu = load_bitmap("assets\\main menu.bmp");
-    // game.background = load_bitmap("assets\\background.bmp");
-    // game.level_complete = load_bitmap("assets\\level complete.bmp");
-    // game.end_game = load_bitmap("assets\\end game.bmp");
-    // game.level_failed = load_bitmap("assets\\level failed.bmp");
+    // Laad de plaatjes. Het hoofdmenu komt eerst, daarna wat we na de play knop nodig hebben.
+    game.main_menu = request_sprite(&engine.loader, "assets\\main menu.bmp");
 
     // Maak de UI.
     game.quit_button.half_width = 225;
     game.quit_button.half_height = 90;
-    game.quit_button.sprite = load_bitmap("assets\\quit button.bmp");
     game.quit_button.position.x = 1920 / 2;
     game.quit_button.position.y = 250;
     game.quit_button.select_sound = load_sound(&engine.audio, "assets\\select.wav");
@@ -741,58 +773,115 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
     Button center_button = {};
     center_button.half_width = 225;
     center_button.half_height = 90;
-    center_button.position.x = engine.window.width / 2.0f;
-    center_button.position.y = engine.window.height / 2.0f;
+    center_button.position.x = DESIGN_WIDTH / 2.0f;
+    center_button.position.y = DESIGN_HEIGHT / 2.0f;
     center_button.select_sound = load_sound(&engine.audio, "assets\\select.wav");
 
+    // De sprites van de knoppen zijn al geladen.
+    Sprite next_sprite = game.next_button.sprite;
+    Sprite play_sprite = game.play_button.sprite;
+    Sprite restart_sprite = game.restart_button.sprite;
+
     game.next_button = center_button;
-    game.next_button.sprite = load_bitmap("assets\\next button.bmp");
+    game.next_button.sprite = next_sprite;
 
     game.play_button = center_button;
-    game.play_button.sprite = load_bitmap("assets\\play button.bmp");
+    game.play_button.sprite = play_sprite;
 
     game.restart_button = center_button;
-    game.restart_button.sprite = load_bitmap("assets\\restart button.bmp");
+    game.restart_button.sprite = restart_sprite;
 
     // Laad de levels.
-    // TODO(Kay Verbruggen): Laad alle levels uit een mapje met FindFirstFile en FindNextFile.
-    game.tile_maps[0] = load_tile_map("levels\\1.bmp");
-    game.tile_maps[1] = load_tile_map("levels\\2.bmp");
-    game.tile_maps[2] = load_tile_map("levels\\3.bmp");
-    game.tile_maps[3] = load_tile_map("levels\\4.bmp");
-    game.tile_maps[4] = load_tile_map("levels\\5.bmp");
-    game.tile_maps[5] = load_tile_map("levels\\6.bmp");
-    game.tile_maps[6] = load_tile_map("levels\\7.bmp");
-    game.tile_maps[7] = load_tile_map("levels\\8.bmp");
-    game.tile_maps[8] = load_tile_map("levels\\9.bmp");
-    game.tile_maps[9] = load_tile_map("levels\\10.bmp");
-
-    game.level = read_progress();
-    game.player->position = game.tile_maps[game.level].start_pos;
-
-    game.tips_console[0] = load_bitmap("assets\\console tip 1.bmp");
-    game.tips_console[1] = load_bitmap("assets\\console tip 2.bmp");
-    game.tips_console[2] = load_bitmap("assets\\console tip 3.bmp");
-
-    game.tips_pc[0] = load_bitmap("assets\\pc tip 1.bmp");
-    game.tips_pc[1] = load_bitmap("assets\\pc tip 2.bmp");
-    game.tips_pc[2] = load_bitmap("assets\\pc tip 3.bmp");
+    initialize_level_streamer();
+    load_levels(&game);
+    for (u32 i = 0; i < NUM_LEVELS; i++) {
+        release_asset(&level_designs[i]);
+    }
+
+    // Zet alle kleine sprites samen in een atlas, zie pack_sprite_atlas.
+    Sprite *atlas_sprites[2 * 8 + 1 + 4 + 4];
+    u32 atlas_count = 0;
+    for (u32 i = 0; i < 8; i++) {
+        atlas_sprites[atlas_count++] = &player.walk_right.sprites[i];
+        atlas_sprites[atlas_count++] = &player.idle_right.sprites[i];
+    }
+    atlas_sprites[atlas_count++] = &player.walk_left.sprites[0];
+    atlas_sprites[atlas_count++] = &game.tile_sprites.ground;
+    atlas_sprites[atlas_count++] = &game.tile_sprites.end;
+    atlas_sprites[atlas_count++] = &game.tile_sprites.coin;
+    atlas_sprites[atlas_count++] = &game.tile_sprites.spikes;
+    atlas_sprites[atlas_count++] = &game.quit_button.sprite;
+    atlas_sprites[atlas_count++] = &game.next_button.sprite;
+    atlas_sprites[atlas_count++] = &game.play_button.sprite;
+    atlas_sprites[atlas_count++] = &game.restart_button.sprite;
+    game.atlas = pack_sprite_atlas(atlas_sprites, atlas_count);
+
+    // Pas na het maken van de atlas, want de gespiegelde sprites en current_anim zijn kopieen.
+    for (u32 i = 0; i < 8; i++) {
+        if (i > 0) {
+            player.walk_left.sprites[i] = mirror_sprite(&player.walk_right.sprites[i]);
+        }
+        player.idle_left.sprites[i] = mirror_sprite(&player.idle_right.sprites[i]);
+    }
+    player.current_anim = player.idle_right;
+
+    game.level = custom_level[0] ? 0 : read_progress();
+    if (record_prefix[0]) {
+        game.recording_buffer = push_array(&permanent_arena, u8, RECORDING_BUFFER_SIZE);
+    }
+    if (playback_filename[0]) load_playback(&game);
+    reset_player(&game);
+    prefetch_level_sprites(&engine, &game);
+
+#if PROFILE
+    {
+        LARGE_INTEGER load_end, load_frequency;
+        QueryPerformanceCounter(&load_end);
+        QueryPerformanceFrequency(&load_frequency);
+        char text[256];
+        StringCbPrintfA(text, 256, "Laden (%s): %.3fms, %lldKB uitgepakt in %lld cycles\n",
+                        asset_pack.header ? "asset pack" : "losse bestanden",
+                        (f64)(load_end.QuadPart - load_start.QuadPart) * 1000.0 /
+                            (f64)load_frequency.QuadPart,
+                        sprite_decode_bytes / 1024, sprite_decode_cycles);
+        OutputDebugStringA(text);
+    }
+    log_asset_cache("opstarten");
+    log_arenas();
+
+    // Hoe snel is elke variant van blit_sprite, zie benchmark_blit_variants.
+    benchmark_blit_variants(&engine.window.buffer, &player.walk_right.sprites[0], "player");
+    benchmark_blit_variants(&engine.window.buffer, &game.tile_sprites.ground, "grass");
+    benchmark_blit_variants(&engine.window.buffer, &game.tips_pc[0], "tip");
+    benchmark_wall_kernels();
+    benchmark_math();
+#endif
 
     LARGE_INTEGER frequency;
     QueryPerformanceFrequency(&frequency);
+    engine.counter_frequency = frequency.QuadPart;
 
     LARGE_INTEGER start_count, end_count;
     QueryPerformanceCounter(&start_count);
 
 #if PROFILE
     i64 start_cycles = __rdtsc();
+    bool first_frame = true;
 #endif
     MSG msg;
 
     Sound theme_song = load_sound(&engine.audio, "assets\\song.wav", true);
     play_sound(&theme_song);
 
+    // Alle Sounds hebben nu hun eigen handle naar de samples.
+    for (u32 i = 0; i < ARRAYSIZE(waves); i++) {
+        release_asset(&waves[i]);
+    }
+
     while (engine.running) {
+        // Alles wat de vorige frame tijdelijk nodig had mag weg.
+        reset_arena(&frame_arena);
+
         // Kijk of er nog berichten zijn van Windows, zoja dan moeten we deze eerst afhandelen.
         while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
@@ -806,41 +895,40 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
 
         // NOTE(Kay Verbruggen): Uitleg resizen van het venster.
         // Als we van Windows het bericht WM_SIZE hebben gekregen, weten we dat de afmetingen
-        // van het venster zijn veranderd. Daarom vragen we de nieuwe breedte en hoogte,
-        // vervolgens kunnen we twee dingen doen:
-        // - We kunnen het spel uitrekken zodat het hele venster wordt gevuld.
-        // - We kunnen meer van het spel laten zien zodat de verhoudingen niet veranderen
-        // Op dit moment hebben we een variabele die dit controleerd, misschien dat we later
-        // een keuze tussen de twee maken. Of de speler laten kiezen.
+        // van het venster zijn veranderd. Daarom vragen we de nieuwe breedte en hoogte.
+        // De buffer blijft even groot (de render resolutie), de presenter schaalt hem op naar
+        // de nieuwe grootte van het venster.
         if (engine.window.resized) {
+            engine.window.resized = false;
             RECT window_rect;
             GetWindowRect(window, &window_rect);
             engine.window.width = window_rect.right - window_rect.left;
             engine.window.height = window_rect.bottom - window_rect.top;
 
-            if (!engine.window.stretch_on_resize) {
-                engine.window.resized = false;
-                resize_buffer(&engine.window.buffer,
-                              Vector2i(engine.window.width, engine.window.height));
-            }
+            // Het hele venster moet opnieuw, ook als de buffer hetzelfde is gebleven.
+            engine.window.buffer.all_dirty = true;
+            game.redraw_screen = true;
         }
 
         switch (game.state) {
             case MAIN_MENU: {
                 game.camera = Vector2f();
-                Vector2f center_screen =
-                    Vector2f(engine.window.width / 2.0f, engine.window.height / 2.0f);
-                draw_sprite(&engine.window, game.camera, &game.main_menu, center_screen);
+                if (game.redraw_screen) {
+                    game.redraw_screen = false;
+                    draw_menu_screen(&engine, &game, game.main_menu);
+                    game.play_button.needs_redraw = true;
+                    game.quit_button.needs_redraw = true;
+                }
 
                 update_button(&engine, &game.play_button);
                 if (game.play_button.is_pressed || engine.input.next) {
                     game.state = IN_LEVEL;
                     update_window(&engine.window);
 
-                    game.coin_collected = false;
+                    reset_player(&game);
 
-                    game.background = load_bitmap("assets\\background.bmp");
-                    free_sprite(&game.main_menu);
+                    prefetch_level_sprites(&engine, &game);
+                    release_sprite(&engine.loader, &game.main_menu);
 
                     break;
                 }
@@ -862,23 +950,24 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
 
             case LEVEL_COMPLETE: {
                 game.camera = Vector2f();
-                Vector2f center_screen =
-                    Vector2f(engine.window.width / 2.0f, engine.window.height / 2.0f);
-                draw_sprite(&engine.window, game.camera, &game.level_complete, center_screen);
-                save_progress(game.level + 1);
+                if (game.redraw_screen) {
+                    game.redraw_screen = false;
+                    draw_menu_screen(&engine, &game, game.level_complete);
+                    game.next_button.needs_redraw = true;
+                    game.quit_button.needs_redraw = true;
+                    save_progress(game.level + 1);
+                }
 
                 update_button(&engine, &game.next_button);
                 if (game.next_button.is_pressed || engine.input.next) {
                     game.state = IN_LEVEL;
 
                     game.level++;
-                    game.coin_collected = false;
-                    game.player->position = game.tile_maps[game.level].start_pos;
+                    reset_player(&game);
 
                     update_window(&engine.window);
 
-                    game.background = load_bitmap("assets\\background.bmp");
-                    free_sprite(&game.level_complete);
+                    prefetch_level_sprites(&engine, &game);
 
                     break;
                 }
@@ -894,23 +983,21 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
 
             case LEVEL_FAILED: {
                 game.camera = Vector2f();
-                Vector2f center_screen =
-                    Vector2f(engine.window.width / 2.0f, engine.window.height / 2.0f);
-                draw_sprite(&engine.window, game.camera, &game.level_failed, center_screen);
+                if (game.redraw_screen) {
+                    game.redraw_screen = false;
+                    draw_menu_screen(&engine, &game, game.level_failed);
+                    game.restart_button.needs_redraw = true;
+                    game.quit_button.needs_redraw = true;
+                }
 
                 update_button(&engine, &game.restart_button);
                 if (game.restart_button.is_pressed || engine.input.next) {
                     game.state = IN_LEVEL;
 
-                    game.coin_collected = false;
-                    game.player->position = game.tile_maps[game.level].start_pos;
-                    game.player->velocity = Vector2f();
+                    reset_player(&game);
 
                     update_window(&engine.window);
 
-                    game.background = load_bitmap("assets\\background.bmp");
-                    free_sprite(&game.level_failed);
-
                     break;
                 }
 
@@ -925,32 +1012,40 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
 
             case END: {
                 game.camera = Vector2f();
-                Vector2f center_screen =
-                    Vector2f(engine.window.width / 2.0f, engine.window.height / 2.0f);
-                draw_sprite(&engine.window, game.camera, &game.end_game, center_screen);
-                save_progress(0);
+                if (game.redraw_screen) {
+                    game.redraw_screen = false;
+                    draw_menu_screen(&engine, &game, game.end_game);
+                    game.restart_button.needs_redraw = true;
+                    game.quit_button.needs_redraw = true;
+                    save_progress(0);
+                }
 
                 update_button(&engine, &game.restart_button);
                 if (game.restart_button.is_pressed || engine.input.next) {
                     game.state = MAIN_MENU;
+                    game.redraw_screen = true;
+                    // De draw commands van deze frame kunnen nog naar end_game wijzen, dus eerst
+                    // tekenen en dan pas de plaatjes vrijgeven.
+                    update_window(&engine.window);
 
-                    game.tile_maps[0] = load_tile_map("levels\\1.bmp");
-                    game.tile_maps[1] = load_tile_map("levels\\2.bmp");
-                    game.tile_maps[2] = load_tile_map("levels\\3.bmp");
-                    game.tile_maps[3] = load_tile_map("levels\\4.bmp");
-                    game.tile_maps[4] = load_tile_map("levels\\5.bmp");
-                    game.tile_maps[5] = load_tile_map("levels\\6.bmp");
-                    game.tile_maps[6] = load_tile_map("levels\\7.bmp");
-                    game.tile_maps[7] = load_tile_map("levels\\8.bmp");
-                    game.tile_maps[8] = load_tile_map("levels\\9.bmp");
-                    game.tile_maps[9] = load_tile_map("levels\\10.bmp");
+                    // Laad de levels opnieuw, zodat alle munten er weer liggen.
+                    load_levels(&game);
 
                     game.level = 0;
-                    game.coin_collected = false;
-                    game.player->position = game.tile_maps[game.level].start_pos;
-
-                    game.main_menu = load_bitmap("assets\\main menu.bmp");
-                    free_sprite(&game.end_game);
+                    reset_player(&game);
+
+                    // De level plaatjes zijn we pas weer nodig na de play knop.
+                    prefetch_sprite(&engine.loader, &game.main_menu, "assets\\main menu.bmp");
+                    release_sprite(&engine.loader, &game.background);
+                    release_sprite(&engine.loader, &game.level_complete);
+                    release_sprite(&engine.loader, &game.level_failed);
+                    release_sprite(&engine.loader, &game.end_game);
+#if PROFILE
+                    // Na elke keer uitspelen moet dit hetzelfde zijn.
+                    log_asset_cache("einde");
+                    log_arenas();
+                    log_level_streamer();
+#endif
                     break;
                 }
 
@@ -971,12 +1066,25 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
 
         // Profile performance hier, de sleep hoort niet bij de daadwerkelijke performance.
 #if PROFILE
+        if (first_frame) {
+            first_frame = false;
+            char text[256];
+            StringCbPrintfA(text, 256, "Eerste frame na %.3fms (%u laad threads)\n",
+                            (f64)(end_count.QuadPart - load_start.QuadPart) * 1000.0 /
+                                (f64)frequency.QuadPart,
+                            minimum(maximum(load_threads, 1u), (u32)MAX_JOB_THREADS));
+            OutputDebugStringA(text);
+        }
+
         i64 end_cycles = __rdtsc();
         i64 delta_cycles = end_cycles - start_cycles;
         char buffer[256];
-        StringCbPrintfA(buffer, 256, "Delta Time: %fms\tFPS: %lld\tCycles: %lld\n",
-                        engine.delta_time * 1000.0f, fps, delta_cycles);
+        StringCbPrintfA(buffer, 256,
+                        "Delta Time: %fms\tFPS: %lld\tCycles: %lld\tBlit: %lluKB\tPresented: %llu\n",
+                        engine.delta_time * 1000.0f, fps, delta_cycles, blit_bytes_touched / 1024,
+                        InterlockedExchange64(&engine.window.presenter->pixels_presented, 0));
         OutputDebugStringA(buffer);
+        blit_bytes_touched = 0;
         start_cycles = end_cycles;
 #endif
         // Sleep zodat de engine op een bepaald aantal fps runt,
@@ -987,6 +1095,7 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
 
         QueryPerformanceCounter(&end_count);
         delta_counter = end_count.QuadPart - start_count.QuadPart;
+        engine.delta_counter = delta_counter;
         engine.delta_time = (f32)(delta_counter) / (f32)frequency.QuadPart;
 
 #if PROFILE
@@ -999,7 +1108,12 @@ int WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int sho
         start_count = end_count;
     }
 
+    close_presenter(engine.window.presenter);
     ReleaseDC(window, engine.window.device_context);
     close_audio(&engine.audio);
+    close_asset_loader(&engine.loader);
+    close_levels(&game);
+    close_level_streamer();
+    close_asset_pack();
     return 0;
 }
@@ -0,0 +1,697 @@
+// NOTE: Uitleg presenter.
+// De buffer naar het venster sturen (StretchDIBits) kost veel tijd, zeker als het venster groot is.
+// Daarom doet een aparte thread dat, zodat de game alvast de volgende frame kan tekenen. De game
+// tekent altijd in Window::buffer. Als een frame klaar is, kopieren we de stukken die veranderd
+// zijn naar een van de drie slots, en geven we die slot aan de presenter thread.
+//
+// Van de drie slots is er altijd een van de game (back), een van de presenter (front) en een die
+// klaarstaat om getoond te worden (pending). Wisselen gaat met een atomic exchange op pending, dus
+// de game hoeft nooit op de presenter te wachten. Als de game sneller is dan de presenter,
+// wordt de klaarstaande frame gewoon vervangen door de nieuwere.
+//
+// Als de buffer kleiner is dan het venster (zie set_render_resolution), schaalt de presenter
+// thread de frame eerst zelf op met een van de upscale kernels hieronder. GDI krijgt de frame dan
+// op de goede grootte en hoeft niks meer uit te rekken.
+//
+// De threads, events, locks en de klok staan achter #ifdef _WIN32, net als in replay.cpp. Zo draait
+// de presenter met present_frame_memory ook zonder scherm op Linux, zie de present test in
+// tests.cpp. present_frame_gdi en wat met het venster te maken heeft zijn er alleen in het spel,
+// niet in tests.cpp (TESTS).
+#define PRESENT_SLOTS 3
+#define PRESENT_SLOT_MASK 3
+// Deze bit staat in pending als de slot nog niet getoond is.
+#define PRESENT_NEW_FRAME 4
+
+#ifdef _WIN32
+typedef HANDLE Present_Thread;
+typedef HANDLE Present_Event;
+typedef CRITICAL_SECTION Present_Lock;
+#else
+typedef pthread_t Present_Thread;
+// Gaat weer uit als er iemand op gewacht heeft, net als een auto-reset event op Windows.
+struct Present_Event {
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    bool set;
+};
+typedef pthread_mutex_t Present_Lock;
+#endif
+
+static void initialize_present_event(Present_Event *event) {
+#ifdef _WIN32
+    *event = CreateEventA(0, FALSE, FALSE, 0);
+#else
+    pthread_mutex_init(&event->mutex, 0);
+    pthread_cond_init(&event->condition, 0);
+    event->set = false;
+#endif
+}
+
+static void set_present_event(Present_Event *event) {
+#ifdef _WIN32
+    SetEvent(*event);
+#else
+    pthread_mutex_lock(&event->mutex);
+    event->set = true;
+    pthread_cond_signal(&event->condition);
+    pthread_mutex_unlock(&event->mutex);
+#endif
+}
+
+static void wait_present_event(Present_Event *event) {
+#ifdef _WIN32
+    WaitForSingleObject(*event, INFINITE);
+#else
+    pthread_mutex_lock(&event->mutex);
+    while (!event->set) {
+        pthread_cond_wait(&event->condition, &event->mutex);
+    }
+    event->set = false;
+    pthread_mutex_unlock(&event->mutex);
+#endif
+}
+
+static void initialize_present_lock(Present_Lock *lock) {
+#ifdef _WIN32
+    InitializeCriticalSection(lock);
+#else
+    pthread_mutex_init(lock, 0);
+#endif
+}
+
+static void lock_present(Present_Lock *lock) {
+#ifdef _WIN32
+    EnterCriticalSection(lock);
+#else
+    pthread_mutex_lock(lock);
+#endif
+}
+
+static void unlock_present(Present_Lock *lock) {
+#ifdef _WIN32
+    LeaveCriticalSection(lock);
+#else
+    pthread_mutex_unlock(lock);
+#endif
+}
+
+// Zet value in target en geef de oude waarde terug, in een keer.
+static long exchange_present(volatile long *target, long value) {
+#ifdef _WIN32
+    return InterlockedExchange(target, value);
+#else
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void add_present(volatile i64 *target, i64 value) {
+#ifdef _WIN32
+    InterlockedExchangeAdd64(target, value);
+#else
+    __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Een tijd in ticks van get_time_frequency per seconde.
+static i64 get_time() {
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+#else
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (i64)time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+}
+
+static i64 get_time_frequency() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+#else
+    return 1000000000;
+#endif
+}
+
+struct Present_Slot {
+    // Een kopie van de buffer, met de stukken die deze frame veranderd zijn als dirty rects.
+    Offscreen_Buffer image;
+    // Hoe groot het venster was.
+    u32 target_width, target_height;
+
+    u32 frame_index;
+    i64 submit_time;
+};
+
+// Wanneer een frame binnenkwam en wanneer de presenter hem liet zien, in get_time tijd. De
+// presenter houdt de laatste PRESENT_TIMING_COUNT bij, ook zonder PROFILE.
+#define PRESENT_TIMING_COUNT 256
+
+struct Present_Timing {
+    u32 frame_index;
+    i64 submit_time;
+    i64 present_start, present_end;
+};
+
+enum Upscale_Filter {
+    UPSCALE_NEAREST,
+    UPSCALE_BILINEAR,
+};
+
+struct Presenter;
+typedef void Present_Frame(Presenter *presenter, Offscreen_Buffer *image, u32 target_width,
+                           u32 target_height);
+
+struct Presenter {
+    // De implementatie die de frame echt laat zien, zie present_frame_gdi en
+    // present_frame_memory.
+    Present_Frame *present_frame;
+#if !TESTS
+    HDC device_context;
+#endif
+    Offscreen_Buffer memory_target;
+
+    // De opgeschaalde frame, en een rij waar de bilinear kernel tussenresultaten in zet.
+    Upscale_Filter filter;
+    Offscreen_Buffer scaled;
+    u32 *filter_row;
+    u32 filter_row_size;
+    // Per kolom van scaled de kolom van de frame waar hij vandaan komt, zie fill_upscale_columns.
+    // Gemaakt voor een frame van columns_source_width naar scaled van columns_width breed.
+    u32 *columns;
+    u32 columns_width, columns_source_width;
+
+    Present_Slot slots[PRESENT_SLOTS];
+    u32 back;
+    volatile long pending;
+    u32 front;
+    u32 frame_index;
+
+    Present_Thread thread;
+    Present_Event frame_event;
+    volatile long quit;
+    // De presenter houdt deze vast zolang hij een frame laat zien, zodat we de slots veilig
+    // kunnen vervangen als de buffer van grootte verandert.
+    Present_Lock resize_lock;
+
+    volatile i64 pixels_presented;
+    // Ringbuffer, timing_count loopt altijd door. Alleen aanraken met resize_lock vast.
+    Present_Timing timings[PRESENT_TIMING_COUNT];
+    u32 timing_count;
+    i64 frequency;
+    i64 start_time;
+};
+
+#if !TESTS
+// Stuur de veranderde stukken van de frame met GDI naar het venster.
+static void present_frame_gdi(Presenter *presenter, Offscreen_Buffer *image, u32 target_width,
+                              u32 target_height) {
+    if (image->all_dirty) {
+        // PatBlt(window->device_context, 0, 0, window->width, window->height, BLACKNESS);
+
+        StretchDIBits(presenter->device_context, 0, 0, target_width, target_height, 0, 0,
+                      image->width, image->height, image->memory, &image->info, DIB_RGB_COLORS,
+                      SRCCOPY);
+        return;
+    }
+
+    for (u32 i = 0; i < image->dirty_count; i++) {
+        Rect rect = image->dirty_rects[i];
+
+        // De buffer staat op zijn kop in het geheugen (de onderste rij komt eerst), het venster
+        // niet. Daarom draaien we de y-as om voor het venster.
+        i32 dest_min_x = rect.min_x * (i32)target_width / (i32)image->width;
+        i32 dest_max_x = rect.max_x * (i32)target_width / (i32)image->width;
+        i32 dest_min_y =
+            ((i32)image->height - rect.max_y) * (i32)target_height / (i32)image->height;
+        i32 dest_max_y =
+            ((i32)image->height - rect.min_y) * (i32)target_height / (i32)image->height;
+
+        StretchDIBits(presenter->device_context, dest_min_x, dest_min_y, dest_max_x - dest_min_x,
+                      dest_max_y - dest_min_y, rect.min_x, rect.min_y, rect.max_x - rect.min_x,
+                      rect.max_y - rect.min_y, image->memory, &image->info, DIB_RGB_COLORS,
+                      SRCCOPY);
+    }
+}
+#endif
+
+// Kopieer de veranderde stukken alleen naar een buffer in het geheugen. Hiermee kan de presenter
+// draaien zonder scherm.
+// De buffer in het geheugen is altijd even groot als de image, dus het venster maakt niet uit.
+static void present_frame_memory(Presenter *presenter, Offscreen_Buffer *image,
+                                 u32 /* target_width */, u32 /* target_height */) {
+    Offscreen_Buffer *target = &presenter->memory_target;
+    if ((target->width != image->width) || (target->height != image->height)) {
+        resize_buffer(target, Vector2i(image->width, image->height));
+    }
+
+    Rect full = buffer_rect(image);
+    u32 rect_count = image->all_dirty ? 1 : image->dirty_count;
+    for (u32 i = 0; i < rect_count; i++) {
+        Rect rect = image->all_dirty ? full : image->dirty_rects[i];
+        for (i32 y = rect.min_y; y < rect.max_y; y++) {
+            memcpy((u8 *)target->memory + y * target->pitch + rect.min_x * 4,
+                   (u8 *)image->memory + y * image->pitch + rect.min_x * 4,
+                   (rect.max_x - rect.min_x) * 4);
+        }
+    }
+}
+
+// NOTE: Uitleg upscale kernels.
+// Alle kernels vullen een rechthoek van de grote buffer (dest) met pixels van de kleine buffer
+// (source). Welke source kolom bij een dest kolom hoort staat in presenter->columns, die maken we
+// alleen opnieuw als een van de twee breedtes verandert. Zo hoeft een kernel per pixel niet te
+// delen.
+// - Nearest: neem de dichtstbijzijnde pixel. Is het venster een heel aantal keer zo breed (960x540
+//   naar 1920x1080 is 2, 640x360 is 3, 320x180 is 6), dan herhalen we de pixels met SSE2: bij 2 en
+//   3 met shuffles van 4 source pixels, daarboven met een store per 4 dest pixels. Anders pakken we
+//   per pixel de kolom uit de tabel. Een dest rij met dezelfde source rij als de rij erboven
+//   kopieren we in een keer.
+// - Bilinear: meng de 4 dichtstbijzijnde pixels. Eerst mengen we twee rijen van de source tot een
+//   rij, alleen de kolommen die de rechthoek nodig heeft. Daarna mengen we in die rij de twee
+//   buren van elke dest pixel. Allebei doen we 4 pixels tegelijk. In de tabel staat hier de
+//   linker buur met het gewicht van de rechter in de onderste 7 bits. Gewichten zijn 7 bits,
+//   zodat alles in 16 bits past.
+
+// Vul presenter->columns voor een frame van source_width naar dest_width pixels breed.
+static void fill_upscale_columns(Presenter *presenter, u32 source_width, u32 dest_width) {
+    if ((presenter->columns_width == dest_width) &&
+        (presenter->columns_source_width == source_width)) {
+        return;
+    }
+
+    if (presenter->columns_width != dest_width) {
+        if (presenter->columns) free_pages(presenter->columns);
+        presenter->columns = (u32 *)allocate_pages(sizeof(u32) * dest_width);
+    }
+    presenter->columns_width = dest_width;
+    presenter->columns_source_width = source_width;
+
+    if (presenter->filter == UPSCALE_BILINEAR) {
+        // Posities in 16.16 fixed point, gemeten vanaf het midden van de pixels.
+        i64 step_x = (((i64)source_width << 16) + dest_width / 2) / dest_width;
+        for (u32 x = 0; x < dest_width; x++) {
+            i64 position_x = maximum(x * step_x + step_x / 2 - 32768, 0);
+            presenter->columns[x] = (u32)(((position_x >> 16) << 7) | ((position_x >> 9) & 127));
+        }
+    } else {
+        for (u32 x = 0; x < dest_width; x++) {
+            presenter->columns[x] = (u32)((u64)x * source_width / dest_width);
+        }
+    }
+}
+
+static void upscale_nearest(Presenter *presenter, Offscreen_Buffer *source,
+                            Offscreen_Buffer *dest, Rect rect) {
+    u32 *columns = presenter->columns;
+    u32 factor = (dest->width % source->width == 0) ? dest->width / source->width : 0;
+
+    u32 previous_y = 0;
+    for (i32 y = rect.min_y; y < rect.max_y; y++) {
+        u32 source_y = (u32)((u64)y * source->height / dest->height);
+        u32 *source_row = (u32 *)((u8 *)source->memory + source_y * source->pitch);
+        u32 *dest_row = (u32 *)((u8 *)dest->memory + y * dest->pitch);
+
+        if ((y > rect.min_y) && (source_y == previous_y)) {
+            u32 *previous_row = (u32 *)((u8 *)dest_row - dest->pitch);
+            memcpy(dest_row + rect.min_x, previous_row + rect.min_x,
+                   sizeof(u32) * (rect.max_x - rect.min_x));
+            continue;
+        }
+        previous_y = source_y;
+
+        // Begin op de eerste pixel van een source pixel, zodat we hele source pixels schrijven.
+        i32 x = rect.min_x;
+        if (factor >= 2) {
+            for (; (x > 0) && (x < rect.max_x) && (columns[x] == columns[x - 1]); x++) {
+                dest_row[x] = source_row[columns[x]];
+            }
+        }
+
+        if (factor == 2) {
+            for (; x + 8 <= rect.max_x; x += 8) {
+                __m128i pixels = _mm_loadu_si128((__m128i *)(source_row + columns[x]));
+                _mm_storeu_si128((__m128i *)(dest_row + x), _mm_unpacklo_epi32(pixels, pixels));
+                _mm_storeu_si128((__m128i *)(dest_row + x + 4), _mm_unpackhi_epi32(pixels, pixels));
+            }
+        } else if (factor == 3) {
+            for (; x + 12 <= rect.max_x; x += 12) {
+                __m128i pixels = _mm_loadu_si128((__m128i *)(source_row + columns[x]));
+                _mm_storeu_si128((__m128i *)(dest_row + x),
+                                 _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 0, 0, 0)));
+                _mm_storeu_si128((__m128i *)(dest_row + x + 4),
+                                 _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 1, 1)));
+                _mm_storeu_si128((__m128i *)(dest_row + x + 8),
+                                 _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 2)));
+            }
+        } else if (factor >= 4) {
+            // De laatste store van een source pixel begint op factor - 4, en schrijft dus over
+            // wat de vorige store al had geschreven als factor geen veelvoud van 4 is.
+            for (; x + (i32)factor <= rect.max_x; x += factor) {
+                __m128i pixels = _mm_set1_epi32((i32)source_row[columns[x]]);
+                for (u32 i = 0; i + 4 < factor; i += 4) {
+                    _mm_storeu_si128((__m128i *)(dest_row + x + i), pixels);
+                }
+                _mm_storeu_si128((__m128i *)(dest_row + x + factor - 4), pixels);
+            }
+        }
+
+        for (; x < rect.max_x; x++) {
+            dest_row[x] = source_row[columns[x]];
+        }
+    }
+}
+
+// Meng twee pixels, weight gaat van 0 (alleen a) tot 128 (alleen b).
+static __m128i lerp_pixels(__m128i a, __m128i b, __m128i weight) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i a16 = _mm_unpacklo_epi8(a, zero);
+    __m128i b16 = _mm_unpacklo_epi8(b, zero);
+    __m128i difference = _mm_mullo_epi16(_mm_sub_epi16(b16, a16), weight);
+    return _mm_add_epi16(a16, _mm_srai_epi16(difference, 7));
+}
+
+static void upscale_bilinear(Presenter *presenter, Offscreen_Buffer *source,
+                             Offscreen_Buffer *dest, Rect rect) {
+    u32 *columns = presenter->columns;
+    i64 step_y = (((i64)source->height << 16) + dest->height / 2) / dest->height;
+    __m128i zero = _mm_setzero_si128();
+
+    // De source kolommen waar de rechthoek van leest: de linker buren, en rechts een extra.
+    u32 first = columns[rect.min_x] >> 7;
+    u32 last = minimum((columns[rect.max_x - 1] >> 7) + 1, source->width - 1);
+
+    // De rij moet een pixel extra hebben, zodat de laatste pixel een buurman heeft.
+    u32 *row = presenter->filter_row;
+
+    for (i32 y = rect.min_y; y < rect.max_y; y++) {
+        i64 position_y = maximum(y * step_y + step_y / 2 - 32768, 0);
+        u32 y0 = (u32)(position_y >> 16);
+        u32 y1 = minimum(y0 + 1, source->height - 1);
+        __m128i weight_y = _mm_set1_epi16((i16)((position_y >> 9) & 127));
+
+        // Meng de twee rijen, 4 pixels tegelijk.
+        u32 *row0 = (u32 *)((u8 *)source->memory + y0 * source->pitch);
+        u32 *row1 = (u32 *)((u8 *)source->memory + y1 * source->pitch);
+        u32 x = first;
+        for (; x + 4 <= last + 1; x += 4) {
+            __m128i a = _mm_loadu_si128((__m128i *)(row0 + x));
+            __m128i b = _mm_loadu_si128((__m128i *)(row1 + x));
+            __m128i low = lerp_pixels(a, b, weight_y);
+            __m128i high =
+                lerp_pixels(_mm_srli_si128(a, 8), _mm_srli_si128(b, 8), weight_y);
+            _mm_storeu_si128((__m128i *)(row + x), _mm_packus_epi16(low, high));
+        }
+        for (; x <= last; x++) {
+            __m128i mixed = lerp_pixels(_mm_cvtsi32_si128(row0[x]), _mm_cvtsi32_si128(row1[x]),
+                                        weight_y);
+            row[x] = _mm_cvtsi128_si32(_mm_packus_epi16(mixed, zero));
+        }
+        if (last == source->width - 1) row[source->width] = row[last];
+
+        // Meng de twee buren in de rij, 4 pixels tegelijk. Een paar buren laden we met een 64 bits
+        // load, en twee paren samen geven twee linker buren in de onderste helft en de twee
+        // rechter buren in de bovenste.
+        u32 *dest_row = (u32 *)((u8 *)dest->memory + y * dest->pitch);
+        i32 dest_x = rect.min_x;
+        for (; dest_x + 4 <= rect.max_x; dest_x += 4) {
+            u32 *column = columns + dest_x;
+            __m128i pair0 = _mm_loadl_epi64((__m128i *)(row + (column[0] >> 7)));
+            __m128i pair1 = _mm_loadl_epi64((__m128i *)(row + (column[1] >> 7)));
+            __m128i pair2 = _mm_loadl_epi64((__m128i *)(row + (column[2] >> 7)));
+            __m128i pair3 = _mm_loadl_epi64((__m128i *)(row + (column[3] >> 7)));
+            __m128i pairs01 = _mm_unpacklo_epi32(pair0, pair1);
+            __m128i pairs23 = _mm_unpacklo_epi32(pair2, pair3);
+
+            __m128i weight01 = _mm_unpacklo_epi64(_mm_set1_epi16((i16)(column[0] & 127)),
+                                                  _mm_set1_epi16((i16)(column[1] & 127)));
+            __m128i weight23 = _mm_unpacklo_epi64(_mm_set1_epi16((i16)(column[2] & 127)),
+                                                  _mm_set1_epi16((i16)(column[3] & 127)));
+            __m128i low = lerp_pixels(pairs01, _mm_srli_si128(pairs01, 8), weight01);
+            __m128i high = lerp_pixels(pairs23, _mm_srli_si128(pairs23, 8), weight23);
+            _mm_storeu_si128((__m128i *)(dest_row + dest_x), _mm_packus_epi16(low, high));
+        }
+        for (; dest_x < rect.max_x; dest_x++) {
+            __m128i weight_x = _mm_set1_epi16((i16)(columns[dest_x] & 127));
+            __m128i pair = _mm_loadl_epi64((__m128i *)(row + (columns[dest_x] >> 7)));
+            __m128i mixed = lerp_pixels(pair, _mm_srli_si128(pair, 4), weight_x);
+            dest_row[dest_x] = _mm_cvtsi128_si32(_mm_packus_epi16(mixed, zero));
+        }
+    }
+}
+
+// Schaal de veranderde stukken van de frame op naar de grootte van het venster. De dirty rects
+// van de opgeschaalde buffer zijn daarna de stukken die we hebben ingevuld.
+static Offscreen_Buffer *upscale_image(Presenter *presenter, Offscreen_Buffer *image,
+                                       u32 target_width, u32 target_height) {
+    if ((image->width == target_width) && (image->height == target_height)) {
+        return image;
+    }
+
+    Offscreen_Buffer *scaled = &presenter->scaled;
+    if ((scaled->width != target_width) || (scaled->height != target_height)) {
+        resize_buffer(scaled, Vector2i(target_width, target_height));
+        // Na het resizen staat er nog niks in de buffer, dus moet alles opnieuw.
+        image->all_dirty = true;
+    }
+
+    if (presenter->filter_row_size < image->width + 1) {
+        if (presenter->filter_row) free_pages(presenter->filter_row);
+        presenter->filter_row_size = image->width + 1;
+        presenter->filter_row = (u32 *)allocate_pages(sizeof(u32) * presenter->filter_row_size);
+    }
+    fill_upscale_columns(presenter, image->width, target_width);
+
+    scaled->all_dirty = image->all_dirty;
+    scaled->dirty_count = 0;
+
+    u32 rect_count = image->all_dirty ? 1 : image->dirty_count;
+    for (u32 i = 0; i < rect_count; i++) {
+        Rect rect = image->all_dirty ? buffer_rect(image) : image->dirty_rects[i];
+
+        // Bij bilinear hangt een pixel ook van zijn buren af, dus nemen we een pixel extra mee.
+        // Wat de kernels daarvoor lezen heeft submit_frame ook gekopieerd.
+        Rect dest_rect;
+        dest_rect.min_x = maximum((i64)(rect.min_x - 1) * target_width / image->width, 0);
+        dest_rect.min_y = maximum((i64)(rect.min_y - 1) * target_height / image->height, 0);
+        dest_rect.max_x =
+            minimum(((i64)(rect.max_x + 1) * target_width + image->width - 1) / image->width,
+                    (i64)target_width);
+        dest_rect.max_y =
+            minimum(((i64)(rect.max_y + 1) * target_height + image->height - 1) / image->height,
+                    (i64)target_height);
+
+        if (presenter->filter == UPSCALE_BILINEAR) {
+            upscale_bilinear(presenter, image, scaled, dest_rect);
+        } else {
+            upscale_nearest(presenter, image, scaled, dest_rect);
+        }
+
+        if (!scaled->all_dirty) {
+            mark_dirty(scaled, dest_rect);
+        }
+    }
+
+    return scaled;
+}
+
+static u64 get_image_pixels(Offscreen_Buffer *image) {
+    if (image->all_dirty) return (u64)image->width * image->height;
+
+    u64 result = 0;
+    for (u32 i = 0; i < image->dirty_count; i++) {
+        Rect rect = image->dirty_rects[i];
+        result += (u64)(rect.max_x - rect.min_x) * (rect.max_y - rect.min_y);
+    }
+    return result;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI presenter_proc(LPVOID parameter) {
+#else
+static void *presenter_proc(void *parameter) {
+#endif
+    Presenter *presenter = (Presenter *)parameter;
+
+    for (;;) {
+        wait_present_event(&presenter->frame_event);
+        if (presenter->quit) break;
+
+        lock_present(&presenter->resize_lock);
+        if (presenter->pending & PRESENT_NEW_FRAME) {
+            // Geef onze oude slot terug en pak de nieuwe frame.
+            long old = exchange_present(&presenter->pending, presenter->front);
+            presenter->front = old & PRESENT_SLOT_MASK;
+
+            Present_Slot *slot = presenter->slots + presenter->front;
+            i64 present_start = get_time();
+            Offscreen_Buffer *image =
+                upscale_image(presenter, &slot->image, slot->target_width, slot->target_height);
+            presenter->present_frame(presenter, image, slot->target_width, slot->target_height);
+            i64 present_end = get_time();
+
+            add_present(&presenter->pixels_presented, (i64)get_image_pixels(image));
+
+            Present_Timing *timing =
+                presenter->timings + (presenter->timing_count++ % PRESENT_TIMING_COUNT);
+            timing->frame_index = slot->frame_index;
+            timing->submit_time = slot->submit_time;
+            timing->present_start = present_start;
+            timing->present_end = present_end;
+
+#if PROFILE
+            f64 to_ms = 1000.0 / (f64)presenter->frequency;
+            char text[256];
+            StringCbPrintfA(text, 256, "Present frame %u: submit %.3fms, present %.3fms - %.3fms\n",
+                            timing->frame_index,
+                            (f64)(timing->submit_time - presenter->start_time) * to_ms,
+                            (f64)(timing->present_start - presenter->start_time) * to_ms,
+                            (f64)(timing->present_end - presenter->start_time) * to_ms);
+            OutputDebugStringA(text);
+#endif
+        }
+        unlock_present(&presenter->resize_lock);
+    }
+
+    return 0;
+}
+
+// Maak alle slots net zo groot als de buffer. Dit gebeurt alleen als de buffer van grootte
+// verandert, dus hier mogen we wel op de presenter wachten.
+static void resize_present_slots(Presenter *presenter, Offscreen_Buffer *buffer) {
+    lock_present(&presenter->resize_lock);
+
+    for (u32 i = 0; i < PRESENT_SLOTS; i++) {
+        resize_buffer(&presenter->slots[i].image, Vector2i(buffer->width, buffer->height));
+    }
+
+    // Een frame die nog klaarstond heeft de oude grootte, die laten we niet meer zien.
+    presenter->pending &= PRESENT_SLOT_MASK;
+    buffer->all_dirty = true;
+
+    unlock_present(&presenter->resize_lock);
+}
+
+static void submit_frame(Presenter *presenter, Offscreen_Buffer *buffer, u32 target_width,
+                         u32 target_height) {
+    // Niks veranderd, dan hoeven we ook niks te laten zien.
+    if (!buffer->all_dirty && (buffer->dirty_count == 0)) return;
+
+    Present_Slot *slot = presenter->slots + presenter->back;
+    Offscreen_Buffer *image = &slot->image;
+    if ((image->width != buffer->width) || (image->height != buffer->height)) {
+        resize_present_slots(presenter, buffer);
+    }
+
+    if (buffer->all_dirty) {
+        memcpy(image->memory, buffer->memory, buffer->pitch * buffer->height);
+    } else {
+        // De rest van de slot kan nog van een oudere frame zijn, dus kopieren we twee pixels extra
+        // rondom. upscale_image vult een source pixel extra in, en de kernels lezen voor de rand
+        // daarvan nog een pixel verder: nearest rondt af naar beneden, bilinear neemt de buurman.
+        Rect full = buffer_rect(buffer);
+        for (u32 i = 0; i < buffer->dirty_count; i++) {
+            Rect rect = buffer->dirty_rects[i];
+            rect.min_x = maximum(rect.min_x - 2, full.min_x);
+            rect.min_y = maximum(rect.min_y - 2, full.min_y);
+            rect.max_x = minimum(rect.max_x + 2, full.max_x);
+            rect.max_y = minimum(rect.max_y + 2, full.max_y);
+            for (i32 y = rect.min_y; y < rect.max_y; y++) {
+                memcpy((u8 *)image->memory + y * image->pitch + rect.min_x * 4,
+                       (u8 *)buffer->memory + y * buffer->pitch + rect.min_x * 4,
+                       (rect.max_x - rect.min_x) * 4);
+            }
+        }
+    }
+
+    memcpy(image->dirty_rects, buffer->dirty_rects, sizeof(Rect) * buffer->dirty_count);
+    image->dirty_count = buffer->dirty_count;
+    image->all_dirty = buffer->all_dirty;
+    slot->target_width = target_width;
+    slot->target_height = target_height;
+    slot->frame_index = presenter->frame_index++;
+    slot->submit_time = get_time();
+
+    buffer->dirty_count = 0;
+    buffer->all_dirty = false;
+
+    long old = exchange_present(&presenter->pending, presenter->back | PRESENT_NEW_FRAME);
+    presenter->back = old & PRESENT_SLOT_MASK;
+
+    // Als de frame die klaarstond nooit is getoond, moeten zijn stukken mee met de volgende frame.
+    if (old & PRESENT_NEW_FRAME) {
+        Offscreen_Buffer *skipped = &presenter->slots[presenter->back].image;
+        if (skipped->all_dirty) {
+            buffer->all_dirty = true;
+        } else {
+            for (u32 i = 0; i < skipped->dirty_count; i++) {
+                mark_dirty(buffer, skipped->dirty_rects[i]);
+            }
+        }
+    }
+
+    set_present_event(&presenter->frame_event);
+}
+
+// Start de presenter thread, presenter moet leeg zijn. present_frame is bijvoorbeeld
+// present_frame_memory.
+static void start_presenter(Presenter *presenter, Present_Frame *present_frame,
+                            Upscale_Filter filter) {
+    presenter->present_frame = present_frame;
+    presenter->filter = filter;
+    presenter->back = 0;
+    presenter->pending = 1;
+    presenter->front = 2;
+    presenter->timing_count = 0;
+
+    presenter->frequency = get_time_frequency();
+    presenter->start_time = get_time();
+
+    initialize_present_lock(&presenter->resize_lock);
+    initialize_present_event(&presenter->frame_event);
+#ifdef _WIN32
+    presenter->thread = CreateThread(0, 0, presenter_proc, presenter, 0, 0);
+#else
+    pthread_create(&presenter->thread, 0, presenter_proc, presenter);
+#endif
+}
+
+// Kopieer de laatste timings, oudste eerst. Geeft terug hoeveel het er zijn.
+static u32 get_present_timings(Presenter *presenter, Present_Timing *result, u32 max_count) {
+    lock_present(&presenter->resize_lock);
+    u32 count = minimum(presenter->timing_count, minimum(max_count, (u32)PRESENT_TIMING_COUNT));
+    u32 first = presenter->timing_count - count;
+    for (u32 index = 0; index < count; ++index) {
+        result[index] = presenter->timings[(first + index) % PRESENT_TIMING_COUNT];
+    }
+    unlock_present(&presenter->resize_lock);
+    return count;
+}
+
+static void close_presenter(Presenter *presenter) {
+    presenter->quit = 1;
+    set_present_event(&presenter->frame_event);
+#ifdef _WIN32
+    WaitForSingleObject(presenter->thread, INFINITE);
+#else
+    pthread_join(presenter->thread, 0);
+#endif
+}
+
+#if !TESTS
+static Presenter *initialize_presenter(Window *window, bool use_display, Upscale_Filter filter) {
+    Presenter *presenter = push_array(&permanent_arena, Presenter, 1);
+    presenter->device_context = window->device_context;
+    start_presenter(presenter, use_display ? present_frame_gdi : present_frame_memory, filter);
+
+    window->presenter = presenter;
+    return presenter;
+}
+
+static void update_window(Window *window) {
+    flush_render_queue(window);
+    submit_frame(window->presenter, &window->buffer, window->width, window->height);
+}
+#endif
@@ -0,0 +1,301 @@
+// NOTE: Uitleg opnames.
+// Een opname is de input van een poging van een level, tick voor tick, zodat we dezelfde poging
+// later precies zo opnieuw kunnen spelen: in het spel met -play, of zonder venster met de replay
+// runner (zie replay.cpp). Omdat de natuurkunde een vaste tick heeft, komt er met dezelfde input
+// bit voor bit hetzelfde uit. Of dat echt zo is controleren we met checkpoints: elke
+// RECORDING_CHECKPOINT_TICKS ticks en aan het einde schrijven we hash_level_sim op.
+//
+// Meestal verandert de input maar af en toe, dus we schrijven alleen wat er verandert. Na de
+// Recording_Header komt een lijst events. Elk event begint met een varint
+// (ticks sinds het vorige event << 1) | soort:
+// - RECORDING_INPUT: een byte met RECORDING_ flags en daarna, als movement veranderd is, het
+//   verschil met de vorige movement als zigzag varint in stappen van 1/RECORDING_MOVEMENT_SCALE.
+//   Alleen als movement daar niet precies in past, komen de vier bytes van de float zelf.
+//   De input geldt vanaf deze tick tot het volgende input event.
+// - RECORDING_CHECKPOINT: de acht bytes van hash_level_sim na zoveel ticks.
+// Met het toetsenbord is een opname zo een paar bytes per seconde.
+//
+// Net als sim.cpp gebruikt dit bestand geen Windows functies. Lezen en schrijven van het bestand
+// doet de aanroeper.
+#define RECORDING_MAGIC 0x31434552 // "REC1"
+#define RECORDING_VERSION 2
+#define RECORDING_CHECKPOINT_TICKS SIM_TICKS_PER_SECOND
+// De stick van een controller geeft movement in stappen van 1/32767, zie process_gamepad_input.
+#define RECORDING_MOVEMENT_SCALE 32767.0f
+
+enum {
+    RECORDING_INPUT = 0,
+    RECORDING_CHECKPOINT = 1,
+};
+
+// De flags van een RECORDING_INPUT event.
+enum {
+    RECORDING_JUMP = shift(0),
+    RECORDING_SPACE = shift(1),
+    RECORDING_MOVEMENT = shift(2),
+    RECORDING_MOVEMENT_RAW = shift(3),
+};
+
+struct Recording_Header {
+    u32 magic;
+    u32 version;
+    // Welk level van het spel dit is.
+    u32 level;
+    u32 ticks_per_second;
+    // Hoeveel ticks de poging duurde, daarna is het level voorbij of gestopt.
+    u32 tick_count;
+    // hash_level_layout van het level bestand, zodat we een opname niet op een ander level
+    // afspelen.
+    u32 level_hash;
+    // Hoeveel bytes aan events er na de header komen.
+    u64 data_size;
+};
+
+struct Recorder {
+    u8 *buffer;
+    u64 capacity;
+    u64 size;
+    // Als de buffer vol was, klopt de opname niet meer.
+    bool overflow;
+
+    u32 event_tick;
+    Sim_Input input;
+    i32 movement_steps;
+};
+
+struct Playback {
+    Recording_Header *header;
+    u8 *data;
+    u8 *end;
+    // Als een event niet klopt stoppen we.
+    bool broken;
+
+    // Het volgende event, dat we al gelezen hebben maar nog niet gedaan.
+    u32 event_tick;
+    u32 event_type;
+    bool has_event;
+
+    Sim_Input input;
+    i32 movement_steps;
+
+    u32 checkpoints;
+    u32 mismatches;
+    // De tick van de eerste checkpoint die niet klopte.
+    u32 first_mismatch;
+};
+
+static void write_recording_bytes(Recorder *recorder, const void *bytes, u32 size) {
+    if (recorder->size + size > recorder->capacity) {
+        recorder->overflow = true;
+        return;
+    }
+    memcpy(recorder->buffer + recorder->size, bytes, size);
+    recorder->size += size;
+}
+
+static void write_varint(Recorder *recorder, u64 value) {
+    u8 bytes[10];
+    u32 size = 0;
+    while (value >= 0x80) {
+        bytes[size++] = (u8)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = (u8)value;
+    write_recording_bytes(recorder, bytes, size);
+}
+
+static bool read_varint(Playback *playback, u64 *value) {
+    *value = 0;
+    for (u32 shift_bits = 0; shift_bits < 64; shift_bits += 7) {
+        if (playback->data == playback->end) break;
+        u8 byte = *playback->data++;
+        *value |= (u64)(byte & 0x7F) << shift_bits;
+        if (!(byte & 0x80)) return true;
+    }
+    playback->broken = true;
+    return false;
+}
+
+// Zo worden kleine negatieve verschillen ook kleine varints.
+static u32 zigzag_encode(i32 value) {
+    return ((u32)value << 1) ^ (u32)(value >> 31);
+}
+
+static i32 zigzag_decode(u32 value) {
+    return (i32)(value >> 1) ^ -(i32)(value & 1);
+}
+
+// Movement in stappen van 1/RECORDING_MOVEMENT_SCALE. Geeft false terug als movement daar niet
+// precies in past, dan gaan we verder vanaf de stap die er het dichtst bij ligt (of 0).
+static bool get_movement_steps(f32 movement, i32 *steps) {
+    *steps = 0;
+    f32 scaled = movement * RECORDING_MOVEMENT_SCALE;
+    if (!(scaled > -1000000.0f) || !(scaled < 1000000.0f)) return false;
+
+    *steps = (i32)(scaled + ((scaled < 0.0f) ? -0.5f : 0.5f));
+    f32 decoded = (f32)*steps / RECORDING_MOVEMENT_SCALE;
+    return memcmp(&decoded, &movement, sizeof(f32)) == 0;
+}
+
+// Begin een nieuwe opname in buffer. De header schrijft finish_recording.
+static void begin_recording(Recorder *recorder, u8 *buffer, u64 capacity) {
+    *recorder = {};
+    recorder->buffer = buffer;
+    recorder->capacity = capacity;
+    recorder->size = sizeof(Recording_Header);
+    recorder->overflow = capacity < sizeof(Recording_Header);
+}
+
+static void write_recording_event(Recorder *recorder, u32 tick, u32 type) {
+    write_varint(recorder, ((u64)(tick - recorder->event_tick) << 1) | type);
+    recorder->event_tick = tick;
+}
+
+static void write_recording_checkpoint(Recorder *recorder, Level_Sim *sim) {
+    write_recording_event(recorder, sim->tick, RECORDING_CHECKPOINT);
+    u64 hash = hash_level_sim(sim);
+    write_recording_bytes(recorder, &hash, sizeof(hash));
+}
+
+// Roep dit aan voor elke simulate_tick, met de input van die tick.
+static void record_tick(Recorder *recorder, Level_Sim *sim, Sim_Input *input) {
+    if ((sim->tick > 0) && (sim->tick % RECORDING_CHECKPOINT_TICKS == 0)) {
+        write_recording_checkpoint(recorder, sim);
+    }
+
+    bool movement_changed =
+        memcmp(&input->movement, &recorder->input.movement, sizeof(f32)) != 0;
+    if ((sim->tick > 0) && !movement_changed && (input->jump == recorder->input.jump) &&
+        (input->space == recorder->input.space)) {
+        return;
+    }
+
+    u8 flags = 0;
+    if (input->jump) flags |= RECORDING_JUMP;
+    if (input->space) flags |= RECORDING_SPACE;
+
+    i32 steps = 0;
+    bool fits = get_movement_steps(input->movement, &steps);
+    if (movement_changed) flags |= fits ? RECORDING_MOVEMENT : RECORDING_MOVEMENT_RAW;
+
+    write_recording_event(recorder, sim->tick, RECORDING_INPUT);
+    write_recording_bytes(recorder, &flags, 1);
+    if (flags & RECORDING_MOVEMENT) {
+        write_varint(recorder, zigzag_encode(steps - recorder->movement_steps));
+    } else if (flags & RECORDING_MOVEMENT_RAW) {
+        write_recording_bytes(recorder, &input->movement, sizeof(f32));
+    }
+    if (movement_changed) recorder->movement_steps = steps;
+    recorder->input = *input;
+}
+
+// Sluit de opname af na de laatste tick, en geef de grootte van het hele bestand terug (of 0 als
+// de buffer te klein was).
+static u64 finish_recording(Recorder *recorder, Level_Sim *sim, u32 level) {
+    write_recording_checkpoint(recorder, sim);
+    if (recorder->overflow) return 0;
+
+    Recording_Header *header = (Recording_Header *)recorder->buffer;
+    memset(header, 0, sizeof(*header));
+    header->magic = RECORDING_MAGIC;
+    header->version = RECORDING_VERSION;
+    header->level = level;
+    header->ticks_per_second = SIM_TICKS_PER_SECOND;
+    header->tick_count = sim->tick;
+    header->level_hash = sim->map->level ? hash_level_layout(sim->map->level) : 0;
+    header->data_size = recorder->size - sizeof(Recording_Header);
+    return recorder->size;
+}
+
+static void read_playback_event(Playback *playback) {
+    playback->has_event = false;
+    if (playback->broken || (playback->data == playback->end)) return;
+
+    u64 value;
+    if (!read_varint(playback, &value)) return;
+    playback->event_tick += (u32)(value >> 1);
+    playback->event_type = (u32)(value & 1);
+    playback->has_event = true;
+}
+
+// Controleer of memory een opname is en begin bij de eerste tick. Het geheugen moet blijven
+// bestaan zolang we afspelen.
+static bool begin_playback(Playback *playback, void *memory, u64 size) {
+    *playback = {};
+    Recording_Header *header = (Recording_Header *)memory;
+    if (!memory || (size < sizeof(Recording_Header)) || (header->magic != RECORDING_MAGIC) ||
+        (header->version != RECORDING_VERSION) ||
+        (header->ticks_per_second != SIM_TICKS_PER_SECOND) ||
+        (header->data_size != size - sizeof(Recording_Header))) {
+        return false;
+    }
+
+    playback->header = header;
+    playback->data = (u8 *)(header + 1);
+    playback->end = playback->data + header->data_size;
+    read_playback_event(playback);
+    return true;
+}
+
+// Is de opname gemaakt op dit level bestand?
+static bool is_recording_of_level(Playback *playback, Tile_Map *map) {
+    return map->level && (playback->header->level_hash == hash_level_layout(map->level));
+}
+
+// Doe de events tot en met de tick waar sim nu is: controleer de checkpoints en lees de input.
+// Geeft false terug als de opname voorbij is, anders staat de input voor deze tick in input.
+static bool play_tick(Playback *playback, Level_Sim *sim, Sim_Input *input) {
+    while (playback->has_event && (playback->event_tick <= sim->tick)) {
+        if (playback->event_type == RECORDING_CHECKPOINT) {
+            u64 hash;
+            if (playback->end - playback->data < (i64)sizeof(hash)) {
+                playback->broken = true;
+                break;
+            }
+            memcpy(&hash, playback->data, sizeof(hash));
+            playback->data += sizeof(hash);
+
+            playback->checkpoints++;
+            if ((playback->event_tick != sim->tick) || (hash != hash_level_sim(sim))) {
+                if (playback->mismatches == 0) playback->first_mismatch = playback->event_tick;
+                playback->mismatches++;
+            }
+        } else {
+            if (playback->data == playback->end) {
+                playback->broken = true;
+                break;
+            }
+            u8 flags = *playback->data++;
+            playback->input.jump = (flags & RECORDING_JUMP) != 0;
+            playback->input.space = (flags & RECORDING_SPACE) != 0;
+
+            if (flags & RECORDING_MOVEMENT) {
+                u64 value;
+                if (!read_varint(playback, &value)) break;
+                playback->movement_steps += zigzag_decode((u32)value);
+                playback->input.movement =
+                    (f32)playback->movement_steps / RECORDING_MOVEMENT_SCALE;
+            } else if (flags & RECORDING_MOVEMENT_RAW) {
+                if (playback->end - playback->data < (i64)sizeof(f32)) {
+                    playback->broken = true;
+                    break;
+                }
+                memcpy(&playback->input.movement, playback->data, sizeof(f32));
+                playback->data += sizeof(f32);
+                get_movement_steps(playback->input.movement, &playback->movement_steps);
+            }
+        }
+        read_playback_event(playback);
+    }
+
+    *input = playback->input;
+    return !playback->broken && (sim->tick < playback->header->tick_count);
+}
+
+// Klopte de hele opname: alle checkpoints gelijk en de laatste na precies tick_count ticks?
+static bool finish_playback(Playback *playback, Level_Sim *sim) {
+    Sim_Input input;
+    play_tick(playback, sim, &input);
+    return !playback->broken && (playback->mismatches == 0) &&
+           (sim->tick == playback->header->tick_count);
+}
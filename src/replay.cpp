@@ -0,0 +1,545 @@
+// De replay runner speelt input van een level af zonder venster, geluid of Windows, met de
+// simulatie uit sim.cpp. Hij verdeelt de pogingen over alle cores en doet de ticks zo snel als
+// het kan, zodat je duizenden pogingen per seconde afspeelt. Daarmee kun je zien hoe snel de
+// natuurkunde is, en met de hashes controleren dat een verandering aan de botsingen niks aan het
+// spel verandert. Draai hem vanuit de map van het spel:
+//     replay levels\1.lvl opname.rec [opname.rec ...]
+//                                   speel de opnames (zie recording.cpp) af op het level, en
+//                                   controleer hun checkpoints
+//     replay -random 10000 levels\1.lvl
+//                                   speel 10000 pogingen met willekeurige input, met elke keer
+//                                   dezelfde seeds
+// Met -threads 4 gebruik je zoveel threads (standaard een per core), met -ticks 7200 stopt een
+// poging na zoveel ticks (standaard een minuut). Met -write opnames\random schrijf je de
+// willekeurige pogingen als opnames\random1.rec en verder. Een level bestand maak je met
+// packer -levels, een opname met pilot -record. De opnames in levels\opnames, die de levels test
+// in tests.cpp afspeelt, zijn de vier langste pogingen per level van -random 64 -write.
+//
+// Bouwen op Windows gaat met build.bat, op Linux met:
+//     g++ -O2 -pthread -o replay src/replay.cpp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <immintrin.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define i8 char
+#define i16 short
+#define i32 int
+#define i64 long long
+
+#define u8 unsigned char
+#define u16 unsigned short
+#define u32 unsigned int
+#define u64 unsigned long long
+
+#define f32 float
+#define f64 double
+
+#define shift(x) 1 << (x)
+
+#define minimum(A, B) ((A < B) ? (A) : (B))
+#define maximum(A, B) ((A > B) ? (A) : (B))
+
+#include "math.cpp"
+#include "cpu.cpp"
+#include "level.cpp"
+#include "walls.cpp"
+#include "sim.cpp"
+#include "recording.cpp"
+
+#define MAX_REPLAY_THREADS 64
+#define MAX_REPLAY_FILES 256
+#define REPLAY_PATH_SIZE 512
+// Zoveel chunks mag een poging veranderen. Een poging pakt hooguit een munt, dus dit is ruim.
+#define REPLAY_WRITABLE_CHUNKS 8
+// Zo groot mag een opname van -write worden.
+#define REPLAY_RECORDING_SIZE (1024 * 1024)
+
+// Alle chunks van het level, een keer uitgepakt. Die delen alle threads, en niemand schrijft erin.
+struct Replay_Level {
+    Tile_Map map;
+    Level_Chunk *chunks;
+};
+
+struct Replay_File {
+    const char *filename;
+    u8 *memory;
+    u64 size;
+};
+
+enum Replay_Outcome {
+    OUTCOME_TIMEOUT,
+    OUTCOME_COMPLETED,
+    OUTCOME_FAILED,
+};
+
+struct Replay_Result {
+    u32 outcome;
+    u32 ticks;
+    u32 coins;
+    u64 hash;
+
+    // Alleen bij opnames.
+    bool verified;
+    u32 checkpoints;
+    u32 first_mismatch;
+};
+
+struct Replay_Farm {
+    Replay_Level *level;
+    Replay_File files[MAX_REPLAY_FILES];
+    u32 file_count;
+    // Zonder opnames spelen we zoveel pogingen met willekeurige input.
+    u32 random_count;
+    u32 max_ticks;
+    // Met -write schrijven we de willekeurige pogingen als opnames.
+    const char *write_prefix;
+    // Het level van het spel voor in die opnames, zie get_game_level.
+    u32 game_level;
+
+    u32 attempt_count;
+    Replay_Result *results;
+    volatile long next_attempt;
+};
+
+// NOTE: Uitleg chunks van een worker.
+// Een poging pakt een munt, en dan verandert set_tile een chunk. Omdat de chunks van Replay_Level
+// gedeeld zijn, heeft elke worker een eigen Tile_Map met een eigen lijst chunk pointers. Wil een
+// poging een chunk veranderen, dan kopieert get_writable_level_chunk hem naar een van de writable
+// chunks van de worker en wijst de lijst daarheen. Aan chunk->map zie je van wie een chunk is. Na
+// de poging wijzen we de lijst weer naar de gedeelde chunks.
+struct Replay_Worker {
+    // Dit moet vooraan staan, get_writable_level_chunk komt via de map bij de worker.
+    Tile_Map map;
+    Replay_Farm *farm;
+
+    Level_Chunk writable[REPLAY_WRITABLE_CHUNKS];
+    u32 writable_count;
+    // Pogingen die meer chunks wilden veranderen dan er zijn, die kloppen niet.
+    u32 overflows;
+
+    u64 ticks;
+    // De buffer voor -write, anders 0.
+    u8 *recording;
+};
+
+static Level_Chunk *get_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y) {
+    return map->chunks[chunk_y * map->chunks_x + chunk_x];
+}
+
+static Level_Chunk *get_writable_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y) {
+    u32 index = (u32)(chunk_y * map->chunks_x + chunk_x);
+    Level_Chunk *chunk = map->chunks[index];
+    if (chunk == &empty_level_chunk) return 0;
+    if (chunk->map == map) return chunk;
+
+    Replay_Worker *worker = (Replay_Worker *)map;
+    if (worker->writable_count == REPLAY_WRITABLE_CHUNKS) {
+        worker->overflows++;
+        return 0;
+    }
+
+    Level_Chunk *copy = worker->writable + worker->writable_count++;
+    memcpy(copy, chunk, sizeof(Level_Chunk));
+    copy->map = map;
+    map->chunks[index] = copy;
+    return copy;
+}
+
+// Zet de chunks die de vorige poging veranderd heeft terug.
+static void reset_worker_chunks(Replay_Worker *worker) {
+    Replay_Level *level = worker->farm->level;
+    for (u32 i = 0; i < worker->writable_count; i++) {
+        u32 index = worker->writable[i].index;
+        worker->map.chunks[index] = level->map.chunks[index];
+    }
+    worker->writable_count = 0;
+}
+
+// Lees een heel bestand. De naam mag backslashes hebben, die maken we op Linux weer slashes.
+static u8 *read_entire_file(const char *name, u64 *size) {
+    char path[REPLAY_PATH_SIZE];
+    snprintf(path, REPLAY_PATH_SIZE, "%s", name);
+#ifndef _WIN32
+    for (char *c = path; *c; c++) {
+        if (*c == '\\') *c = '/';
+    }
+#endif
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return 0;
+
+    fseek(file, 0, SEEK_END);
+    *size = (u64)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8 *memory = (u8 *)malloc(*size ? *size : 1);
+    if (fread(memory, 1, *size, file) != *size) {
+        free(memory);
+        memory = 0;
+    }
+    fclose(file);
+    return memory;
+}
+
+static f64 get_seconds() {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (f64)time.tv_sec + (f64)time.tv_nsec * 1e-9;
+}
+
+// Laad het level en pak alle chunks uit, met dezelfde maten als load_tile_map.
+static bool load_replay_level(const char *filename, Replay_Level *result) {
+    u64 size;
+    u8 *memory = read_entire_file(filename, &size);
+    Level_Header *level = get_level_header(memory, size);
+    if (!level) {
+        fprintf(stderr, "%s is geen geldig level bestand.\n", filename);
+        free(memory);
+        return false;
+    }
+
+    Tile_Map *map = &result->map;
+    *map = {};
+    map->level = level;
+    map->width = (i32)level->width;
+    map->height = (i32)level->height;
+    map->chunks_x = (i32)level->chunks_x;
+    map->chunks_y = (i32)level->chunks_y;
+    map->tile_size = 96;
+    map->start_pos = Vector2f(f32(level->start_x * map->tile_size),
+                              f32(level->start_y * map->tile_size + 40));
+
+    u32 chunk_count = level->chunks_x * level->chunks_y;
+    map->chunks = (Level_Chunk **)malloc(chunk_count * sizeof(Level_Chunk *));
+    result->chunks = (Level_Chunk *)calloc(chunk_count, sizeof(Level_Chunk));
+
+    for (u32 chunk_y = 0; chunk_y < level->chunks_y; chunk_y++) {
+        for (u32 chunk_x = 0; chunk_x < level->chunks_x; chunk_x++) {
+            u32 index = chunk_y * level->chunks_x + chunk_x;
+            if (get_level_chunk_entry(level, chunk_x, chunk_y)->size == 0) {
+                map->chunks[index] = &empty_level_chunk;
+                continue;
+            }
+
+            Level_Chunk *chunk = result->chunks + index;
+            chunk->map = map;
+            chunk->index = index;
+            if (!decode_tile_chunk(level, chunk_x, chunk_y, chunk)) {
+                fprintf(stderr, "Chunk %u,%u van %s is kapot, die blijft leeg.\n", chunk_x,
+                        chunk_y, filename);
+            }
+            map->chunks[index] = chunk;
+        }
+    }
+    return true;
+}
+
+// Laad een opname die op dit level gemaakt moet zijn.
+static bool load_replay_file(const char *filename, Replay_Level *level, Replay_File *result) {
+    u64 size;
+    u8 *memory = read_entire_file(filename, &size);
+    Playback playback;
+    if (!begin_playback(&playback, memory, size)) {
+        fprintf(stderr, "%s is geen geldige opname.\n", filename);
+        free(memory);
+        return false;
+    }
+    if (!is_recording_of_level(&playback, &level->map)) {
+        fprintf(stderr, "%s is opgenomen op level %u, niet op dit level bestand.\n", filename,
+                playback.header->level + 1);
+        free(memory);
+        return false;
+    }
+
+    result->filename = filename;
+    result->memory = memory;
+    result->size = size;
+    return true;
+}
+
+static void write_replay_file(const char *prefix, u32 number, u8 *memory, u64 size) {
+    char path[REPLAY_PATH_SIZE];
+    snprintf(path, REPLAY_PATH_SIZE, "%s%u.rec", prefix, number);
+#ifndef _WIN32
+    for (char *c = path; *c; c++) {
+        if (*c == '\\') *c = '/';
+    }
+#endif
+
+    FILE *file = fopen(path, "wb");
+    if (!file || (fwrite(memory, 1, size, file) != size)) {
+        fprintf(stderr, "Kan %s niet schrijven.\n", path);
+    }
+    if (file) fclose(file);
+}
+
+// Welk level van het spel een level bestand is: levels\3.lvl is het derde level. Bij een andere
+// naam nemen we het eerste, dan speelt pilot -play de opname niet af (zie load_playback).
+static u32 get_game_level(const char *filename) {
+    const char *name = filename;
+    for (const char *c = filename; *c; c++) {
+        if ((*c == '\\') || (*c == '/')) name = c + 1;
+    }
+    int number = atoi(name);
+    return (number > 0) ? (u32)number - 1 : 0;
+}
+
+// Willekeurige input die een beetje op een speler lijkt: een tijdje dezelfde kant op lopen of
+// stilstaan, en af en toe springen, soms met springen ingedrukt.
+struct Random_Input {
+    u32 state;
+    u32 hold_ticks;
+    f32 movement;
+    u32 space_ticks;
+};
+
+static u32 random_next(Random_Input *random) {
+    random->state = random->state * 1664525u + 1013904223u;
+    return random->state >> 8;
+}
+
+static Sim_Input get_random_input(Random_Input *random) {
+    if (random->hold_ticks == 0) {
+        u32 direction = random_next(random) % 4;
+        random->movement = (direction == 0) ? -1.0f : ((direction == 1) ? 0.0f : 1.0f);
+        random->hold_ticks = 10 + random_next(random) % 60;
+    }
+    random->hold_ticks--;
+
+    Sim_Input input = {};
+    input.movement = random->movement;
+    if ((random->space_ticks == 0) && (random_next(random) % 40 == 0)) {
+        input.jump = true;
+        random->space_ticks = random_next(random) % 50;
+    }
+    if (random->space_ticks > 0) {
+        input.space = true;
+        random->space_ticks--;
+    }
+    return input;
+}
+
+static void run_attempt(Replay_Worker *worker, u32 attempt) {
+    Replay_Farm *farm = worker->farm;
+
+    Level_Sim sim = {};
+    sim.player.max_speed = 750.0f;
+    sim.player.width = 31 * 3;
+    sim.player.height = 56 * 3;
+    sim.gravity = 1500.0f;
+    reset_level_sim(&sim, &worker->map);
+
+    Replay_File *file = farm->file_count ? farm->files + attempt : 0;
+    Playback playback;
+    if (file) begin_playback(&playback, file->memory, file->size);
+    Random_Input random = {};
+    random.state = attempt + 1;
+    Recorder recorder;
+    if (worker->recording) begin_recording(&recorder, worker->recording, REPLAY_RECORDING_SIZE);
+
+    Replay_Result result = {};
+    u32 overflows = worker->overflows;
+    for (u32 tick = 0; tick < farm->max_ticks; tick++) {
+        Sim_Input input;
+        if (file) {
+            if (!play_tick(&playback, &sim, &input)) break;
+        } else {
+            input = get_random_input(&random);
+            if (worker->recording) record_tick(&recorder, &sim, &input);
+        }
+
+        u32 events = simulate_tick(&sim, &input);
+        if (events & SIM_COIN) result.coins++;
+        if (events & SIM_COMPLETED) result.outcome = OUTCOME_COMPLETED;
+        if (events & SIM_FAILED) result.outcome = OUTCOME_FAILED;
+        if (result.outcome != OUTCOME_TIMEOUT) break;
+    }
+
+    result.ticks = sim.tick;
+    result.hash = hash_level_sim(&sim);
+    if (file) {
+        result.verified = finish_playback(&playback, &sim);
+        result.checkpoints = playback.checkpoints;
+        result.first_mismatch = playback.first_mismatch;
+    } else if (worker->recording) {
+        u64 size = finish_recording(&recorder, &sim, farm->game_level);
+        if (size) write_replay_file(farm->write_prefix, attempt + 1, worker->recording, size);
+    }
+    farm->results[attempt] = result;
+    worker->ticks += sim.tick;
+
+    if (worker->overflows != overflows) {
+        fprintf(stderr, "Poging %u veranderde meer dan %u chunks, die klopt niet.\n", attempt,
+                REPLAY_WRITABLE_CHUNKS);
+    }
+    reset_worker_chunks(worker);
+}
+
+// Net als job_thread_proc: pak de volgende poging tot ze op zijn.
+#ifdef _WIN32
+static DWORD WINAPI replay_thread_proc(LPVOID parameter) {
+#else
+static void *replay_thread_proc(void *parameter) {
+#endif
+    Replay_Worker *worker = (Replay_Worker *)parameter;
+    Replay_Farm *farm = worker->farm;
+
+    for (;;) {
+#ifdef _WIN32
+        u32 attempt = (u32)InterlockedIncrement(&farm->next_attempt) - 1;
+#else
+        u32 attempt = (u32)__atomic_add_fetch(&farm->next_attempt, 1, __ATOMIC_RELAXED) - 1;
+#endif
+        if (attempt >= farm->attempt_count) break;
+        run_attempt(worker, attempt);
+    }
+    return 0;
+}
+
+static u32 get_core_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (u32)count : 1;
+#endif
+}
+
+static void run_farm(Replay_Worker *workers, u32 thread_count) {
+#ifdef _WIN32
+    HANDLE threads[MAX_REPLAY_THREADS];
+    for (u32 i = 1; i < thread_count; i++) {
+        threads[i] = CreateThread(0, 0, replay_thread_proc, workers + i, 0, 0);
+    }
+    replay_thread_proc(workers);
+    for (u32 i = 1; i < thread_count; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+#else
+    pthread_t threads[MAX_REPLAY_THREADS];
+    for (u32 i = 1; i < thread_count; i++) {
+        pthread_create(threads + i, 0, replay_thread_proc, workers + i);
+    }
+    replay_thread_proc(workers);
+    for (u32 i = 1; i < thread_count; i++) {
+        pthread_join(threads[i], 0);
+    }
+#endif
+}
+
+static const char *outcome_names[] = {"timeout", "gehaald", "af"};
+
+static int run_replays(Replay_Farm *farm, u32 thread_count) {
+    farm->attempt_count = farm->file_count ? farm->file_count : farm->random_count;
+    farm->results = (Replay_Result *)calloc(farm->attempt_count, sizeof(Replay_Result));
+    farm->next_attempt = 0;
+
+    thread_count = minimum(maximum(thread_count, 1u), (u32)MAX_REPLAY_THREADS);
+    thread_count = minimum(thread_count, farm->attempt_count);
+    Replay_Worker *workers = (Replay_Worker *)calloc(thread_count, sizeof(Replay_Worker));
+    u32 chunk_count = (u32)(farm->level->map.chunks_x * farm->level->map.chunks_y);
+    for (u32 i = 0; i < thread_count; i++) {
+        Replay_Worker *worker = workers + i;
+        worker->farm = farm;
+        worker->map = farm->level->map;
+        worker->map.chunks = (Level_Chunk **)malloc(chunk_count * sizeof(Level_Chunk *));
+        memcpy(worker->map.chunks, farm->level->map.chunks, chunk_count * sizeof(Level_Chunk *));
+        if (farm->write_prefix) worker->recording = (u8 *)malloc(REPLAY_RECORDING_SIZE);
+    }
+
+    initialize_wall_solver();
+    f64 start = get_seconds();
+    run_farm(workers, thread_count);
+    f64 seconds = get_seconds() - start;
+
+    u64 ticks = 0;
+    u32 overflows = 0;
+    for (u32 i = 0; i < thread_count; i++) {
+        ticks += workers[i].ticks;
+        overflows += workers[i].overflows;
+    }
+
+    // Alle hashes samen, in de volgorde van de pogingen, zodat je twee runs met een getal kunt
+    // vergelijken, hoeveel threads ze ook hadden.
+    u32 outcomes[3] = {};
+    u32 mismatches = 0;
+    u64 coins = 0;
+    u64 hash = 14695981039346656037ull;
+    for (u32 i = 0; i < farm->attempt_count; i++) {
+        Replay_Result *result = farm->results + i;
+        outcomes[result->outcome]++;
+        coins += result->coins;
+        hash = (hash ^ result->hash) * 1099511628211ull;
+
+        if (farm->file_count) {
+            printf("%s: %s na %u ticks, %u munten, hash %016llx, ", farm->files[i].filename,
+                   outcome_names[result->outcome], result->ticks, result->coins, result->hash);
+            if (result->verified) {
+                printf("%u checkpoints kloppen\n", result->checkpoints);
+            } else {
+                printf("KLOPT NIET vanaf tick %u\n", result->first_mismatch);
+                mismatches++;
+            }
+        }
+    }
+
+    printf("%u pogingen met %u threads in %.3fs: %.0f ticks/s, %.0f pogingen/s\n",
+           farm->attempt_count, thread_count, seconds, (f64)ticks / seconds,
+           (f64)farm->attempt_count / seconds);
+    printf("%u gehaald, %u af, %u timeout, %llu munten, hash %016llx\n",
+           outcomes[OUTCOME_COMPLETED], outcomes[OUTCOME_FAILED], outcomes[OUTCOME_TIMEOUT],
+           coins, hash);
+    return (overflows || mismatches) ? 1 : 0;
+}
+
+int main(int argument_count, char **arguments) {
+    static Replay_Farm farm;
+    farm.max_ticks = 60 * SIM_TICKS_PER_SECOND;
+    u32 thread_count = get_core_count();
+    const char *level_filename = 0;
+    const char *replay_filenames[MAX_REPLAY_FILES];
+
+    for (int i = 1; i < argument_count; i++) {
+        if (!strcmp(arguments[i], "-random") && (i + 1 < argument_count)) {
+            farm.random_count = (u32)atoi(arguments[++i]);
+        } else if (!strcmp(arguments[i], "-threads") && (i + 1 < argument_count)) {
+            thread_count = (u32)atoi(arguments[++i]);
+        } else if (!strcmp(arguments[i], "-ticks") && (i + 1 < argument_count)) {
+            farm.max_ticks = (u32)atoi(arguments[++i]);
+        } else if (!strcmp(arguments[i], "-write") && (i + 1 < argument_count)) {
+            farm.write_prefix = arguments[++i];
+        } else if (!level_filename) {
+            level_filename = arguments[i];
+        } else if (farm.file_count < MAX_REPLAY_FILES) {
+            replay_filenames[farm.file_count++] = arguments[i];
+        }
+    }
+
+    if (!level_filename || (!farm.file_count && !farm.random_count)) {
+        fprintf(stderr, "Gebruik: replay levels\\1.lvl opname.rec [opname.rec ...]\n"
+                        "         replay -random 10000 levels\\1.lvl\n");
+        return 1;
+    }
+
+    static Replay_Level level;
+    if (!load_replay_level(level_filename, &level)) return 1;
+    farm.level = &level;
+    farm.game_level = get_game_level(level_filename);
+    for (u32 i = 0; i < farm.file_count; i++) {
+        if (!load_replay_file(replay_filenames[i], &level, farm.files + i)) return 1;
+    }
+    return run_replays(&farm, thread_count);
+}
@@ -0,0 +1,653 @@
+// NOTE: Uitleg simulatie.
+// Alles wat je nodig hebt om een level te spelen, zonder venster, geluid of Windows: de tiles van
+// de map, de botsingen en een tick van de speler. Het spel gebruikt dit in simulate_level, en de
+// replay runner (zie replay.cpp) speelt er opnames mee af, ook op Linux. Net als level.cpp
+// gebruikt dit bestand daarom alleen vaste types en geen Windows functies.
+//
+// Hoe de chunks van een map in het geheugen komen, bepaalt wie dit bestand gebruikt. Die maakt
+// get_level_chunk en get_writable_level_chunk: het spel met de level streamer (zie tile_map.cpp),
+// de replay runner pakt alle chunks van tevoren uit.
+
+// NOTE: Uitleg tile opslag.
+// Een map bestaat uit level chunks van LEVEL_CHUNK_TILES bij LEVEL_CHUNK_TILES tiles (zie
+// level.cpp). Het spel heeft alleen de chunks rond de speler in het geheugen, zie de level streamer
+// in tile_map.cpp. Een chunk zonder tiles wijst naar empty_level_chunk.
+//
+// Een tile is een van de *_TILE flags, en die passen allemaal in een u8. Binnen een chunk slaan we
+// de tiles op in blokken van TILE_BLOCK bij TILE_BLOCK, zodat de tiles die in de wereld dicht bij
+// elkaar liggen ook in het geheugen bij elkaar staan, ook als ze in verschillende rijen zitten.
+// Gebruik daarom altijd get_tile en set_tile, en nooit zelf een index in tiles.
+//
+// Daarnaast heeft elke chunk per rij drie bitsets, met een bit per tile:
+// - solid: tiles waar je tegenaan botst (de grond).
+// - hazard: tiles waar je dood aan gaat (de dood tiles en de spikes).
+// - pickup: tiles die iets doen als je ze raakt, maar waar je niet tegen botst (munten en de deur).
+// Een chunk is precies 64 tiles breed, dus dat is een u64 per rij. Zo kunnen de botsingen en het
+// tekenen van de chunks met een paar u64's zien welke tiles in een rij iets zijn, in plaats van
+// elke tile los te bekijken.
+#define TILE_BLOCK 8
+#define TILE_BLOCK_SHIFT 3
+
+// Welke bitsets get_tile_row_bits gebruikt.
+#define TILE_BITS_SOLID 1
+#define TILE_BITS_HAZARD 2
+#define TILE_BITS_PICKUP 4
+#define TILE_BITS_ALL (TILE_BITS_SOLID | TILE_BITS_HAZARD | TILE_BITS_PICKUP)
+
+struct Tile_Map;
+struct Tile_Sprites;
+
+struct Level_Chunk {
+    u8 tiles[LEVEL_CHUNK_TILES * LEVEL_CHUNK_TILES];
+    u64 solid[LEVEL_CHUNK_TILES];
+    u64 hazard[LEVEL_CHUNK_TILES];
+    u64 pickup[LEVEL_CHUNK_TILES];
+
+    // Van welke map en welke chunk daarin dit is.
+    Tile_Map *map;
+    u32 index;
+    // Voor de level streamer, een Level_Chunk_State. Een long, net als LONG, zodat de Interlocked
+    // functies van Windows er ook op werken.
+    volatile long state;
+    u32 last_used;
+};
+
+// Een tile die set_tile veranderd heeft, zoals een opgepakte munt. x en y zijn binnen de chunk.
+struct Tile_Change {
+    u32 chunk_index;
+    u8 x, y;
+    u8 tile;
+};
+
+struct Tile_Map {
+    i32 width, height, tile_size;
+    i32 chunks_x, chunks_y;
+    // Voor elke chunk van de map de chunk in het geheugen, of 0 als hij er (nog) niet is.
+    Level_Chunk **chunks;
+    Level_Header *level;
+    // De HANDLEs van het gemapte .lvl bestand. Als we het ontwerp zelf hebben omgezet, staat level
+    // in de level arena en zijn deze 0. De replay runner gebruikt ze niet.
+    void *file;
+    void *mapping;
+    // Alleen voor het tekenen, zie tile_map.cpp.
+    Tile_Sprites *sprites;
+    Vector2f start_pos;
+    // Alleen in het spel: wat set_tile veranderd heeft, zodat de level streamer een chunk weg kan
+    // doen en de veranderingen terugzet als hij hem opnieuw uitpakt. De replay runner en de tests
+    // houden alle chunks in het geheugen, daar is dit 0.
+    Tile_Change *changes;
+    u32 change_count;
+    u32 max_changes;
+};
+
+static Level_Chunk empty_level_chunk;
+
+// Geeft chunk (chunk_x, chunk_y) van de map, altijd met de tiles erin.
+static Level_Chunk *get_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y);
+// Hetzelfde, maar dan een chunk waarin we tiles gaan veranderen. Geeft 0 terug als dat niet kan
+// (bij een chunk zonder tiles).
+static Level_Chunk *get_writable_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y);
+
+static u32 get_chunk_tile_index(i32 x, i32 y) {
+    u32 block = (u32)((y >> TILE_BLOCK_SHIFT) * (LEVEL_CHUNK_TILES / TILE_BLOCK) +
+                      (x >> TILE_BLOCK_SHIFT));
+    return (block << (2 * TILE_BLOCK_SHIFT)) + ((y & (TILE_BLOCK - 1)) << TILE_BLOCK_SHIFT) +
+           (x & (TILE_BLOCK - 1));
+}
+
+// Zet een tile in een chunk en houd de bitsets bij. x en y zijn binnen de chunk.
+static void set_chunk_tile(Level_Chunk *chunk, i32 x, i32 y, u8 tile) {
+    chunk->tiles[get_chunk_tile_index(x, y)] = tile;
+
+    u64 bit = 1ull << x;
+    chunk->solid[y] &= ~bit;
+    chunk->hazard[y] &= ~bit;
+    chunk->pickup[y] &= ~bit;
+
+    if (tile == GROUND_TILE) {
+        chunk->solid[y] |= bit;
+    } else if ((tile == DEATH_TILE) || (tile == SPIKES_TILE)) {
+        chunk->hazard[y] |= bit;
+    } else if ((tile == COIN_TILE) || (tile == END_TILE)) {
+        chunk->pickup[y] |= bit;
+    }
+}
+
+// Pak chunk (chunk_x, chunk_y) uit het level bestand uit. Geeft false terug als de data niet klopt,
+// dan blijft de chunk leeg.
+static bool decode_tile_chunk(Level_Header *level, u32 chunk_x, u32 chunk_y, Level_Chunk *chunk) {
+    Level_Chunk_Entry *entry = get_level_chunk_entry(level, chunk_x, chunk_y);
+
+    u8 tiles[LEVEL_CHUNK_TILES * LEVEL_CHUNK_TILES];
+    bool result = decode_level_chunk(level, entry, tiles);
+    if (!result) memset(tiles, 0, sizeof(tiles));
+
+    memset(chunk->solid, 0, sizeof(chunk->solid));
+    memset(chunk->hazard, 0, sizeof(chunk->hazard));
+    memset(chunk->pickup, 0, sizeof(chunk->pickup));
+    u8 *tile = tiles;
+    for (i32 y = 0; y < LEVEL_CHUNK_TILES; y++) {
+        for (i32 x = 0; x < LEVEL_CHUNK_TILES; x++) {
+            set_chunk_tile(chunk, x, y, *tile++);
+        }
+    }
+    return result;
+}
+
+static u8 get_tile(Tile_Map *tile_map, i32 x, i32 y) {
+    Level_Chunk *chunk =
+        get_level_chunk(tile_map, x >> LEVEL_CHUNK_SHIFT, y >> LEVEL_CHUNK_SHIFT);
+    return chunk->tiles[get_chunk_tile_index(x & (LEVEL_CHUNK_TILES - 1),
+                                             y & (LEVEL_CHUNK_TILES - 1))];
+}
+
+// Verander een tile. Dit kan alleen in een chunk waar al tiles in staan, zoals bij het oppakken
+// en terugleggen van een munt.
+static void set_tile(Tile_Map *tile_map, i32 x, i32 y, u8 tile) {
+    Level_Chunk *chunk =
+        get_writable_level_chunk(tile_map, x >> LEVEL_CHUNK_SHIFT, y >> LEVEL_CHUNK_SHIFT);
+    if (!chunk) return;
+
+    i32 chunk_x = x & (LEVEL_CHUNK_TILES - 1);
+    i32 chunk_y = y & (LEVEL_CHUNK_TILES - 1);
+    set_chunk_tile(chunk, chunk_x, chunk_y, tile);
+
+    if (!tile_map->changes) return;
+    Tile_Change *change = 0;
+    for (u32 i = 0; i < tile_map->change_count; i++) {
+        Tile_Change *other = tile_map->changes + i;
+        if ((other->chunk_index == chunk->index) && (other->x == chunk_x) &&
+            (other->y == chunk_y)) {
+            change = other;
+            break;
+        }
+    }
+    if (!change) {
+        // Vol kan alleen bij een level met meer dan max_changes munten. Dan komen de munten die
+        // we niet meer kunnen onthouden terug als hun chunk weg is geweest.
+        if (tile_map->change_count == tile_map->max_changes) return;
+        change = tile_map->changes + tile_map->change_count++;
+        change->chunk_index = chunk->index;
+        change->x = (u8)chunk_x;
+        change->y = (u8)chunk_y;
+    }
+    change->tile = tile;
+}
+
+// Zet wat set_tile in deze chunk veranderd had terug, na het opnieuw uitpakken.
+static void apply_tile_changes(Tile_Map *tile_map, Level_Chunk *chunk) {
+    for (u32 i = 0; i < tile_map->change_count; i++) {
+        Tile_Change *change = tile_map->changes + i;
+        if (change->chunk_index == chunk->index) {
+            set_chunk_tile(chunk, change->x, change->y, change->tile);
+        }
+    }
+}
+
+// Geeft de bits van de tiles in rij row van de chunk terug die in een van de bitsets uit sets
+// (TILE_BITS_*) staan, alleen van first tot en met last (binnen de chunk, first <= last).
+static u64 get_chunk_row_bits(Level_Chunk *chunk, i32 row, i32 first, i32 last, u32 sets) {
+    u64 bits = 0;
+    if (sets & TILE_BITS_SOLID) bits |= chunk->solid[row];
+    if (sets & TILE_BITS_HAZARD) bits |= chunk->hazard[row];
+    if (sets & TILE_BITS_PICKUP) bits |= chunk->pickup[row];
+
+    if (first > 0) bits &= ~0ull << first;
+    if (last < 63) bits &= ~(~0ull << (last + 1));
+    return bits;
+}
+
+// Hetzelfde voor rij y van de map, voor het stuk van de rij in word (x van word * 64 tot
+// word * 64 + 63, dat is precies een chunk), en alleen tussen min_x en max_x.
+static u64 get_tile_row_bits(Tile_Map *tile_map, i32 y, i32 word, i32 min_x, i32 max_x,
+                             u32 sets = TILE_BITS_ALL) {
+    i32 first = min_x - word * 64;
+    i32 last = max_x - word * 64;
+    if (first > last) return 0;
+
+    Level_Chunk *chunk = get_level_chunk(tile_map, word, y >> LEVEL_CHUNK_SHIFT);
+    return get_chunk_row_bits(chunk, y & (LEVEL_CHUNK_TILES - 1), first, last, sets);
+}
+
+// Het deel van de speler dat meedoet aan de natuurkunde. De animaties horen bij het spel.
+struct Player_Body {
+    f32 width, height;
+
+    Vector2f position;
+    Vector2f velocity;
+    Vector2f acceleration;
+    f32 max_speed;
+};
+
+struct Collision {
+    i32 coin_index;
+    i32 tile;
+    bool on_ground;
+};
+
+// Bij wie de muren in een Wall_Batch horen, een Wall_Owner per vier muren.
+struct Wall_Owner {
+    i32 tile_x;
+    i32 tile_y;
+    u8 tile;
+};
+
+// Zet de vier muren van een tile in de batch: links, rechts, onder en boven.
+static void push_tile_walls(Wall_Batch *batch, Wall_Owner *owners, i32 tile_x, i32 tile_y, u8 tile,
+                            Vector2f min_corner, Vector2f max_corner, Vector2f rel_pos,
+                            Vector2f delta_pos) {
+    owners[batch->count / 4] = {tile_x, tile_y, tile};
+    push_wall(batch, min_corner.x, min_corner.y, max_corner.y, rel_pos.x, rel_pos.y, delta_pos.x,
+              delta_pos.y);
+    push_wall(batch, max_corner.x, min_corner.y, max_corner.y, rel_pos.x, rel_pos.y, delta_pos.x,
+              delta_pos.y);
+    push_wall(batch, min_corner.y, min_corner.x, max_corner.x, rel_pos.y, rel_pos.x, delta_pos.y,
+              delta_pos.x);
+    push_wall(batch, max_corner.y, min_corner.x, max_corner.x, rel_pos.y, rel_pos.x, delta_pos.y,
+              delta_pos.x);
+}
+
+// Reken de muren in de batch uit en ga ze in volgorde langs, zodat t_lowest, normal en result
+// precies zo uitkomen als toen we elke muur los testten. Daarna is de batch weer leeg.
+static void resolve_walls(Tile_Map *tile_map, Wall_Batch *batch, Wall_Owner *owners,
+                          f32 *t_lowest, Vector2f *normal, Collision *result) {
+    f32 t_epsilon = 0.01f;
+    Vector2f normals[4] = {Vector2f(-1.0f, 0.0f), Vector2f(1.0f, 0.0f), Vector2f(0.0f, -1.0f),
+                           Vector2f(0.0f, 1.0f)};
+
+    solve_walls(batch);
+
+    for (u32 i = 0; i < batch->count; i += 4) {
+        Wall_Owner *owner = owners + i / 4;
+        for (u32 wall = 0; wall < 4; wall++) {
+            // We willen alleen de dichstbijzijnde botsing, dus slaan we telkens de laagste tijd
+            // op.
+            f32 t = batch->t[i + wall];
+            if (t >= *t_lowest) continue;
+            *t_lowest = maximum(0.0f, t - t_epsilon);
+
+            result->tile |= owner->tile;
+            if (owner->tile == GROUND_TILE) {
+                *normal = normals[wall];
+                if (wall == 3) result->on_ground = true;
+                continue;
+            }
+
+            // Van een andere tile telt alleen de eerste muur die geraakt wordt.
+            if (owner->tile == COIN_TILE) {
+                set_tile(tile_map, owner->tile_x, owner->tile_y, EMPTY_TILE);
+                result->coin_index = owner->tile_y * tile_map->width + owner->tile_x;
+            }
+            break;
+        }
+    }
+    batch->count = 0;
+}
+
+// NOTE: Uitleg broadphase.
+// update_player_position kijkt naar alle tiles in een vak om de oude en nieuwe plek van de speler.
+// Bij een snelle val is dat vak groot, terwijl het midden van de speler maar door een smalle
+// strook gaat. Een tile kan alleen geraakt worden als het midden binnen het vergrote vak van de
+// tile komt (de tile plus de helft van de speler aan elke kant, zie min_corner en max_corner).
+// Daarom slaan we de rijen en kolommen over waar het midden in deze iteratie niet in de buurt
+// komt. Gaat de speler schuin over meerdere tiles, dan rekenen we ook per rij uit in welke tijd
+// (tot t_lowest) het midden in de rij is, en welke kolommen het in die tijd langs gaat.
+//
+// De volgorde blijft rij voor rij, dus er komt precies hetzelfde uit als zonder overslaan: wat we
+// overslaan was toch niet geraakt. SWEEP_MARGIN houdt rekening met afrondingen.
+//
+// Dat er echt hetzelfde uitkomt, en hoeveel het scheelt bij hoge snelheden, laat de sweep test in
+// tests.cpp zien. Die zet use_sweep_broadphase uit om met alle tiles in het vak te vergelijken.
+#define SWEEP_MARGIN 1.0f
+
+static bool use_sweep_broadphase = true;
+
+// De beweging van het midden van de speler in een iteratie van update_player_position.
+struct Sweep {
+    Vector2f start;
+    Vector2f delta;
+    // 1 / delta, zodat we niet steeds hoeven te delen. 0 als de speler op die as stilstaat.
+    Vector2f inv_delta;
+};
+
+static Sweep make_sweep(Vector2f start, Vector2f delta) {
+    Sweep sweep;
+    sweep.start = start;
+    sweep.delta = delta;
+    sweep.inv_delta.x = (delta.x != 0.0f) ? 1.0f / delta.x : 0.0f;
+    sweep.inv_delta.y = (delta.y != 0.0f) ? 1.0f / delta.y : 0.0f;
+    return sweep;
+}
+
+// Maak de tijd van t_min tot t_max kleiner tot de tijd waarin start + delta * t tussen min en max
+// ligt. Geeft false terug als dat in die tijd nooit zo is.
+static bool clip_sweep(f32 start, f32 delta, f32 inv_delta, f32 min, f32 max, f32 *t_min,
+                       f32 *t_max) {
+    if (delta == 0.0f) return (start >= min) && (start <= max) && (*t_min <= *t_max);
+
+    f32 t_enter = (min - start) * inv_delta;
+    f32 t_exit = (max - start) * inv_delta;
+    if (t_enter > t_exit) {
+        f32 temp = t_enter;
+        t_enter = t_exit;
+        t_exit = temp;
+    }
+
+    *t_min = maximum(*t_min, t_enter);
+    *t_max = minimum(*t_max, t_exit);
+    return *t_min <= *t_max;
+}
+
+static Collision update_player_position(Tile_Map *tile_map, Player_Body *player,
+                                        f32 delta_time) {
+    Collision result = {};
+
+    Vector2f old_pos = player->position;
+
+    // Maak gebruik van de formules uit Binas Tabel 35.
+    // s = 0.5*a*t^2 + v*t + s
+    Vector2f new_pos = player->acceleration * delta_time * delta_time * .5f +
+                       player->velocity * delta_time + player->position;
+    // v = a*t + v
+    player->velocity = player->acceleration * delta_time + player->velocity;
+
+    Vector2f delta_pos = new_pos - old_pos;
+
+    Vector2f old_tile = Vector2f(old_pos.x, old_pos.y) / (f32)tile_map->tile_size;
+    Vector2f new_tile = Vector2f(new_pos.x, new_pos.y) / (f32)tile_map->tile_size;
+
+    Vector2i min_tile =
+        Vector2i((i32)minimum(old_tile.x, new_tile.x), (i32)minimum(old_tile.y, new_tile.y));
+    Vector2i max_tile =
+        Vector2i((i32)maximum(old_tile.x, new_tile.x), (i32)maximum(old_tile.y, new_tile.y));
+
+    Vector2i player_tile_size = Vector2i((i32)(player->width / (f32)tile_map->tile_size) + 1,
+                                         (i32)(player->height / (f32)tile_map->tile_size) + 1);
+
+    min_tile = min_tile - player_tile_size;
+    max_tile = max_tile + player_tile_size;
+
+    // Alleen de tiles die op de map liggen.
+    i32 min_x = maximum(min_tile.x, 0);
+    i32 min_y = maximum(min_tile.y, 0);
+    i32 max_x = minimum(max_tile.x, tile_map->width - 1);
+    i32 max_y = minimum(max_tile.y, tile_map->height - 1);
+
+    // Dit is zijn de hoeken linksonder en rechtsboven ten opzichte van het midden van de tile.
+    Vector2f diameter = Vector2f((f32)tile_map->tile_size + player->width,
+                                 (f32)tile_map->tile_size + player->height);
+    Vector2f min_corner = diameter * -0.5f;
+    Vector2f max_corner = diameter * 0.5f;
+
+    f32 tile_size = (f32)tile_map->tile_size;
+    f32 inv_tile_size = 1.0f / tile_size;
+    f32 t_remaining = 1.0f;
+
+    // De muren van alle tiles waar de speler tegenaan kan komen, zie de uitleg van de muur kernels.
+    Wall_Batch batch;
+    batch.count = 0;
+    Wall_Owner owners[MAX_BATCH_WALLS / 4];
+
+    // TODO(Kay Verbruggen): Hoe vaak moeten we deze loop uitvoeren.
+    for (i32 i = 0; (i < 4) && (t_remaining > 0.0f); i++) {
+        f32 t_lowest = 1.0f;
+        Vector2f normal = Vector2f();
+
+        // We gaan rij voor rij langs alle tiles die iets zijn, en binnen een rij van links naar
+        // rechts, want wie er eerst geraakt wordt maakt uit voor t_lowest. Met de bitsets van de
+        // chunks slaan we de lege tiles in een rij in een keer over.
+        Sweep sweep = make_sweep(player->position, delta_pos);
+
+        // De tiles waar het midden van de speler in deze iteratie in de buurt komt.
+        Vector2f sweep_min = player->position + Vector2f(minimum(delta_pos.x, 0.0f),
+                                                         minimum(delta_pos.y, 0.0f));
+        Vector2f sweep_max = player->position + Vector2f(maximum(delta_pos.x, 0.0f),
+                                                         maximum(delta_pos.y, 0.0f));
+        i32 sweep_min_x = maximum(
+            ceil_i32((sweep_min.x - max_corner.x - SWEEP_MARGIN) * inv_tile_size), min_x);
+        i32 sweep_max_x = minimum(
+            floor_i32((sweep_max.x - min_corner.x + SWEEP_MARGIN) * inv_tile_size), max_x);
+        i32 first_y = maximum(
+            ceil_i32((sweep_min.y - max_corner.y - SWEEP_MARGIN) * inv_tile_size), min_y);
+        i32 last_y = minimum(
+            floor_i32((sweep_max.y - min_corner.y + SWEEP_MARGIN) * inv_tile_size), max_y);
+
+        // Gaat de speler schuin over meer dan een tile, dan rekenen we ook per rij uit welke
+        // kolommen het midden langs komt. Bij een kleine stap is dat meer werk dan het scheelt.
+        bool narrow_rows = (maximum(delta_pos.x, -delta_pos.x) > tile_size) &&
+                           (maximum(delta_pos.y, -delta_pos.y) > tile_size);
+        if (!use_sweep_broadphase) {
+            sweep_min_x = min_x;
+            sweep_max_x = max_x;
+            first_y = min_y;
+            last_y = max_y;
+            narrow_rows = false;
+        }
+
+        for (i32 tile_y = first_y; tile_y <= last_y; tile_y++) {
+            // De kolommen van deze rij waar het midden van de speler langs komt, zie de uitleg
+            // van de broadphase.
+            i32 row_min_x = sweep_min_x;
+            i32 row_max_x = sweep_max_x;
+            if (narrow_rows) {
+                f32 row_y = (f32)tile_y * tile_size;
+                f32 t_min = 0.0f;
+                f32 t_max = t_lowest;
+                if (!clip_sweep(sweep.start.y, sweep.delta.y, sweep.inv_delta.y,
+                                row_y + min_corner.y - SWEEP_MARGIN,
+                                row_y + max_corner.y + SWEEP_MARGIN, &t_min, &t_max)) {
+                    continue;
+                }
+                f32 x0 = sweep.start.x + sweep.delta.x * t_min;
+                f32 x1 = sweep.start.x + sweep.delta.x * t_max;
+                row_min_x = maximum(
+                    ceil_i32((minimum(x0, x1) - max_corner.x - SWEEP_MARGIN) * inv_tile_size),
+                    row_min_x);
+                row_max_x = minimum(
+                    floor_i32((maximum(x0, x1) - min_corner.x + SWEEP_MARGIN) * inv_tile_size),
+                    row_max_x);
+            }
+
+            for (i32 word = row_min_x / 64; word <= row_max_x / 64; word++) {
+                // Een word kan de muren van 64 tiles geven. Past dat niet meer in de batch, dan
+                // rekenen we eerst uit wat erin zit.
+                if (batch.count > MAX_BATCH_WALLS - 4 * 64) {
+                    resolve_walls(tile_map, &batch, owners, &t_lowest, &normal, &result);
+                }
+
+                u64 bits = get_tile_row_bits(tile_map, tile_y, word, row_min_x, row_max_x);
+                unsigned long bit;
+                while (_BitScanForward64(&bit, bits)) {
+                    bits &= bits - 1;
+                    i32 tile_x = word * 64 + (i32)bit;
+                    u8 tile = get_tile(tile_map, tile_x, tile_y);
+
+                    // Reken het midden van de tile uit, en de positie van de speler ten
+                    // opzichte van dat midden.
+                    Vector2f tile_center =
+                        Vector2f((f32)tile_x, (f32)tile_y) * (f32)tile_map->tile_size;
+                    Vector2f rel_pos = player->position - tile_center;
+
+                    Vector2f temp_max_corner = max_corner;
+                    Vector2f temp_min_corner = min_corner;
+                    if (tile == SPIKES_TILE) {
+                        temp_max_corner.y -= 40;
+
+                        temp_max_corner.x -= 15;
+                        temp_min_corner.x += 15;
+                    }
+
+                    push_tile_walls(&batch, owners, tile_x, tile_y, tile, temp_min_corner,
+                                    temp_max_corner, rel_pos, delta_pos);
+                }
+            }
+        }
+        resolve_walls(tile_map, &batch, owners, &t_lowest, &normal, &result);
+
+        if (normal == Vector2f()) {
+            player->position = player->position + delta_pos;
+            // t_remaining = 0;
+        } else {
+            player->position = player->position + delta_pos * t_lowest;
+            player->velocity = player->velocity - normal * dot(player->velocity, normal);
+            player->acceleration =
+                player->acceleration - normal * dot(player->acceleration, normal);
+            delta_pos = delta_pos - normal * dot(delta_pos, normal);
+        }
+        t_remaining -= t_lowest * t_remaining;
+    }
+
+    return result;
+}
+
+// Zie de uitleg van de vaste tick in pilot.cpp.
+#define SIM_TICKS_PER_SECOND 120
+#define SIM_DELTA_TIME (1.0f / SIM_TICKS_PER_SECOND)
+// Na een hele trage frame (of een breakpoint) halen we niet alles in, anders wordt de volgende
+// frame door al die ticks ook weer traag.
+#define MAX_TICKS_PER_FRAME 8
+
+// Tel de tijd van een frame op bij tick_time, en geef terug hoeveel ticks we nu moeten doen. De
+// tijd komt als elapsed tellen van een klok met frequency tellen per seconde (in het spel
+// QueryPerformanceCounter). tick_time telt in stukjes van 1 / (frequency * SIM_TICKS_PER_SECOND)
+// seconde. Een tick is dan precies frequency stukjes en we hoeven niets af te ronden: met dezelfde
+// tellen komen 30 en 144 fps altijd op dezelfde tick uit. Wat overblijft is minder dan een tick,
+// daarmee tekent het spel tussen twee ticks in. De fps test in tests.cpp doet hiermee frames van
+// 30 tot 240 fps.
+static u32 advance_tick_time(i64 *tick_time, i64 elapsed, i64 frequency) {
+    *tick_time =
+        minimum(*tick_time + elapsed * SIM_TICKS_PER_SECOND, MAX_TICKS_PER_FRAME * frequency);
+    u32 ticks = (u32)(*tick_time / frequency);
+    *tick_time -= (i64)ticks * frequency;
+    return ticks;
+}
+
+// De input van een tick. Het spel maakt hem uit Engine::input, de replay runner uit een opname.
+struct Sim_Input {
+    f32 movement;
+    // Of er sinds de vorige tick op springen is gedrukt.
+    bool jump;
+    // Of springen nog ingedrukt is, dan springen we hoger.
+    bool space;
+};
+
+// Wat er in een tick is gebeurd, zodat het spel er geluid en schermen bij kan doen.
+enum {
+    SIM_JUMPED = shift(0),
+    SIM_COIN = shift(1),
+    SIM_COMPLETED = shift(2),
+    SIM_FAILED = shift(3),
+};
+
+struct Level_Sim {
+    Tile_Map *map;
+    Player_Body player;
+    f32 gravity;
+
+    Collision collision;
+    bool coin_collected;
+    i32 coin_index;
+    bool dead;
+    f32 death_timer;
+
+    // Hoeveel ticks we al in dit level zijn.
+    u32 tick;
+};
+
+// Zet de speler op het begin van de map. De maten, max_speed en gravity blijven staan.
+static void reset_level_sim(Level_Sim *sim, Tile_Map *map) {
+    sim->map = map;
+    sim->player.position = map->start_pos;
+    sim->player.velocity = Vector2f();
+    sim->collision = {};
+    sim->coin_collected = false;
+    sim->tick = 0;
+}
+
+// Een tick van SIM_DELTA_TIME. Geeft de SIM_ flags terug van wat er gebeurd is. Na SIM_COMPLETED
+// of SIM_FAILED is het level voorbij.
+static u32 simulate_tick(Level_Sim *sim, Sim_Input *input) {
+    u32 events = 0;
+    sim->tick++;
+
+    if (sim->dead)
+        sim->death_timer += SIM_DELTA_TIME;
+    else
+        sim->death_timer = 0;
+
+    Player_Body *player = &sim->player;
+
+    // Zwaartekracht
+    player->acceleration.y = -sim->gravity;
+
+    // De horizontale beweging door de speler.
+    player->acceleration.x = input->movement * 3000;
+    if (sim->dead) player->acceleration.x = 0;
+
+    // Spring systeem: https://www.youtube.com/watch?v=7KiK0Aqtmzc
+    if (input->jump && sim->collision.on_ground) {
+        player->acceleration.y = 1200.0f / SIM_DELTA_TIME;
+        events |= SIM_JUMPED;
+    }
+
+    if (player->velocity.y > 0.0f) {
+        player->acceleration.y -= sim->gravity * 2.0f;
+    } else if (player->velocity.y < 0.0f && !input->space) {
+        player->acceleration.y -= sim->gravity;
+    }
+
+    // Wrijving
+    player->acceleration.x -= player->velocity.x * 5.0f;
+
+    // Zorg dat we niet boven de maximale snelheid gaan.
+    if (player->velocity.x > player->max_speed) {
+        player->velocity.x = player->max_speed;
+    } else if (player->velocity.x < -player->max_speed) {
+        player->velocity.x = -player->max_speed;
+    }
+
+    Tile_Map *map = sim->map;
+    sim->collision = update_player_position(map, player, SIM_DELTA_TIME);
+
+    // Het level is gehaald als we met de munt bij het einde zijn.
+    if ((sim->collision.tile & END_TILE) && (sim->coin_collected)) {
+        player->velocity = Vector2f();
+        return events | SIM_COMPLETED;
+    }
+
+    if ((sim->collision.tile & DEATH_TILE) || (sim->collision.tile & SPIKES_TILE)) {
+        // Leg de munt terug, zodat hij er bij de volgende poging weer is.
+        if (sim->coin_collected) {
+            set_tile(map, sim->coin_index % map->width, sim->coin_index / map->width, COIN_TILE);
+        }
+        return events | SIM_FAILED;
+    }
+
+    if (sim->collision.tile & COIN_TILE) {
+        sim->coin_index = sim->collision.coin_index;
+        sim->coin_collected = true;
+        events |= SIM_COIN;
+    }
+    return events;
+}
+
+// Een FNV-1a hash van alles wat de volgende ticks bepaalt. Zijn twee hashes na dezelfde tick
+// gelijk, dan is er (vrijwel zeker) precies hetzelfde gebeurd.
+static u64 hash_level_sim(Level_Sim *sim) {
+    u32 values[8];
+    memcpy(values + 0, &sim->player.position.x, sizeof(f32));
+    memcpy(values + 1, &sim->player.position.y, sizeof(f32));
+    memcpy(values + 2, &sim->player.velocity.x, sizeof(f32));
+    memcpy(values + 3, &sim->player.velocity.y, sizeof(f32));
+    values[4] = sim->coin_collected ? 1 : 0;
+    values[5] = (u32)sim->coin_index;
+    values[6] = sim->collision.on_ground ? 1 : 0;
+    values[7] = sim->tick;
+
+    u64 hash = 14695981039346656037ull;
+    u8 *bytes = (u8 *)values;
+    for (u32 i = 0; i < sizeof(values); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
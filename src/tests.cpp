@@ -0,0 +1,1454 @@
+// De tests draaien zonder venster, geluid of Windows, en controleren de dingen die je in het spel
+// niet goed kunt zien, zoals of de SIMD kernels bit voor bit hetzelfde doen als de scalar kernels.
+// Draai ze vanuit de map van het spel:
+//     tests                         alle tests
+//     tests blit                    alleen de tests waarvan de naam met blit begint
+//     tests sweep                   alleen de botsingen, die ook laten zien hoe snel de
+//                                   broadphase van update_player_position is
+// Een test die niet klopt schrijft op wat er mis is, en dan geeft tests 1 terug.
+//
+// Bouwen op Windows gaat met build.bat, op Linux met:
+//     g++ -O2 -pthread -o tests src/tests.cpp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <immintrin.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#define i8 char
+#define i16 short
+#define i32 int
+#define i64 long long
+
+#define u8 unsigned char
+#define u16 unsigned short
+#define u32 unsigned int
+#define u64 unsigned long long
+
+#define f32 float
+#define f64 double
+
+#define shift(x) 1 << (x)
+
+#define minimum(A, B) ((A < B) ? (A) : (B))
+#define maximum(A, B) ((A > B) ? (A) : (B))
+
+#define TESTS 1
+
+#include "math.cpp"
+#include "cpu.cpp"
+#include "blit.cpp"
+#include "present.cpp"
+#include "level.cpp"
+#include "walls.cpp"
+#include "sim.cpp"
+#include "recording.cpp"
+
+static void *allocate_pages(u64 size) {
+    return calloc(1, size ? size : 1);
+}
+
+static void free_pages(void *memory) {
+    free(memory);
+}
+
+// Hetzelfde als random_next in replay.cpp.
+static u32 next_test_random(u32 *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Zo weet je in de buffer welke pixels de blit niet had mogen raken.
+static u32 get_background_pixel(i32 x, i32 y) {
+    return 0x01000000u ^ ((u32)x * 2654435761u) ^ ((u32)y * 40503u);
+}
+
+// NOTE: Uitleg blit test.
+// Voor elke set kernels (scalar, SSE2 en AVX2 als de processor dat heeft) tekenen we een paar
+// sprites op allerlei plekken: helemaal binnen de buffer, half over elke rand en hoek, en er
+// helemaal buiten. Dat doen we gespiegeld en niet gespiegeld, met de hele buffer en met een band
+// als clip (zoals render_band), en met een kolom minder dan de sprite breed is (zoals draw_sprite
+// bij een oneven breedte). De scalar kernels vergelijken we pixel voor pixel met wat er volgens
+// de regels moet staan, en de SIMD kernels bit voor bit met de scalar kernels.
+#define BLIT_TEST_WIDTH 1100
+#define BLIT_TEST_HEIGHT 41
+
+struct Blit_Test_Kernels {
+    const char *name;
+    Blit_Row *row;
+    Blit_Row *reverse;
+};
+
+// Een sprite met willekeurige pixels, waarvan ongeveer een derde transparant. Een pixel is alleen
+// transparant met alpha 0, dus de andere krijgen een willekeurige alpha. De onderste rij en de
+// laatste kolom zijn helemaal transparant, zodat de spans ook trimmen.
+static Sprite make_test_sprite(u32 width, u32 height, u32 seed, bool opaque) {
+    Sprite sprite = {};
+    sprite.width = width;
+    sprite.height = height;
+    sprite.bits_per_pixel = 32;
+    sprite.pitch = width;
+    sprite.pixels = (u32 *)allocate_pages(sizeof(u32) * width * height);
+    sprite.memory = sprite.pixels;
+
+    u32 state = seed;
+    for (u32 y = 0; y < height; y++) {
+        for (u32 x = 0; x < width; x++) {
+            u32 pixel = next_test_random(&state) | (next_test_random(&state) << 24);
+            bool transparent = (next_test_random(&state) % 3 == 0) || (y == 0) || (x == width - 1);
+            if (opaque) {
+                pixel |= 0x01000000;
+            } else if (transparent) {
+                pixel &= 0x00FFFFFF;
+            }
+            sprite.pixels[y * width + x] = pixel;
+        }
+    }
+    sprite.opaque = is_sprite_opaque(&sprite);
+    return sprite;
+}
+
+// Wat er na het tekenen op (x, y) moet staan, zonder kernels.
+static u32 get_expected_pixel(Sprite *sprite, Vector2i min, Vector2i max, Rect clip, i32 x,
+                              i32 y) {
+    u32 background = get_background_pixel(x, y);
+    if ((x < maximum(min.x, clip.min_x)) || (x >= minimum(max.x, clip.max_x)) ||
+        (y < maximum(min.y, clip.min_y)) || (y >= minimum(max.y, clip.max_y))) {
+        return background;
+    }
+
+    i32 sprite_x = x - min.x;
+    if (sprite->mirror_x) sprite_x = (i32)sprite->width - 1 - sprite_x;
+    u32 pixel = sprite->pixels[(y - min.y) * (i32)sprite->pitch + sprite_x];
+    return (pixel >> 24) ? pixel : background;
+}
+
+static void fill_test_background(Offscreen_Buffer *buffer) {
+    for (u32 y = 0; y < buffer->height; y++) {
+        u32 *row = (u32 *)((u8 *)buffer->memory + y * buffer->pitch);
+        for (u32 x = 0; x < buffer->width; x++) {
+            row[x] = get_background_pixel((i32)x, (i32)y);
+        }
+    }
+}
+
+static bool test_blit() {
+    Offscreen_Buffer buffer = {};
+    buffer.width = BLIT_TEST_WIDTH;
+    buffer.height = BLIT_TEST_HEIGHT;
+    buffer.bytes_per_pixel = 4;
+    buffer.pitch = BLIT_TEST_WIDTH * 4;
+    buffer.memory = allocate_pages((u64)buffer.pitch * buffer.height);
+    u32 *reference = (u32 *)allocate_pages((u64)buffer.pitch * buffer.height);
+
+    Cpu_Features features = get_cpu_features();
+    Blit_Test_Kernels kernels[3] = {{"scalar", blit_row_scalar, blit_row_reverse_scalar}};
+    u32 kernel_count = 1;
+    if (features.sse2) kernels[kernel_count++] = {"SSE2", blit_row_sse2, blit_row_reverse_sse2};
+    if (features.avx2) kernels[kernel_count++] = {"AVX2", blit_row_avx2, blit_row_reverse_avx2};
+
+    // Alpha test, spans, opaque, en een opaque rij die lang genoeg is voor de non-temporal stores.
+    Sprite sprites[4];
+    sprites[0] = make_test_sprite(37, 23, 1, false);
+    sprites[1] = make_test_sprite(37, 23, 2, false);
+    build_sprite_spans(sprites + 1);
+    sprites[2] = make_test_sprite(37, 23, 3, true);
+    sprites[3] = make_test_sprite(NON_TEMPORAL_MIN_PIXELS + 13, 3, 4, true);
+
+    Rect clips[2] = {buffer_rect(&buffer), {3, 7, BLIT_TEST_WIDTH - 5, 30}};
+    u32 failures = 0;
+    u32 blits = 0;
+
+    for (u32 sprite_index = 0; sprite_index < 4; sprite_index++) {
+        Sprite *sprite = sprites + sprite_index;
+        i32 width = (i32)sprite->width;
+        i32 height = (i32)sprite->height;
+        i32 xs[] = {-width - 1, -width + 1, -width / 2, -1, 0, 5,
+                    BLIT_TEST_WIDTH - width - 1, BLIT_TEST_WIDTH - width,
+                    BLIT_TEST_WIDTH - width / 2, BLIT_TEST_WIDTH - 1, BLIT_TEST_WIDTH};
+        i32 ys[] = {-height - 1, -height + 1, -height / 2, -1, 0, 9,
+                    BLIT_TEST_HEIGHT - height, BLIT_TEST_HEIGHT - height / 2,
+                    BLIT_TEST_HEIGHT - 1, BLIT_TEST_HEIGHT};
+
+        for (u32 xi = 0; xi < sizeof(xs) / sizeof(xs[0]); xi++) {
+            for (u32 yi = 0; yi < sizeof(ys) / sizeof(ys[0]); yi++) {
+                for (u32 variant = 0; variant < 8; variant++) {
+                    sprite->mirror_x = (variant & 1) != 0;
+                    Rect clip = clips[(variant >> 1) & 1];
+                    Vector2i min = Vector2i(xs[xi], ys[yi]);
+                    Vector2i max = min + Vector2i(width - ((variant & 4) ? 1 : 0), height);
+
+                    for (u32 k = 0; k < kernel_count; k++) {
+                        blit_row = kernels[k].row;
+                        blit_row_reverse = kernels[k].reverse;
+                        fill_test_background(&buffer);
+                        blit_sprite(&buffer, sprite, min, max, clip);
+                        blits++;
+
+                        u32 *pixels = (u32 *)buffer.memory;
+                        if (k == 0) {
+                            memcpy(reference, pixels, (u64)buffer.pitch * buffer.height);
+                        }
+
+                        for (i32 y = 0; y < BLIT_TEST_HEIGHT; y++) {
+                            for (i32 x = 0; x < BLIT_TEST_WIDTH; x++) {
+                                u32 expected =
+                                    (k == 0) ? get_expected_pixel(sprite, min, max, clip, x, y)
+                                             : reference[y * BLIT_TEST_WIDTH + x];
+                                u32 pixel = pixels[y * BLIT_TEST_WIDTH + x];
+                                if (pixel == expected) continue;
+
+                                if (failures++ < 10) {
+                                    printf("blit: sprite %u (%ux%u%s) op %d,%d tot %d,%d, %s "
+                                           "kernel: pixel %d,%d is %08x, moet %08x zijn\n",
+                                           sprite_index, sprite->width, sprite->height,
+                                           sprite->mirror_x ? ", gespiegeld" : "", min.x, min.y,
+                                           max.x, max.y, kernels[k].name, x, y, pixel, expected);
+                                }
+                                // Een fout per blit is genoeg.
+                                y = BLIT_TEST_HEIGHT;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("blit: %u blits met %u sets kernels, %u fout\n", blits, kernel_count, failures);
+    for (u32 i = 0; i < 4; i++) {
+        free_pages(sprites[i].memory);
+        if (sprites[i].row_spans) free_pages(sprites[i].row_spans);
+    }
+    free_pages(buffer.memory);
+    free_pages(reference);
+    initialize_blitter();
+    return failures == 0;
+}
+
+// Controleer de relatieve fout van de wortels met wat er in de uitleg van de wortels in math.cpp
+// staat (inv_sqrt_error_bounds), over getallen van 1e-30 tot 1e30. De vier-tegelijk versies moeten
+// bit voor bit hetzelfde geven als de losse, en normaliseren moet lengte 1 geven, of (0, 0) bij
+// een vector met lengte 0.
+#define MATH_TEST_COUNT 65536
+#define MATH_TEST_ROW 4096
+
+static bool check_math_error(const char *name, f64 max_error, f64 bound) {
+    bool ok = max_error <= bound;
+    printf("math: %s: fout hooguit %.2e, mag %.2e%s\n", name, max_error, bound,
+           ok ? "" : ", TE GROOT");
+    return ok;
+}
+
+static bool test_math() {
+    // Eerst een rij van 1e-6 tot 1e6 zoals in benchmark_math, daarna willekeurige floats.
+    static f32 numbers[MATH_TEST_COUNT];
+    u32 state = 1;
+    f64 number = 1e-6;
+    for (u32 i = 0; i < MATH_TEST_COUNT; i++) {
+        if (i < MATH_TEST_ROW) {
+            numbers[i] = (f32)number;
+            number *= 1.0067685;
+        } else {
+            u32 exponent = 127 - 100 + next_test_random(&state) % 200;
+            u32 bits = (exponent << 23) | (next_test_random(&state) & 0x7FFFFF);
+            memcpy(numbers + i, &bits, sizeof(f32));
+        }
+    }
+
+    bool ok = true;
+    const char *precision_names[] = {"inv_sqrt fast", "inv_sqrt refined", "inv_sqrt exact"};
+    for (u32 precision = PRECISION_FAST; precision <= PRECISION_EXACT; precision++) {
+        f64 max_error = 0.0;
+        u32 lane_mismatches = 0;
+        for (u32 i = 0; i < MATH_TEST_COUNT; i += 4) {
+            f32 wide[4];
+            _mm_storeu_ps(wide, inv_sqrt_4(_mm_loadu_ps(numbers + i), (Math_Precision)precision));
+            for (u32 lane = 0; lane < 4; lane++) {
+                f32 result = inv_sqrt_f32(numbers[i + lane], (Math_Precision)precision);
+                if (memcmp(&result, wide + lane, sizeof(f32)) != 0) lane_mismatches++;
+                f64 error = get_root_error(numbers[i + lane], result, true);
+                if (error > max_error) max_error = error;
+            }
+        }
+        ok &= check_math_error(precision_names[precision], max_error,
+                               inv_sqrt_error_bounds[precision]);
+        if (lane_mismatches) {
+            printf("math: %s: inv_sqrt_4 geeft %u keer iets anders dan inv_sqrt_f32\n",
+                   precision_names[precision], lane_mismatches);
+            ok = false;
+        }
+    }
+
+    f64 max_error = 0.0;
+    for (u32 i = 0; i < MATH_TEST_COUNT; i++) {
+        f64 error = get_root_error(numbers[i], sqrt_f32(numbers[i]), false);
+        if (error > max_error) max_error = error;
+    }
+    ok &= check_math_error("sqrt_f32", max_error, SQRT_ERROR_BOUND);
+
+    // Vectoren in alle richtingen en met lengtes van 1e-6 tot 1e6, met af en toe een met lengte
+    // 0, zowel in een groep van vier als in de rest die normalize_vectors een voor een doet.
+    const u32 count = MATH_TEST_ROW + 3;
+    static f32 original_x[count];
+    static f32 original_y[count];
+    static f32 vector_x[count];
+    static f32 vector_y[count];
+    for (u32 i = 0; i < count; i++) {
+        bool zero = (i % 37 == 0) || (i == count - 1);
+        original_x[i] = zero ? 0.0f : numbers[i % MATH_TEST_ROW] * ((i & 1) ? -1.0f : 1.0f);
+        original_y[i] = zero ? 0.0f : numbers[(i * 7) % MATH_TEST_ROW] * ((i & 2) ? -1.0f : 1.0f);
+    }
+    Vector2f_Array original = {original_x, original_y, count};
+    Vector2f_Array vectors = {vector_x, vector_y, count};
+
+    const char *normalize_names[] = {"normalize fast", "normalize refined", "normalize exact"};
+    for (u32 precision = PRECISION_FAST; precision <= PRECISION_EXACT; precision++) {
+        memcpy(vector_x, original_x, sizeof(vector_x));
+        memcpy(vector_y, original_y, sizeof(vector_y));
+        normalize_vectors(&vectors, (Math_Precision)precision);
+
+        max_error = 0.0;
+        u32 mismatches = 0;
+        for (u32 i = 0; i < count; i++) {
+            Vector2f one = get_vector2f(&original, i).normalize((Math_Precision)precision);
+            Vector2f batch = get_vector2f(&vectors, i);
+            if (memcmp(&one, &batch, sizeof(Vector2f)) != 0) mismatches++;
+
+            if ((original_x[i] == 0.0f) && (original_y[i] == 0.0f)) {
+                if ((batch.x != 0.0f) || (batch.y != 0.0f)) mismatches++;
+                continue;
+            }
+            f64 error = get_unit_length_error(batch.x, batch.y);
+            if (error > max_error) max_error = error;
+        }
+        // Bovenop de fout van de inverse wortel komt nog de afronding van x en y.
+        ok &= check_math_error(normalize_names[precision], max_error,
+                               inv_sqrt_error_bounds[precision] + 1.0 / 4194304.0);
+        if (mismatches) {
+            printf("math: %s: normalize_vectors geeft %u keer iets anders dan normalize\n",
+                   normalize_names[precision], mismatches);
+            ok = false;
+        }
+    }
+
+    // Lengte 0 mag geen oneindig of NaN worden.
+    Vector2f zero2f = Vector2f().normalize();
+    Vector3f zero3f = Vector3f().normalize();
+    Vector2i zero2i = Vector2i().normalize();
+    Vector3i zero3i = Vector3i().normalize();
+    if ((zero2f.x != 0.0f) || (zero2f.y != 0.0f) || (zero3f.x != 0.0f) || (zero3f.y != 0.0f) ||
+        (zero3f.z != 0.0f) || (zero2i != Vector2i()) || (zero3i != Vector3i())) {
+        printf("math: normalize van een vector met lengte 0 is niet 0\n");
+        ok = false;
+    }
+    return ok;
+}
+
+// NOTE: Uitleg present test.
+// We draaien de echte presenter thread met present_frame_memory, en tekenen elke frame een paar
+// rechthoeken in de buffer. Soms wachten we tot de presenter klaar is en soms niet, zodat er ook
+// frames worden overgeslagen. Als we wachten, moet memory_target precies hetzelfde zijn als de
+// hele buffer in een keer opgeschaald: dan weten we dat de dirty rects, de marge die submit_frame
+// meekopieert en de overgeslagen frames kloppen. Halverwege verandert de buffer van grootte. De
+// verwachte pixels rekenen we hier zelf per pixel uit, zonder SSE2 en zonder de kolommen tabel,
+// zodat ook de SSE2 stukken van de kernels gecontroleerd worden, zoals nearest bij 2, 3 en meer
+// keer zo breed.
+#define PRESENT_TEST_FRAMES 300
+
+struct Present_Test_Target {
+    const char *name;
+    u32 width, height;
+    Upscale_Filter filter;
+};
+
+static void yield_test_thread() {
+#ifdef _WIN32
+    Sleep(0);
+#else
+    sched_yield();
+#endif
+}
+
+// Wacht tot de presenter alles heeft laten zien. Stukken van overgeslagen frames staan daarna nog
+// in de buffer, die sturen we dan nog een keer.
+static void flush_presenter(Presenter *presenter, Offscreen_Buffer *buffer, u32 target_width,
+                            u32 target_height) {
+    for (;;) {
+        // De presenter houdt resize_lock vast zolang hij een frame laat zien.
+        for (;;) {
+            lock_present(&presenter->resize_lock);
+            bool presented = !(presenter->pending & PRESENT_NEW_FRAME);
+            unlock_present(&presenter->resize_lock);
+            if (presented) break;
+            yield_test_thread();
+        }
+        if (!buffer->all_dirty && (buffer->dirty_count == 0)) return;
+        submit_frame(presenter, buffer, target_width, target_height);
+    }
+}
+
+// De pixel x, y van source opgeschaald naar dest, zoals upscale_nearest hem hoort te maken.
+static u32 get_nearest_test_pixel(Offscreen_Buffer *source, Offscreen_Buffer *dest, u32 x, u32 y) {
+    u32 source_y = (u32)((u64)y * source->height / dest->height);
+    u32 *source_row = (u32 *)((u8 *)source->memory + source_y * source->pitch);
+    return source_row[(u64)x * source->width / dest->width];
+}
+
+// Zo mengt lerp_pixels een kanaal, weight gaat van 0 tot 128.
+static u32 lerp_test_channel(u32 a, u32 b, u32 weight) {
+    return (u32)((i32)a + (((i32)b - (i32)a) * (i32)weight >> 7));
+}
+
+// Dezelfde pixel zoals upscale_bilinear hem hoort te maken: eerst de twee rijen mengen, dan de
+// twee kolommen, met dezelfde 16.16 posities en 7 bits gewichten.
+static u32 get_bilinear_test_pixel(Offscreen_Buffer *source, Offscreen_Buffer *dest, u32 x,
+                                   u32 y) {
+    i64 step_x = (((i64)source->width << 16) + dest->width / 2) / dest->width;
+    i64 step_y = (((i64)source->height << 16) + dest->height / 2) / dest->height;
+    i64 position_x = maximum(x * step_x + step_x / 2 - 32768, 0);
+    i64 position_y = maximum(y * step_y + step_y / 2 - 32768, 0);
+    u32 x0 = (u32)(position_x >> 16);
+    u32 x1 = minimum(x0 + 1, source->width - 1);
+    u32 y0 = (u32)(position_y >> 16);
+    u32 y1 = minimum(y0 + 1, source->height - 1);
+    u32 weight_x = (u32)((position_x >> 9) & 127);
+    u32 weight_y = (u32)((position_y >> 9) & 127);
+
+    u32 *row0 = (u32 *)((u8 *)source->memory + y0 * source->pitch);
+    u32 *row1 = (u32 *)((u8 *)source->memory + y1 * source->pitch);
+    u32 result = 0;
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 left = lerp_test_channel((row0[x0] >> shift) & 255, (row1[x0] >> shift) & 255,
+                                     weight_y);
+        u32 right = lerp_test_channel((row0[x1] >> shift) & 255, (row1[x1] >> shift) & 255,
+                                      weight_y);
+        result |= lerp_test_channel(left, right, weight_x) << shift;
+    }
+    return result;
+}
+
+static u32 compare_present_target(Presenter *presenter, Offscreen_Buffer *buffer,
+                                  Present_Test_Target *target) {
+    // Zo hoort het eruit te zien: de hele buffer in een keer opgeschaald.
+    Presenter reference = {};
+    reference.filter = target->filter;
+    Offscreen_Buffer image = {};
+    resize_buffer(&image, Vector2i(buffer->width, buffer->height));
+    memcpy(image.memory, buffer->memory, buffer->pitch * buffer->height);
+    Offscreen_Buffer *expected = upscale_image(&reference, &image, target->width, target->height);
+    if (expected != &image) {
+        for (u32 y = 0; y < expected->height; y++) {
+            u32 *expected_row = (u32 *)((u8 *)expected->memory + y * expected->pitch);
+            for (u32 x = 0; x < expected->width; x++) {
+                expected_row[x] = (target->filter == UPSCALE_NEAREST)
+                                      ? get_nearest_test_pixel(&image, expected, x, y)
+                                      : get_bilinear_test_pixel(&image, expected, x, y);
+            }
+        }
+    }
+
+    Offscreen_Buffer *result = &presenter->memory_target;
+    u32 mismatches = 0;
+    if ((result->width != expected->width) || (result->height != expected->height)) {
+        mismatches = 1;
+    } else {
+        for (u32 y = 0; y < expected->height; y++) {
+            u32 *expected_row = (u32 *)((u8 *)expected->memory + y * expected->pitch);
+            u32 *result_row = (u32 *)((u8 *)result->memory + y * result->pitch);
+            for (u32 x = 0; x < expected->width; x++) {
+                mismatches += expected_row[x] != result_row[x];
+            }
+        }
+    }
+
+    free_pages(image.memory);
+    if (reference.scaled.memory) free_pages(reference.scaled.memory);
+    if (reference.filter_row) free_pages(reference.filter_row);
+    if (reference.columns) free_pages(reference.columns);
+    return mismatches;
+}
+
+static bool test_present() {
+    Present_Test_Target targets[] = {
+        {"320x180 nearest", 320, 180, UPSCALE_NEAREST},
+        {"640x360 nearest", 640, 360, UPSCALE_NEAREST},
+        {"960x540 nearest", 960, 540, UPSCALE_NEAREST},
+        {"1280x720 nearest", 1280, 720, UPSCALE_NEAREST},
+        {"1920x1080 nearest", 1920, 1080, UPSCALE_NEAREST},
+        {"640x360 bilinear", 640, 360, UPSCALE_BILINEAR},
+        {"480x270 nearest", 480, 270, UPSCALE_NEAREST},
+        {"480x270 bilinear", 480, 270, UPSCALE_BILINEAR},
+    };
+
+    u32 failures = 0;
+    for (u32 t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        Present_Test_Target *target = targets + t;
+        Presenter *presenter = (Presenter *)calloc(1, sizeof(Presenter));
+        start_presenter(presenter, present_frame_memory, target->filter);
+
+        Offscreen_Buffer buffer = {};
+        u32 state = t + 1;
+        u32 checks = 0;
+        u32 mismatches = 0;
+        for (u32 frame = 0; frame < PRESENT_TEST_FRAMES; frame++) {
+            if ((frame == 0) || (frame == PRESENT_TEST_FRAMES / 2)) {
+                if (frame == 0) {
+                    resize_buffer(&buffer, Vector2i(320, 180));
+                } else {
+                    resize_buffer(&buffer, Vector2i(256, 144));
+                }
+                fill_test_background(&buffer);
+            }
+
+            // Een paar rechthoeken, ook tegen de randen aan en soms maar een pixel groot.
+            u32 rect_count = 1 + next_test_random(&state) % 4;
+            for (u32 i = 0; i < rect_count; i++) {
+                Rect rect;
+                rect.min_x = next_test_random(&state) % buffer.width;
+                rect.min_y = next_test_random(&state) % buffer.height;
+                i32 width = 1 + next_test_random(&state) % 40;
+                i32 height = 1 + next_test_random(&state) % 40;
+                rect.max_x = minimum(rect.min_x + width, (i32)buffer.width);
+                rect.max_y = minimum(rect.min_y + height, (i32)buffer.height);
+                u32 color = next_test_random(&state) | 0xFF000000;
+                for (i32 y = rect.min_y; y < rect.max_y; y++) {
+                    u32 *row = (u32 *)((u8 *)buffer.memory + y * buffer.pitch);
+                    for (i32 x = rect.min_x; x < rect.max_x; x++) row[x] = color;
+                }
+                mark_dirty(&buffer, rect);
+            }
+
+            submit_frame(presenter, &buffer, target->width, target->height);
+            if ((next_test_random(&state) % 4 == 0) || (frame == PRESENT_TEST_FRAMES - 1)) {
+                flush_presenter(presenter, &buffer, target->width, target->height);
+                mismatches += compare_present_target(presenter, &buffer, target);
+                checks++;
+            }
+        }
+
+        close_presenter(presenter);
+        printf("present: %s: %u frames, %u keer vergeleken, %u pixels anders\n", target->name,
+               PRESENT_TEST_FRAMES, checks, mismatches);
+        if (mismatches) failures++;
+
+        // De timings uit de presenter: een frame kan niet getoond worden voor hij binnen is, en
+        // de presenter laat ze in volgorde zien. Overlap betekent dat de volgende frame al
+        // binnenkwam terwijl de presenter nog bezig was, en dat is precies waar hij voor is.
+        Present_Timing timings[PRESENT_TIMING_COUNT];
+        u32 timing_count = get_present_timings(presenter, timings, PRESENT_TIMING_COUNT);
+        u32 out_of_order = 0;
+        u32 overlaps = 0;
+        for (u32 i = 0; i < timing_count; i++) {
+            Present_Timing *timing = timings + i;
+            if ((timing->submit_time > timing->present_start) ||
+                (timing->present_start > timing->present_end)) {
+                out_of_order++;
+            }
+            if (i > 0) {
+                if (timing->frame_index <= timings[i - 1].frame_index) out_of_order++;
+                if (timing->submit_time < timings[i - 1].present_end) overlaps++;
+            }
+        }
+        f64 to_ms = 1000.0 / (f64)presenter->frequency;
+        printf("present: %s: %u frames getoond, van de laatste %u %u keer overlap en %u keer "
+               "verkeerde volgorde\n",
+               target->name, presenter->timing_count, timing_count, overlaps, out_of_order);
+        for (u32 i = (timing_count > 4) ? timing_count - 4 : 0; i < timing_count; i++) {
+            Present_Timing *timing = timings + i;
+            printf("    frame %u: submit %.3fms, present %.3fms - %.3fms\n", timing->frame_index,
+                   (f64)(timing->submit_time - presenter->start_time) * to_ms,
+                   (f64)(timing->present_start - presenter->start_time) * to_ms,
+                   (f64)(timing->present_end - presenter->start_time) * to_ms);
+        }
+        if ((timing_count == 0) || out_of_order) failures++;
+
+        free_pages(buffer.memory);
+        for (u32 i = 0; i < PRESENT_SLOTS; i++) free_pages(presenter->slots[i].image.memory);
+        if (presenter->memory_target.memory) free_pages(presenter->memory_target.memory);
+        if (presenter->scaled.memory) free_pages(presenter->scaled.memory);
+        if (presenter->filter_row) free_pages(presenter->filter_row);
+        if (presenter->columns) free_pages(presenter->columns);
+        free(presenter);
+    }
+    return failures == 0;
+}
+
+// NOTE: Uitleg test levels.
+// De tests met de natuurkunde spelen de levels van het spel: de ontwerpen in levels, die we net als
+// convert_level_design in het geheugen omzetten naar een level bestand. Zo hoef je eerst geen
+// packer -levels te doen, en testen we altijd het ontwerp zoals het nu is. Net als in replay.cpp
+// pakken we alle chunks van tevoren uit. Een test verandert de tiles (munten), dus na elke poging
+// pakken we de chunks opnieuw uit met reset_test_level.
+#define TEST_LEVELS 10
+// Zoveel opnames per level lezen we hoogstens uit levels/opnames.
+#define TEST_MAX_RECORDINGS 16
+
+// Dezelfde header als in packer.cpp.
+#pragma pack(push, 1)
+struct Test_Bitmap_Header {
+    u16 file_type;
+    u32 file_size;
+    u16 reserved1;
+    u16 reserved2;
+    u32 bitmap_offset;
+
+    u32 size;
+    u32 width;
+    i32 height;
+    u16 planes;
+    u16 bits_per_pixel;
+    u32 compression;
+};
+#pragma pack(pop)
+
+struct Test_Level {
+    Tile_Map map;
+    Level_Chunk *chunks;
+    u8 *memory;
+};
+
+static Level_Chunk *get_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y) {
+    return map->chunks[chunk_y * map->chunks_x + chunk_x];
+}
+
+// Elke test heeft zijn eigen chunks, dus daar mag hij gewoon in schrijven.
+static Level_Chunk *get_writable_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y) {
+    Level_Chunk *chunk = get_level_chunk(map, chunk_x, chunk_y);
+    return (chunk == &empty_level_chunk) ? 0 : chunk;
+}
+
+static u8 *read_test_file(const char *name, u64 *size) {
+    FILE *file = fopen(name, "rb");
+    if (!file) return 0;
+
+    fseek(file, 0, SEEK_END);
+    *size = (u64)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8 *memory = (u8 *)malloc(*size ? *size : 1);
+    if (fread(memory, 1, *size, file) != *size) {
+        free(memory);
+        memory = 0;
+    }
+    fclose(file);
+    return memory;
+}
+
+static void reset_test_level(Test_Level *test_level) {
+    Level_Header *level = test_level->map.level;
+    for (u32 chunk_y = 0; chunk_y < level->chunks_y; chunk_y++) {
+        for (u32 chunk_x = 0; chunk_x < level->chunks_x; chunk_x++) {
+            u32 index = chunk_y * level->chunks_x + chunk_x;
+            if (test_level->map.chunks[index] == &empty_level_chunk) continue;
+            decode_tile_chunk(level, chunk_x, chunk_y, test_level->chunks + index);
+        }
+    }
+}
+
+// Zet width * height tiles om naar een level met alle chunks uitgepakt, met dezelfde maten als
+// load_tile_map.
+static void make_test_level(const u8 *tiles, u32 width, u32 height, Test_Level *result) {
+    *result = {};
+    result->memory = (u8 *)malloc(get_level_size_bound(width, height));
+    encode_level(tiles, width, height, result->memory);
+
+    Level_Header *level = (Level_Header *)result->memory;
+    Tile_Map *map = &result->map;
+    map->level = level;
+    map->width = (i32)level->width;
+    map->height = (i32)level->height;
+    map->chunks_x = (i32)level->chunks_x;
+    map->chunks_y = (i32)level->chunks_y;
+    map->tile_size = 96;
+    map->start_pos = Vector2f(f32(level->start_x * map->tile_size),
+                              f32(level->start_y * map->tile_size + 40));
+
+    u32 chunk_count = level->chunks_x * level->chunks_y;
+    map->chunks = (Level_Chunk **)malloc(chunk_count * sizeof(Level_Chunk *));
+    result->chunks = (Level_Chunk *)calloc(chunk_count, sizeof(Level_Chunk));
+    for (u32 chunk_y = 0; chunk_y < level->chunks_y; chunk_y++) {
+        for (u32 chunk_x = 0; chunk_x < level->chunks_x; chunk_x++) {
+            u32 index = chunk_y * level->chunks_x + chunk_x;
+            if (get_level_chunk_entry(level, chunk_x, chunk_y)->size == 0) {
+                map->chunks[index] = &empty_level_chunk;
+                continue;
+            }
+
+            Level_Chunk *chunk = result->chunks + index;
+            chunk->map = map;
+            chunk->index = index;
+            map->chunks[index] = chunk;
+        }
+    }
+    reset_test_level(result);
+}
+
+// Laad het ontwerp levels/<number>.bmp.
+static bool load_test_level(u32 number, Test_Level *result) {
+    char filename[64];
+    snprintf(filename, sizeof(filename), "levels/%u.bmp", number);
+
+    u64 file_size;
+    u8 *file = read_test_file(filename, &file_size);
+    Test_Bitmap_Header *header = (Test_Bitmap_Header *)file;
+    if (!file || (file_size < sizeof(Test_Bitmap_Header)) || (header->file_type != 0x4D42) ||
+        (header->bits_per_pixel != 32) || (header->compression != 0) ||
+        (header->height <= 0) ||
+        ((u64)header->width * header->height * 4 > file_size - header->bitmap_offset)) {
+        printf("%s is geen 32 bits bitmap, draai de tests vanuit de map van het spel.\n",
+               filename);
+        free(file);
+        return false;
+    }
+
+    u32 width = header->width;
+    u32 height = (u32)header->height;
+    u32 *pixels = (u32 *)(file + header->bitmap_offset);
+    u8 *tiles = (u8 *)malloc((u64)width * height);
+    for (u64 i = 0; i < (u64)width * height; i++) {
+        tiles[i] = get_design_tile(pixels[i]);
+    }
+    make_test_level(tiles, width, height, result);
+    free(tiles);
+    free(file);
+    return true;
+}
+
+static void free_test_level(Test_Level *level) {
+    free(level->map.chunks);
+    free(level->chunks);
+    free(level->memory);
+}
+
+// Dezelfde speler als in het spel en in run_attempt.
+static void begin_test_sim(Level_Sim *sim, Test_Level *level) {
+    *sim = {};
+    sim->player.max_speed = 750.0f;
+    sim->player.width = 31 * 3;
+    sim->player.height = 56 * 3;
+    sim->gravity = 1500.0f;
+    reset_level_sim(sim, &level->map);
+}
+
+// NOTE: Uitleg fps test.
+// Het spel doet met advance_tick_time zoveel ticks als er in de tijd van een frame passen. Na elke
+// frame moet sim.tick precies de tijd tot nu keer SIM_TICKS_PER_SECOND zijn, naar beneden
+// afgerond, hoe lang de frames ook waren. De tijd tellen we net als het spel met een klok, van
+// FPS_TEST_FREQUENCY tellen per seconde (zoveel geeft QueryPerformanceCounter meestal), dus bij
+// 144 fps is een frame geen heel aantal tellen. We doen 30, 60, 144 en 240 fps, en frames van
+// willekeurige lengte tussen die van 240 en 30 fps.
+//
+// Als input gebruiken we de opnames in levels/opnames (zie de levels test), met per tick de input
+// uit de opname zoals het spel die heeft opgenomen. Daarin leeft de speler tot een minuut lang, met
+// willekeurige input is hij op de meeste levels binnen een paar seconden af. De checkpoints van de
+// opname moeten bij elke fps kloppen, en de hash over hash_level_sim van alle ticks moet bij elke
+// fps hetzelfde zijn.
+#define FPS_TEST_FREQUENCY 10000000
+
+struct Test_Playback {
+    u64 trace;
+    u32 ticks;
+    // Na zoveel frames klopte sim.tick niet met de klok.
+    u32 wrong_frames;
+    bool verified;
+};
+
+// Speel de opname af met fps frames per seconde, of met frames van willekeurige lengte als fps 0
+// is.
+static Test_Playback run_test_playback(Test_Level *level, u8 *memory, u64 size, u32 fps) {
+    Test_Playback result = {};
+    result.trace = 14695981039346656037ull;
+    Playback playback;
+    if (!begin_playback(&playback, memory, size)) return result;
+
+    Level_Sim sim;
+    begin_test_sim(&sim, level);
+    reset_test_level(level);
+
+    u32 state = 1;
+    i64 clock = 0;
+    i64 tick_time = 0;
+    bool playing = true;
+    for (u64 frame = 0; playing; frame++) {
+        i64 elapsed;
+        if (fps) {
+            elapsed = (i64)(frame + 1) * FPS_TEST_FREQUENCY / fps -
+                      (i64)frame * FPS_TEST_FREQUENCY / fps;
+        } else {
+            i64 shortest = FPS_TEST_FREQUENCY / 240;
+            i64 longest = FPS_TEST_FREQUENCY / 30;
+            elapsed = shortest + next_test_random(&state) % (longest - shortest + 1);
+        }
+        clock += elapsed;
+
+        u32 ticks = advance_tick_time(&tick_time, elapsed, FPS_TEST_FREQUENCY);
+        for (u32 i = 0; i < ticks; i++) {
+            Sim_Input input;
+            if (!play_tick(&playback, &sim, &input)) {
+                playing = false;
+                break;
+            }
+            simulate_tick(&sim, &input);
+
+            u64 hash = hash_level_sim(&sim);
+            result.trace = (result.trace ^ hash) * 1099511628211ull;
+        }
+        if (playing && ((i64)sim.tick != clock * SIM_TICKS_PER_SECOND / FPS_TEST_FREQUENCY)) {
+            result.wrong_frames++;
+        }
+    }
+
+    result.ticks = sim.tick;
+    result.verified = finish_playback(&playback, &sim);
+    return result;
+}
+
+static bool test_fps() {
+    u32 fps_list[] = {30, 60, 144, 240, 0};
+    u32 fps_count = sizeof(fps_list) / sizeof(fps_list[0]);
+    u32 failures = 0;
+    for (u32 number = 1; number <= TEST_LEVELS; number++) {
+        Test_Level level;
+        if (!load_test_level(number, &level)) return false;
+
+        u32 count = 0;
+        u32 ticks = 0;
+        u32 differences = 0;
+        for (u32 i = 1; i <= TEST_MAX_RECORDINGS; i++) {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "levels/opnames/%u-%u.rec", number, i);
+            u64 size;
+            u8 *memory = read_test_file(filename, &size);
+            if (!memory) break;
+            count++;
+
+            Test_Playback reference = run_test_playback(&level, memory, size, fps_list[0]);
+            for (u32 f = 0; f < fps_count; f++) {
+                Test_Playback result = (f == 0) ? reference
+                                                : run_test_playback(&level, memory, size,
+                                                                    fps_list[f]);
+                if (!result.verified || result.wrong_frames || (result.trace != reference.trace) ||
+                    (result.ticks != reference.ticks)) {
+                    printf("fps: %s bij %u fps (0 is wisselend): %s, %u frames met het verkeerde "
+                           "aantal ticks, %u ticks waar %u fps er %u had\n",
+                           filename, fps_list[f], result.verified ? "klopt" : "klopt niet",
+                           result.wrong_frames, result.ticks, fps_list[0], reference.ticks);
+                    differences++;
+                }
+            }
+            ticks += reference.ticks;
+            free(memory);
+        }
+
+        printf("fps: level %u: %u opnames, %u ticks, %u verschillen\n", number, count, ticks,
+               differences);
+        if (!count || differences) failures++;
+        free_test_level(&level);
+    }
+    return failures == 0;
+}
+
+// NOTE: Uitleg sweep test.
+// Met de broadphase (zie de uitleg in sim.cpp) moet update_player_position precies hetzelfde doen
+// als wanneer hij alle tiles in het vak bekijkt. Dat controleren we op drie manieren:
+// - Hele pogingen op de levels van het spel, met en zonder broadphase, met dezelfde hash over
+//   alle ticks als de fps test.
+// - Losse aanroepen op de levels van het spel met spelers op willekeurige plekken en snelheden tot
+//   SWEEP_TEST_MAX_SPEED, veel sneller dan je in het spel haalt.
+// - Dezelfde soort aanroepen op een hoog synthetisch level (zie make_sweep_test_tiles), waarbij we
+//   ook meten hoe lang een aanroep duurt. Dat is de benchmark: snelle vallen, snelle schuine
+//   sprongen en gewone snelheden uit het spel.
+// De speler en de Collision moeten bit voor bit gelijk zijn.
+//
+// Bij al die aanroepen, en bij elke tick van de pogingen, vergelijken we ook met
+// update_edges_test_position: update_player_position zoals hij was voor de muur kernels, met
+// test_edges_wall per muur van elke tile. De grond heeft daar ook muren tussen twee tiles in, en
+// de volgorde van de muren bepaalt welke botsing wint. Zo merk je het als een verandering aan de
+// botsingen iets anders doet dan de oude code, ook als de opnames in levels/opnames opnieuw zijn
+// gemaakt.
+#define SWEEP_TEST_ATTEMPTS 16
+#define SWEEP_TEST_CALLS 20000
+#define SWEEP_TEST_MAX_SPEED 60000.0f
+#define SWEEP_BENCH_PLAYERS 4096
+#define SWEEP_BENCH_RUNS 16
+
+// Een getal van min tot max.
+static f32 next_test_float(u32 *state, f32 min, f32 max) {
+    return min + (max - min) * ((f32)next_test_random(state) / 16777216.0f);
+}
+
+// Een hoog level van platforms van 3 tot 8 tiles, zoals packer -synthetic maar over de hele
+// hoogte, met hier en daar spikes.
+static u8 *make_sweep_test_tiles(u32 width, u32 height) {
+    u8 *tiles = (u8 *)calloc((u64)width * height, 1);
+    u32 state = 1;
+    for (u32 x = 0; x < width; x++) tiles[x] = GROUND_TILE;
+    for (u32 y = 3; y + 1 < height; y += 2 + next_test_random(&state) % 4) {
+        for (u32 x = next_test_random(&state) % 10; x + 8 < width;
+             x += 6 + next_test_random(&state) % 9) {
+            u32 length = 3 + next_test_random(&state) % 6;
+            for (u32 i = 0; i < length; i++) tiles[(u64)y * width + x + i] = GROUND_TILE;
+            if (next_test_random(&state) % 4 == 0) tiles[(u64)(y + 1) * width + x] = SPIKES_TILE;
+        }
+    }
+    tiles[width + 2] = START_TILE;
+    return tiles;
+}
+
+enum Sweep_Test_Kind {
+    SWEEP_FALL,
+    SWEEP_DIAGONAL,
+    SWEEP_PLAY,
+};
+
+// Een speler ergens op de map, met een snelheid die bij kind past.
+static Player_Body make_sweep_test_player(u32 *state, Tile_Map *map, Sweep_Test_Kind kind) {
+    Player_Body player = {};
+    player.width = 31 * 3;
+    player.height = 56 * 3;
+    player.max_speed = 750.0f;
+
+    f32 tile_size = (f32)map->tile_size;
+    player.position.x = next_test_float(state, -2.0f, (f32)map->width + 2.0f) * tile_size;
+    player.position.y = next_test_float(state, -2.0f, (f32)map->height + 2.0f) * tile_size;
+
+    if (kind == SWEEP_FALL) {
+        player.velocity.x = next_test_float(state, -750.0f, 750.0f);
+        player.velocity.y = -next_test_float(state, 5000.0f, SWEEP_TEST_MAX_SPEED);
+    } else if (kind == SWEEP_DIAGONAL) {
+        f32 speed = next_test_float(state, 5000.0f, SWEEP_TEST_MAX_SPEED);
+        Vector2f direction =
+            Vector2f(next_test_float(state, -1.0f, 1.0f), next_test_float(state, -1.0f, 1.0f));
+        player.velocity = direction.normalize() * speed;
+    } else {
+        player.velocity.x = next_test_float(state, -750.0f, 750.0f);
+        player.velocity.y = next_test_float(state, -1500.0f, 1500.0f);
+    }
+
+    // Zwaartekracht, lopen, en soms de sprong van simulate_tick.
+    player.acceleration.x = next_test_float(state, -3000.0f, 3000.0f);
+    player.acceleration.y = (next_test_random(state) % 8 == 0) ? 1200.0f / SIM_DELTA_TIME
+                                                                : -1500.0f;
+    return player;
+}
+
+static bool is_same_collision(Collision a, Collision b) {
+    return (a.tile == b.tile) && (a.on_ground == b.on_ground) && (a.coin_index == b.coin_index);
+}
+
+// De oude botsing met een muur, zie update_edges_test_position.
+static bool test_edges_wall(f32 *t_lowest, f32 wall_coord, f32 wall_min, f32 wall_max, f32 rel_x,
+                            f32 rel_y, f32 delta_x, f32 delta_y) {
+    f32 t_epsilon = 0.01f;
+
+    if (delta_x != 0.0f) {
+        // Reken uit wanneer de speler de muur raakt coordinaat.
+        f32 t_result = (wall_coord - rel_x) / delta_x;
+
+        // We willen alleen de dichstbijzijnde botsing, dus slaan we telkens de laagste tijd op.
+        if ((t_result < *t_lowest) && (t_result >= 0)) {
+            // Check of de y coordinaat ook op de muur ligt.
+            f32 y = rel_y + t_result * delta_y;
+            if ((y >= wall_min) && (y <= wall_max)) {
+                *t_lowest = maximum(0.0f, t_result - t_epsilon);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static Collision update_edges_test_position(Tile_Map *tile_map, Player_Body *player,
+                                           f32 delta_time) {
+    Collision result = {};
+
+    Vector2f old_pos = player->position;
+
+    // Maak gebruik van de formules uit Binas Tabel 35.
+    // s = 0.5*a*t^2 + v*t + s
+    Vector2f new_pos = player->acceleration * delta_time * delta_time * .5f +
+                       player->velocity * delta_time + player->position;
+    // v = a*t + v
+    player->velocity = player->acceleration * delta_time + player->velocity;
+
+    Vector2f delta_pos = new_pos - old_pos;
+
+    Vector2f old_tile = Vector2f(old_pos.x, old_pos.y) / (f32)tile_map->tile_size;
+    Vector2f new_tile = Vector2f(new_pos.x, new_pos.y) / (f32)tile_map->tile_size;
+
+    Vector2i min_tile =
+        Vector2i((i32)minimum(old_tile.x, new_tile.x), (i32)minimum(old_tile.y, new_tile.y));
+    Vector2i max_tile =
+        Vector2i((i32)maximum(old_tile.x, new_tile.x), (i32)maximum(old_tile.y, new_tile.y));
+
+    Vector2i player_tile_size = Vector2i((i32)(player->width / (f32)tile_map->tile_size) + 1,
+                                         (i32)(player->height / (f32)tile_map->tile_size) + 1);
+
+    min_tile = min_tile - player_tile_size;
+    max_tile = max_tile + player_tile_size;
+
+    // Alleen de tiles die op de map liggen.
+    i32 min_x = maximum(min_tile.x, 0);
+    i32 min_y = maximum(min_tile.y, 0);
+    i32 max_x = minimum(max_tile.x, tile_map->width - 1);
+    i32 max_y = minimum(max_tile.y, tile_map->height - 1);
+
+    // Dit is zijn de hoeken linksonder en rechtsboven ten opzichte van het midden van de tile.
+    Vector2f diameter = Vector2f((f32)tile_map->tile_size + player->width,
+                                 (f32)tile_map->tile_size + player->height);
+    Vector2f min_corner = diameter * -0.5f;
+    Vector2f max_corner = diameter * 0.5f;
+
+    f32 t_remaining = 1.0f;
+
+    // TODO(Kay Verbruggen): Hoe vaak moeten we deze loop uitvoeren.
+    for (i32 i = 0; (i < 4) && (t_remaining > 0.0f); i++) {
+        f32 t_lowest = 1.0f;
+        Vector2f normal = Vector2f();
+
+        // Loop door alle mogelijke tiles heen die iets zijn. Met de bitsets van de tile map slaan
+        // we de lege tiles in een rij in een keer over.
+        for (i32 tile_y = min_y; tile_y <= max_y; tile_y++) {
+            for (i32 word = min_x / 64; word <= max_x / 64; word++) {
+                u64 bits = get_tile_row_bits(tile_map, tile_y, word, min_x, max_x);
+                unsigned long bit;
+                while (_BitScanForward64(&bit, bits)) {
+                    bits &= bits - 1;
+                    i32 tile_x = word * 64 + (i32)bit;
+                    u8 tile = get_tile(tile_map, tile_x, tile_y);
+
+                    // Reken het midden van de tile uit, en de positie van de speler ten
+                    // opzichte van dat midden.
+                    Vector2f tile_center =
+                        Vector2f((f32)tile_x, (f32)tile_y) * (f32)tile_map->tile_size;
+                    Vector2f rel_pos = player->position - tile_center;
+
+                    if ((tile == COIN_TILE) || (tile == DEATH_TILE) || (tile == SPIKES_TILE) ||
+                        (tile == END_TILE)) {
+                        Vector2f temp_max_corner = max_corner;
+                        Vector2f temp_min_corner = min_corner;
+                        if (tile == SPIKES_TILE) {
+                            temp_max_corner.y -= 40;
+
+                            temp_max_corner.x -= 15;
+                            temp_min_corner.x += 15;
+                        }
+
+                        if (test_edges_wall(&t_lowest, temp_min_corner.x, temp_min_corner.y,
+                                            temp_max_corner.y, rel_pos.x, rel_pos.y, delta_pos.x,
+                                            delta_pos.y) ||
+                            test_edges_wall(&t_lowest, temp_max_corner.x, temp_min_corner.y,
+                                            temp_max_corner.y, rel_pos.x, rel_pos.y, delta_pos.x,
+                                            delta_pos.y) ||
+                            test_edges_wall(&t_lowest, temp_min_corner.y, temp_min_corner.x,
+                                            temp_max_corner.x, rel_pos.y, rel_pos.x, delta_pos.y,
+                                            delta_pos.x) ||
+                            test_edges_wall(&t_lowest, temp_max_corner.y, temp_min_corner.x,
+                                            temp_max_corner.x, rel_pos.y, rel_pos.x, delta_pos.y,
+                                            delta_pos.x)) {
+                            result.tile |= tile;
+
+                            if (tile == COIN_TILE) {
+                                set_tile(tile_map, tile_x, tile_y, EMPTY_TILE);
+                                result.coin_index = tile_y * tile_map->width + tile_x;
+                            }
+                        }
+                    } else if ((tile == GROUND_TILE)) {
+                        // Verticale muren.
+                        if (test_edges_wall(&t_lowest, min_corner.x, min_corner.y, max_corner.y,
+                                            rel_pos.x, rel_pos.y, delta_pos.x, delta_pos.y)) {
+                            normal = Vector2f(-1.0f, 0.0f);
+                            result.tile |= tile;
+                        }
+
+                        if (test_edges_wall(&t_lowest, max_corner.x, min_corner.y, max_corner.y,
+                                            rel_pos.x, rel_pos.y, delta_pos.x, delta_pos.y)) {
+                            normal = Vector2f(1.0f, 0.0f);
+                            result.tile |= tile;
+                        }
+
+                        // Horizontale muren.
+                        if (test_edges_wall(&t_lowest, min_corner.y, min_corner.x, max_corner.x,
+                                            rel_pos.y, rel_pos.x, delta_pos.y, delta_pos.x)) {
+                            normal = Vector2f(0.0f, -1.0f);
+                            result.tile |= tile;
+                        }
+
+                        if (test_edges_wall(&t_lowest, max_corner.y, min_corner.x, max_corner.x,
+                                            rel_pos.y, rel_pos.x, delta_pos.y, delta_pos.x)) {
+                            normal = Vector2f(0.0f, 1.0f);
+                            result.on_ground = true;
+                            result.tile |= tile;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (normal == Vector2f()) {
+            player->position = player->position + delta_pos;
+            // t_remaining = 0;
+        } else {
+            player->position = player->position + delta_pos * t_lowest;
+            player->velocity = player->velocity - normal * dot(player->velocity, normal);
+            player->acceleration =
+                player->acceleration - normal * dot(player->acceleration, normal);
+            delta_pos = delta_pos - normal * dot(delta_pos, normal);
+        }
+        t_remaining -= t_lowest * t_remaining;
+    }
+
+    return result;
+}
+
+// Doe update_player_position en update_edges_test_position vanaf player. Een munt die geraakt wordt
+// leggen we weer terug, dan kan dit ook midden in een poging.
+static bool is_same_as_edges(Tile_Map *map, Player_Body *player) {
+    Player_Body result = *player;
+    Player_Body reference = *player;
+
+    Collision a = update_player_position(map, &result, SIM_DELTA_TIME);
+    if (a.tile & COIN_TILE) {
+        set_tile(map, a.coin_index % map->width, a.coin_index / map->width, COIN_TILE);
+    }
+    Collision b = update_edges_test_position(map, &reference, SIM_DELTA_TIME);
+    if (b.tile & COIN_TILE) {
+        set_tile(map, b.coin_index % map->width, b.coin_index / map->width, COIN_TILE);
+    }
+
+    return (memcmp(&result, &reference, sizeof(Player_Body)) == 0) && is_same_collision(a, b);
+}
+
+// Een poging met willekeurige input, voor de sweep test: de input verandert elke zesde seconde.
+// Springen gaat zoals in simulate_level: het blijft staan tot de eerstvolgende tick. We houden een
+// hash over hash_level_sim van elke tick bij, tot het level gehaald of af is of na
+// ATTEMPT_TEST_SECONDS. Met edge_differences tellen we ook de ticks waarin is_same_as_edges niet
+// klopt.
+#define ATTEMPT_TEST_SECONDS 60
+#define ATTEMPT_TEST_PARTS_PER_SECOND 6
+
+struct Test_Attempt {
+    u64 trace;
+    u32 ticks;
+    u32 events;
+};
+
+static Test_Attempt run_test_attempt(Test_Level *level, u32 seed, u32 *edge_differences = 0) {
+    Level_Sim sim;
+    begin_test_sim(&sim, level);
+    reset_test_level(level);
+
+    Test_Attempt result = {};
+    result.trace = 14695981039346656037ull;
+    u32 state = seed;
+    Sim_Input input = {};
+    u32 ticks_per_part = SIM_TICKS_PER_SECOND / ATTEMPT_TEST_PARTS_PER_SECOND;
+    for (u32 tick = 0; tick < SIM_TICKS_PER_SECOND * ATTEMPT_TEST_SECONDS; tick++) {
+        if (tick % ticks_per_part == 0) {
+            // Net als get_random_input in replay.cpp: vaak lopen, soms springen.
+            u32 direction = next_test_random(&state) % 4;
+            input.movement = (direction == 0) ? -1.0f : ((direction == 1) ? 0.0f : 1.0f);
+            if (next_test_random(&state) % 3 == 0) input.jump = true;
+            input.space = (next_test_random(&state) % 2) == 0;
+        }
+
+        if (edge_differences && !is_same_as_edges(&level->map, &sim.player)) {
+            (*edge_differences)++;
+        }
+        result.events |= simulate_tick(&sim, &input);
+        input.jump = false;
+
+        u64 hash = hash_level_sim(&sim);
+        result.trace = (result.trace ^ hash) * 1099511628211ull;
+        if (result.events & (SIM_COMPLETED | SIM_FAILED)) break;
+    }
+    result.ticks = sim.tick;
+    return result;
+}
+
+// Doe een update_player_position met en een zonder broadphase vanaf player.
+static bool is_same_sweep(Test_Level *level, Player_Body *player) {
+    Player_Body with = *player;
+    Player_Body without = *player;
+
+    use_sweep_broadphase = true;
+    Collision a = update_player_position(&level->map, &with, SIM_DELTA_TIME);
+    // Een munt is dan weg, die moet er bij de tweede keer weer zijn.
+    if (a.tile & COIN_TILE) reset_test_level(level);
+
+    use_sweep_broadphase = false;
+    Collision b = update_player_position(&level->map, &without, SIM_DELTA_TIME);
+    if (b.tile & COIN_TILE) reset_test_level(level);
+    use_sweep_broadphase = true;
+
+    return (memcmp(&with, &without, sizeof(Player_Body)) == 0) && is_same_collision(a, b);
+}
+
+// Hoeveel nanoseconden een update_player_position gemiddeld kost voor deze spelers.
+static f64 time_sweeps(Test_Level *level, Player_Body *players, u32 count, bool broadphase) {
+    use_sweep_broadphase = broadphase;
+    i64 start = get_time();
+    for (u32 run = 0; run < SWEEP_BENCH_RUNS; run++) {
+        for (u32 i = 0; i < count; i++) {
+            Player_Body player = players[i];
+            update_player_position(&level->map, &player, SIM_DELTA_TIME);
+        }
+    }
+    i64 end = get_time();
+    use_sweep_broadphase = true;
+    return (f64)(end - start) * 1000000000.0 / (f64)get_time_frequency() /
+           ((f64)SWEEP_BENCH_RUNS * count);
+}
+
+static bool test_sweep() {
+    u32 failures = 0;
+    for (u32 number = 1; number <= TEST_LEVELS; number++) {
+        Test_Level level;
+        if (!load_test_level(number, &level)) return false;
+
+        u32 attempt_differences = 0;
+        u32 edge_differences = 0;
+        for (u32 seed = 1; seed <= SWEEP_TEST_ATTEMPTS; seed++) {
+            use_sweep_broadphase = false;
+            Test_Attempt reference = run_test_attempt(&level, seed);
+            use_sweep_broadphase = true;
+            Test_Attempt result = run_test_attempt(&level, seed, &edge_differences);
+            if ((result.trace != reference.trace) || (result.ticks != reference.ticks)) {
+                attempt_differences++;
+            }
+        }
+
+        u32 state = number;
+        u32 call_differences = 0;
+        reset_test_level(&level);
+        for (u32 i = 0; i < SWEEP_TEST_CALLS; i++) {
+            Player_Body player =
+                make_sweep_test_player(&state, &level.map, (Sweep_Test_Kind)(i % 3));
+            if (!is_same_sweep(&level, &player)) call_differences++;
+            if (!is_same_as_edges(&level.map, &player)) edge_differences++;
+        }
+
+        printf("sweep: level %u: %u van %u pogingen en %u van %u aanroepen anders, %u keer anders "
+               "dan de oude muren\n",
+               number, attempt_differences, SWEEP_TEST_ATTEMPTS, call_differences,
+               SWEEP_TEST_CALLS, edge_differences);
+        if (attempt_differences || call_differences || edge_differences) failures++;
+        free_test_level(&level);
+    }
+
+    u32 width = 256;
+    u32 height = 1024;
+    u8 *tiles = make_sweep_test_tiles(width, height);
+    Test_Level level;
+    make_test_level(tiles, width, height, &level);
+    free(tiles);
+
+    const char *kind_names[] = {"snelle val", "snel schuin", "gewoon spelen"};
+    static Player_Body players[SWEEP_BENCH_PLAYERS];
+    for (u32 kind = 0; kind < 3; kind++) {
+        u32 state = 100 + kind;
+        u32 differences = 0;
+        for (u32 i = 0; i < SWEEP_BENCH_PLAYERS; i++) {
+            players[i] = make_sweep_test_player(&state, &level.map, (Sweep_Test_Kind)kind);
+            if (!is_same_sweep(&level, players + i)) differences++;
+            if (!is_same_as_edges(&level.map, players + i)) differences++;
+        }
+
+        f64 with = time_sweeps(&level, players, SWEEP_BENCH_PLAYERS, true);
+        f64 without = time_sweeps(&level, players, SWEEP_BENCH_PLAYERS, false);
+        printf("sweep: %ux%u %s: %.0fns met broadphase, %.0fns zonder, %u van %u anders\n",
+               width, height, kind_names[kind], with, without, differences,
+               SWEEP_BENCH_PLAYERS);
+        if (differences) failures++;
+    }
+    free_test_level(&level);
+    return failures == 0;
+}
+
+// NOTE: Uitleg levels test.
+// In levels/opnames staan per level een paar opnames (zie recording.cpp) van pogingen met
+// willekeurige input, gemaakt met replay -random -write. We spelen ze af op het ontwerp zoals het
+// nu is, en elke checkpoint moet kloppen: zo weet je dat een verandering aan de natuurkunde of de
+// botsingen niks aan de levels van het spel verandert. Verandert er wel iets en is dat de
+// bedoeling, maak dan nieuwe opnames en zeg in de commit waarom. De opnames zelf komen uit de code
+// die je aan het veranderen bent, daarom vergelijkt de sweep test ook nog met de oude muren.
+static bool test_levels() {
+    u32 failures = 0;
+    for (u32 number = 1; number <= TEST_LEVELS; number++) {
+        Test_Level level;
+        if (!load_test_level(number, &level)) return false;
+
+        u32 count = 0;
+        u32 verified = 0;
+        u32 checkpoints = 0;
+        for (u32 i = 1; i <= TEST_MAX_RECORDINGS; i++) {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "levels/opnames/%u-%u.rec", number, i);
+            u64 size;
+            u8 *memory = read_test_file(filename, &size);
+            if (!memory) break;
+            count++;
+
+            Playback playback;
+            if (!begin_playback(&playback, memory, size)) {
+                printf("levels: %s is geen geldige opname\n", filename);
+                free(memory);
+                continue;
+            }
+            if (!is_recording_of_level(&playback, &level.map)) {
+                printf("levels: %s is op een ander ontwerp opgenomen\n", filename);
+                free(memory);
+                continue;
+            }
+
+            Level_Sim sim;
+            begin_test_sim(&sim, &level);
+            reset_test_level(&level);
+            Sim_Input input;
+            while (play_tick(&playback, &sim, &input)) {
+                simulate_tick(&sim, &input);
+            }
+            if (finish_playback(&playback, &sim)) {
+                verified++;
+            } else {
+                printf("levels: %s klopt niet meer vanaf tick %u\n", filename,
+                       playback.mismatches ? playback.first_mismatch : sim.tick);
+            }
+            checkpoints += playback.checkpoints;
+            free(memory);
+        }
+
+        printf("levels: level %u: %u van %u opnames kloppen, %u checkpoints\n", number, verified,
+               count, checkpoints);
+        if (!count || (verified != count)) failures++;
+        free_test_level(&level);
+    }
+    return failures == 0;
+}
+
+// NOTE: Uitleg tile changes test.
+// In het spel kan de level streamer een chunk met een opgepakte munt weg doen. Als hij de chunk
+// opnieuw uitpakt, zet apply_tile_changes terug wat set_tile had veranderd. De levels van het spel
+// hebben maar een munt, dus we maken een level met munten in alle TILES_TEST_CHUNKS chunks, veel
+// meer dan de LEVEL_CHUNK_SLOTS plekken van de streamer. We pakken alle munten op, pakken alle
+// chunks opnieuw uit zoals de streamer dat doet, en dan moeten de munten weg zijn en de rest
+// hetzelfde. Daarna leggen we de helft terug, zoals bij doodgaan, en doen we dat nog een keer.
+#define TILES_TEST_CHUNKS 8
+
+// Pak alle chunks opnieuw uit, zet de veranderingen terug, en tel de tiles die anders zijn dan
+// expected.
+static u32 count_changed_test_tiles(Test_Level *level, u8 *expected) {
+    reset_test_level(level);
+    Tile_Map *map = &level->map;
+    for (i32 i = 0; i < map->chunks_x * map->chunks_y; i++) {
+        if (map->chunks[i] != &empty_level_chunk) apply_tile_changes(map, map->chunks[i]);
+    }
+
+    u32 result = 0;
+    for (i32 y = 0; y < map->height; y++) {
+        for (i32 x = 0; x < map->width; x++) {
+            result += get_tile(map, x, y) != expected[y * map->width + x];
+        }
+    }
+    return result;
+}
+
+static bool test_tile_changes() {
+    u32 size = TILES_TEST_CHUNKS * LEVEL_CHUNK_TILES;
+    u8 *tiles = (u8 *)calloc((u64)size * size, 1);
+    u8 *expected = (u8 *)malloc((u64)size * size);
+    u32 state = 1;
+    u32 coin_count = 0;
+    for (u32 x = 0; x < size; x++) tiles[x] = GROUND_TILE;
+    for (u32 y = 1; y < size; y++) {
+        for (u32 x = 0; x < size; x++) {
+            if (next_test_random(&state) % 97 == 0) {
+                tiles[y * size + x] = COIN_TILE;
+                coin_count++;
+            } else if (next_test_random(&state) % 5 == 0) {
+                tiles[y * size + x] = GROUND_TILE;
+            }
+        }
+    }
+    tiles[size + 2] = START_TILE;
+
+    Test_Level level;
+    make_test_level(tiles, size, size, &level);
+    Tile_Map *map = &level.map;
+    map->changes = (Tile_Change *)malloc(sizeof(Tile_Change) * coin_count);
+    map->max_changes = coin_count;
+
+    memcpy(expected, tiles, (u64)size * size);
+    for (u32 i = 0; i < size * size; i++) {
+        if (tiles[i] != COIN_TILE) continue;
+        set_tile(map, (i32)(i % size), (i32)(i / size), EMPTY_TILE);
+        expected[i] = EMPTY_TILE;
+    }
+    u32 taken = count_changed_test_tiles(&level, expected);
+
+    u32 coin = 0;
+    for (u32 i = 0; i < size * size; i++) {
+        if ((tiles[i] != COIN_TILE) || (coin++ % 2)) continue;
+        set_tile(map, (i32)(i % size), (i32)(i / size), COIN_TILE);
+        expected[i] = COIN_TILE;
+    }
+    u32 returned = count_changed_test_tiles(&level, expected);
+
+    printf("tiles: %u munten in %u chunks, %u veranderingen, na oppakken %u en na terugleggen %u "
+           "tiles anders\n",
+           coin_count, TILES_TEST_CHUNKS * TILES_TEST_CHUNKS, map->change_count, taken, returned);
+
+    free(map->changes);
+    free_test_level(&level);
+    free(expected);
+    free(tiles);
+    return !taken && !returned && (map->change_count == coin_count);
+}
+
+typedef bool Test_Proc();
+
+struct Test {
+    const char *name;
+    Test_Proc *proc;
+};
+
+static Test tests[] = {
+    {"blit", test_blit},
+    {"math", test_math},
+    {"present", test_present},
+    {"fps", test_fps},
+    {"sweep", test_sweep},
+    {"levels", test_levels},
+    {"tiles", test_tile_changes},
+};
+
+int main(int argument_count, char **arguments) {
+    const char *prefix = (argument_count > 1) ? arguments[1] : "";
+
+    u32 failed = 0;
+    u32 run = 0;
+    for (u32 i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        if (strncmp(tests[i].name, prefix, strlen(prefix)) != 0) continue;
+
+        run++;
+        if (!tests[i].proc()) {
+            printf("%s KLOPT NIET\n", tests[i].name);
+            failed++;
+        }
+    }
+
+    printf("%u van %u tests kloppen\n", run - failed, run);
+    return (failed || !run) ? 1 : 0;
+}
@@ -0,0 +1,677 @@
+// De sprites van de tiles zijn voor elk level hetzelfde, dus die laden we maar een keer.
+struct Tile_Sprites {
+    Sprite ground, end, coin, spikes;
+};
+
+enum Level_Chunk_State {
+    CHUNK_FREE,
+    CHUNK_QUEUED,
+    CHUNK_LOADING,
+    CHUNK_READY,
+    CHUNK_RESIDENT,
+};
+
+// NOTE: Uitleg level streamer.
+// De chunks van alle maps delen LEVEL_CHUNK_SLOTS plekken, die we een keer bij het opstarten
+// maken. Hoe groot een level ook is, meer geheugen gebruiken de tiles dus nooit. Elke frame vraagt
+// update_level_streaming de chunks rond het beeld aan, en een eigen thread pakt die uit. Is een
+// plek nodig, dan gaat de chunk die het langst niet gebruikt is eruit.
+//
+// Vraagt de game een tile uit een chunk die nog niet klaar is, dan wachten we (of pakken we hem
+// zelf uit). Zijn alle plekken bezet, dan pakken we een plek af van een chunk die nog niemand
+// gebruikt, of wachten we tot de worker er een af heeft. Dat is langzamer, maar zo zien de
+// botsingen en het tekenen altijd precies dezelfde tiles als wanneer de hele map in het geheugen
+// zou staan.
+//
+// Een opgepakte munt staat ook in de lijst changes van de map (zie set_tile). Die zetten we terug
+// als een chunk resident wordt, dus elke chunk mag eruit, ook een chunk waar een munt uit is.
+//
+// Alleen de main thread zet een chunk op CHUNK_QUEUED, CHUNK_RESIDENT of CHUNK_FREE, en alleen
+// de main thread gebruikt chunks. De worker zet een chunk van CHUNK_QUEUED via CHUNK_LOADING op
+// CHUNK_READY, binnen lock.
+#define LEVEL_CHUNK_SLOTS 32
+// Hoeveel tiles rond het beeld we alvast laden.
+#define LEVEL_STREAM_MARGIN 32
+// Zoveel veranderde tiles (munten) per map onthouden we, zie set_tile.
+#define LEVEL_TILE_CHANGES 4096
+
+struct Level_Streamer {
+    Level_Chunk *slots;
+
+    u32 queue[LEVEL_CHUNK_SLOTS];
+    u32 queue_read;
+    u32 queue_write;
+    u32 queue_count;
+
+    CRITICAL_SECTION lock;
+    HANDLE semaphore;
+    // De worker zet deze elke keer als hij een chunk op CHUNK_READY heeft gezet.
+    HANDLE chunk_ready;
+    HANDLE thread;
+    bool quit;
+
+    u32 frame;
+
+#if PROFILE
+    u32 streamed;
+    u32 loaded_now;
+    u32 evicted;
+#endif
+};
+
+static Level_Streamer level_streamer;
+
+// Pak de chunk uit het level bestand uit. Dit gebeurt op de worker of op de main thread.
+static void fill_level_chunk(Level_Chunk *chunk) {
+    Tile_Map *map = chunk->map;
+    if (!decode_tile_chunk(map->level, chunk->index % map->chunks_x, chunk->index / map->chunks_x,
+                           chunk)) {
+        OutputDebugStringA("Een chunk van het level is kapot, die blijft leeg.\n");
+    }
+}
+
+static DWORD WINAPI level_streamer_proc(LPVOID parameter) {
+    Level_Streamer *streamer = (Level_Streamer *)parameter;
+
+    for (;;) {
+        WaitForSingleObject(streamer->semaphore, INFINITE);
+
+        EnterCriticalSection(&streamer->lock);
+        if (streamer->quit) {
+            LeaveCriticalSection(&streamer->lock);
+            return 0;
+        }
+        Level_Chunk *chunk = streamer->slots + streamer->queue[streamer->queue_read];
+        streamer->queue_read = (streamer->queue_read + 1) % LEVEL_CHUNK_SLOTS;
+        streamer->queue_count--;
+
+        // Misschien heeft de main thread hem al zelf uitgepakt, of is hij niet meer nodig.
+        bool load = (chunk->state == CHUNK_QUEUED);
+        if (load) chunk->state = CHUNK_LOADING;
+        LeaveCriticalSection(&streamer->lock);
+
+        if (load) {
+            fill_level_chunk(chunk);
+            InterlockedExchange(&chunk->state, CHUNK_READY);
+            SetEvent(streamer->chunk_ready);
+        }
+    }
+}
+
+static void initialize_level_streamer() {
+    level_streamer.slots = push_array(&permanent_arena, Level_Chunk, LEVEL_CHUNK_SLOTS);
+    InitializeCriticalSection(&level_streamer.lock);
+    level_streamer.semaphore = CreateSemaphoreA(0, 0, LEVEL_CHUNK_SLOTS + 1, 0);
+    level_streamer.chunk_ready = CreateEventA(0, FALSE, FALSE, 0);
+    level_streamer.thread = CreateThread(0, 0, level_streamer_proc, &level_streamer, 0, 0);
+}
+
+// Dit moet na close_tile_map van alle maps.
+static void close_level_streamer() {
+    EnterCriticalSection(&level_streamer.lock);
+    level_streamer.quit = true;
+    LeaveCriticalSection(&level_streamer.lock);
+    ReleaseSemaphore(level_streamer.semaphore, 1, 0);
+    WaitForSingleObject(level_streamer.thread, INFINITE);
+
+    CloseHandle(level_streamer.thread);
+    CloseHandle(level_streamer.semaphore);
+    CloseHandle(level_streamer.chunk_ready);
+    DeleteCriticalSection(&level_streamer.lock);
+}
+
+// De plek waar deze chunk van de map staat of geladen wordt, of 0.
+static Level_Chunk *find_level_chunk(Tile_Map *map, u32 index) {
+    for (u32 i = 0; i < LEVEL_CHUNK_SLOTS; i++) {
+        Level_Chunk *chunk = level_streamer.slots + i;
+        if ((chunk->state != CHUNK_FREE) && (chunk->map == map) && (chunk->index == index)) {
+            return chunk;
+        }
+    }
+    return 0;
+}
+
+// Alle plekken zijn bezet, maar deze chunk is nu nodig. Een chunk die nog in de rij staat of
+// klaar is maar nog niet resident, heeft nog niemand gebruikt, dus die plek pakken we af. De
+// worker slaat hem dan over, zie level_streamer_proc. Wordt er alleen nog geladen, dan wachten we
+// tot de worker klaar is. Geeft 0 terug als alle plekken resident zijn.
+static Level_Chunk *steal_level_chunk() {
+    for (;;) {
+        Level_Chunk *result = 0;
+        bool loading = false;
+
+        EnterCriticalSection(&level_streamer.lock);
+        for (u32 i = 0; i < LEVEL_CHUNK_SLOTS; i++) {
+            Level_Chunk *chunk = level_streamer.slots + i;
+            if ((chunk->state == CHUNK_QUEUED) || (chunk->state == CHUNK_READY)) {
+                chunk->state = CHUNK_FREE;
+                result = chunk;
+                break;
+            }
+            if (chunk->state == CHUNK_LOADING) loading = true;
+        }
+        LeaveCriticalSection(&level_streamer.lock);
+
+        if (result || !loading) return result;
+        WaitForSingleObject(level_streamer.chunk_ready, INFINITE);
+    }
+}
+
+// Zoek een vrije plek, of maak er een vrij door de chunk die het langst niet gebruikt is eruit te
+// halen. Chunks die nog geladen worden laten we staan. Met needed is de chunk nu nodig, dan pakken
+// we als het moet een plek af met steal_level_chunk, en krijgen we dus altijd een plek.
+static Level_Chunk *allocate_level_chunk(Tile_Map *map, u32 index, bool needed) {
+    Level_Chunk *result = 0;
+    for (u32 i = 0; i < LEVEL_CHUNK_SLOTS; i++) {
+        Level_Chunk *chunk = level_streamer.slots + i;
+        if (chunk->state == CHUNK_FREE) {
+            result = chunk;
+            break;
+        }
+        if ((chunk->state == CHUNK_RESIDENT) &&
+            (!result || (chunk->last_used < result->last_used))) {
+            result = chunk;
+        }
+    }
+    if (!result && needed) {
+        result = steal_level_chunk();
+#if PROFILE
+        if (result) level_streamer.evicted++;
+#endif
+    }
+    if (!result) return 0;
+
+    if (result->state == CHUNK_RESIDENT) {
+        result->map->chunks[result->index] = 0;
+#if PROFILE
+        level_streamer.evicted++;
+#endif
+    }
+    result->map = map;
+    result->index = index;
+    result->last_used = level_streamer.frame;
+    return result;
+}
+
+static void make_level_chunk_resident(Level_Chunk *chunk) {
+    apply_tile_changes(chunk->map, chunk);
+    chunk->state = CHUNK_RESIDENT;
+    chunk->map->chunks[chunk->index] = chunk;
+}
+
+// De chunk is nu nodig en staat nog niet in het geheugen. Wordt hij al geladen, dan wachten we
+// daarop, anders pakken we hem hier zelf uit.
+static Level_Chunk *load_level_chunk_now(Tile_Map *map, u32 index) {
+    Level_Chunk *chunk = find_level_chunk(map, index);
+    if (!chunk) {
+        chunk = allocate_level_chunk(map, index, true);
+        chunk->state = CHUNK_QUEUED;
+    }
+
+    EnterCriticalSection(&level_streamer.lock);
+    bool load = (chunk->state == CHUNK_QUEUED);
+    if (load) chunk->state = CHUNK_LOADING;
+    LeaveCriticalSection(&level_streamer.lock);
+
+    if (load) {
+        fill_level_chunk(chunk);
+#if PROFILE
+        level_streamer.loaded_now++;
+#endif
+    } else {
+        while (chunk->state != CHUNK_READY) {
+            WaitForSingleObject(level_streamer.chunk_ready, INFINITE);
+        }
+    }
+    make_level_chunk_resident(chunk);
+    return chunk;
+}
+
+static Level_Chunk *get_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y) {
+    u32 index = (u32)(chunk_y * map->chunks_x + chunk_x);
+    Level_Chunk *chunk = map->chunks[index];
+    if (!chunk) {
+        chunk = load_level_chunk_now(map, index);
+    }
+    chunk->last_used = level_streamer.frame;
+    return chunk;
+}
+
+// set_tile onthoudt zelf wat hij verandert in de changes van de map, dus de chunk mag daarna
+// gewoon weer weg.
+static Level_Chunk *get_writable_level_chunk(Tile_Map *map, i32 chunk_x, i32 chunk_y) {
+    Level_Chunk *chunk = get_level_chunk(map, chunk_x, chunk_y);
+    return (chunk == &empty_level_chunk) ? 0 : chunk;
+}
+
+// Roep dit elke frame aan voor de map die we spelen, met de camera in design pixels.
+static void update_level_streaming(Tile_Map *map, Vector2f camera) {
+    level_streamer.frame++;
+
+    // Wat de worker klaar heeft kunnen we nu gebruiken.
+    for (u32 i = 0; i < LEVEL_CHUNK_SLOTS; i++) {
+        Level_Chunk *chunk = level_streamer.slots + i;
+        if (chunk->state == CHUNK_READY) {
+            make_level_chunk_resident(chunk);
+#if PROFILE
+            level_streamer.streamed++;
+#endif
+        }
+    }
+    if (!map->chunks) return;
+
+    i32 min_x = maximum((i32)(camera.x / (f32)map->tile_size) - LEVEL_STREAM_MARGIN, 0);
+    i32 min_y = maximum((i32)(camera.y / (f32)map->tile_size) - LEVEL_STREAM_MARGIN, 0);
+    i32 max_x = minimum((i32)((camera.x + DESIGN_WIDTH) / (f32)map->tile_size) +
+                            LEVEL_STREAM_MARGIN, map->width - 1);
+    i32 max_y = minimum((i32)((camera.y + DESIGN_HEIGHT) / (f32)map->tile_size) +
+                            LEVEL_STREAM_MARGIN, map->height - 1);
+    if ((min_x > max_x) || (min_y > max_y)) return;
+
+    i32 min_chunk_x = min_x >> LEVEL_CHUNK_SHIFT;
+    i32 min_chunk_y = min_y >> LEVEL_CHUNK_SHIFT;
+    i32 max_chunk_x = max_x >> LEVEL_CHUNK_SHIFT;
+    i32 max_chunk_y = max_y >> LEVEL_CHUNK_SHIFT;
+
+    // Eerst alles wat er al is als gebruikt markeren, zodat we dat niet wegdoen voor de rest.
+    for (i32 chunk_y = min_chunk_y; chunk_y <= max_chunk_y; chunk_y++) {
+        for (i32 chunk_x = min_chunk_x; chunk_x <= max_chunk_x; chunk_x++) {
+            Level_Chunk *chunk = map->chunks[chunk_y * map->chunks_x + chunk_x];
+            if (chunk) chunk->last_used = level_streamer.frame;
+        }
+    }
+
+    for (i32 chunk_y = min_chunk_y; chunk_y <= max_chunk_y; chunk_y++) {
+        for (i32 chunk_x = min_chunk_x; chunk_x <= max_chunk_x; chunk_x++) {
+            u32 index = (u32)(chunk_y * map->chunks_x + chunk_x);
+            if (map->chunks[index] || find_level_chunk(map, index)) continue;
+            if (level_streamer.queue_count == LEVEL_CHUNK_SLOTS) return;
+
+            Level_Chunk *chunk = allocate_level_chunk(map, index, false);
+            if (!chunk) return;
+
+            EnterCriticalSection(&level_streamer.lock);
+            chunk->state = CHUNK_QUEUED;
+            level_streamer.queue[level_streamer.queue_write] = (u32)(chunk - level_streamer.slots);
+            level_streamer.queue_write = (level_streamer.queue_write + 1) % LEVEL_CHUNK_SLOTS;
+            level_streamer.queue_count++;
+            LeaveCriticalSection(&level_streamer.lock);
+            ReleaseSemaphore(level_streamer.semaphore, 1, 0);
+        }
+    }
+}
+
+static void log_level_streamer() {
+#if PROFILE
+    u32 resident = 0;
+    for (u32 i = 0; i < LEVEL_CHUNK_SLOTS; i++) {
+        if (level_streamer.slots[i].state == CHUNK_RESIDENT) resident++;
+    }
+    char text[256];
+    StringCbPrintfA(text, 256,
+                    "Level chunks: %u/%u in gebruik, %u gestreamd, %u direct geladen, %u "
+                    "weggedaan\n",
+                    resident, LEVEL_CHUNK_SLOTS, level_streamer.streamed,
+                    level_streamer.loaded_now, level_streamer.evicted);
+    OutputDebugStringA(text);
+#endif
+}
+
+static void add_tile_sprite_jobs(Job_Batch *batch, Tile_Sprites *sprites) {
+    add_sprite_job(batch, "assets\\grass.bmp", &sprites->ground);
+    add_sprite_job(batch, "assets\\door.bmp", &sprites->end);
+    add_sprite_job(batch, "assets\\coin.bmp", &sprites->coin);
+    add_sprite_job(batch, "assets\\spikes.bmp", &sprites->spikes);
+}
+
+// Geeft in level_filename de naam van het level bestand bij een ontwerp, dus "levels\1.lvl" bij
+// "levels\1.bmp".
+static void get_level_filename(const char *filename, char *level_filename, u32 size) {
+    StringCbCopyA(level_filename, size, filename);
+    char *extension = strrchr(level_filename, '.');
+    if (extension) *extension = 0;
+    StringCbCatA(level_filename, size, ".lvl");
+}
+
+static bool has_level_file(const char *filename) {
+    char level_filename[MAX_PATH];
+    get_level_filename(filename, level_filename, MAX_PATH);
+    return GetFileAttributesA(level_filename) != INVALID_FILE_ATTRIBUTES;
+}
+
+// Zet een ontwerp om naar een level bestand in de level arena, net als de packer doet.
+static Level_Header *convert_level_design(const char *filename) {
+    Asset_Handle design_handle = acquire_sprite(filename, false, false);
+    Sprite *design = get_sprite(design_handle);
+    if (!design) {
+        release_asset(&design_handle);
+        return 0;
+    }
+
+    Level_Header *result = 0;
+    u8 *tiles = push_array(&frame_arena, u8, design->width * design->height);
+    u8 *memory = push_array(&level_arena, u8, get_level_size_bound(design->width, design->height));
+    if (tiles && memory) {
+        for (u32 y = 0; y < design->height; y++) {
+            for (u32 x = 0; x < design->width; x++) {
+                u32 color = design->pixels[design->pitch * y + x];
+                tiles[y * design->width + x] = get_design_tile(color);
+            }
+        }
+        encode_level(tiles, design->width, design->height, memory);
+        result = (Level_Header *)memory;
+    }
+
+    release_asset(&design_handle);
+    return result;
+}
+
+// Open het level bestand bij filename. Is dat er niet, dan zetten we het ontwerp zelf om. De
+// chunks komen pas in het geheugen als de level streamer ze nodig heeft.
+static Tile_Map load_tile_map(const char *filename, Tile_Sprites *sprites) {
+    Tile_Map result = {};
+
+    char level_filename[MAX_PATH];
+    get_level_filename(filename, level_filename, MAX_PATH);
+    HANDLE file = CreateFileA(level_filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, 0);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER file_size;
+        HANDLE mapping = 0;
+        void *memory = 0;
+        if (GetFileSizeEx(file, &file_size)) {
+            mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        }
+        if (mapping) {
+            memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+
+        result.level = get_level_header(memory, (u64)file_size.QuadPart);
+        if (result.level) {
+            result.file = file;
+            result.mapping = mapping;
+        } else {
+            report_load_error("Level", "Het level bestand is kapot!", level_filename);
+            if (memory) UnmapViewOfFile(memory);
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            return result;
+        }
+    } else {
+        result.level = convert_level_design(filename);
+        if (!result.level) return result;
+    }
+
+    Level_Header *level = result.level;
+    result.width = (i32)level->width;
+    result.height = (i32)level->height;
+    result.chunks_x = (i32)level->chunks_x;
+    result.chunks_y = (i32)level->chunks_y;
+    result.tile_size = 96;
+    result.sprites = sprites;
+    result.start_pos = Vector2f(f32(level->start_x * result.tile_size),
+                                f32(level->start_y * result.tile_size + 40));
+
+    result.changes = push_array(&level_arena, Tile_Change, LEVEL_TILE_CHANGES);
+    if (result.changes) result.max_changes = LEVEL_TILE_CHANGES;
+
+    // Lege chunks hoeven we nooit te laden.
+    result.chunks = push_array(&level_arena, Level_Chunk *, result.chunks_x * result.chunks_y);
+    if (result.chunks) {
+        for (i32 chunk_y = 0; chunk_y < result.chunks_y; chunk_y++) {
+            for (i32 chunk_x = 0; chunk_x < result.chunks_x; chunk_x++) {
+                if (get_level_chunk_entry(level, chunk_x, chunk_y)->size == 0) {
+                    result.chunks[chunk_y * result.chunks_x + chunk_x] = &empty_level_chunk;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// Haal alle chunks van de map uit de level streamer en sluit het level bestand. Dit moet voordat
+// de level arena leeg gaat.
+static void close_tile_map(Tile_Map *tile_map) {
+    for (u32 i = 0; i < LEVEL_CHUNK_SLOTS; i++) {
+        Level_Chunk *chunk = level_streamer.slots + i;
+        if (chunk->map != tile_map) continue;
+
+        EnterCriticalSection(&level_streamer.lock);
+        if (chunk->state == CHUNK_QUEUED) chunk->state = CHUNK_FREE;
+        LeaveCriticalSection(&level_streamer.lock);
+        while (chunk->state == CHUNK_LOADING) {
+            WaitForSingleObject(level_streamer.chunk_ready, INFINITE);
+        }
+        chunk->state = CHUNK_FREE;
+        chunk->map = 0;
+    }
+
+    if (tile_map->mapping) {
+        UnmapViewOfFile(tile_map->level);
+        CloseHandle(tile_map->mapping);
+        CloseHandle(tile_map->file);
+    }
+    *tile_map = {};
+}
+
+// Geeft de sprite van een tile terug, en hoeveel pixels die omhoog of omlaag moet. Tiles zonder
+// sprite geven 0 terug.
+static Sprite *get_tile_sprite(Tile_Map *tile_map, u8 tile, i32 *y_offset) {
+    *y_offset = 0;
+
+    if (tile == GROUND_TILE) {
+        return &tile_map->sprites->ground;
+    } else if (tile == END_TILE) {
+        // TODO: Fix hardcoden van de deur offset op de y-as.
+        *y_offset = 60;
+        return &tile_map->sprites->end;
+    } else if (tile == COIN_TILE) {
+        return &tile_map->sprites->coin;
+    } else if (tile == SPIKES_TILE) {
+        *y_offset = -10;
+        return &tile_map->sprites->spikes;
+    }
+
+    return 0;
+}
+
+// NOTE: Uitleg chunks.
+// In plaats van elke frame elke tile los te tekenen, tekenen we de tiles van een stuk van de map
+// (een chunk van CHUNK_TILES bij CHUNK_TILES tiles) een keer in een eigen plaatje. Per frame hoeven
+// we dan alleen de paar chunks te tekenen die in beeld zijn. Een chunk wordt pas opnieuw getekend
+// als er een tile in verandert, bijvoorbeeld als een munt wordt opgepakt. We houden maar een paar
+// chunks tegelijk bij, de chunk die het langst niet in beeld is geweest wordt als eerste vervangen.
+#define CHUNK_TILES 8
+#define CHUNK_CACHE_SIZE 16
+
+// Sprites van tiles steken uit hun tile (de deur het meest), dus bij het tekenen van een chunk
+// moeten we ook de tiles van de buren meenemen.
+#define CHUNK_TILE_MARGIN 2
+
+struct Tile_Chunk {
+    Sprite sprite;
+    i32 chunk_x, chunk_y;
+    u32 last_used;
+    bool valid;
+    // De arena was vol toen we de pixels wilden maken. Dan tekenen we deze chunk niet, en
+    // proberen we het ook niet elke frame opnieuw (met elke keer een melding).
+    bool no_memory;
+};
+
+struct Tile_Chunk_Cache {
+    Tile_Chunk chunks[CHUNK_CACHE_SIZE];
+    // Aan de level_chunks pointer zien we of we nog dezelfde map tekenen.
+    Level_Chunk **level_chunks;
+    u32 frame;
+};
+
+// Geeft de plek van de linkeronderhoek van een chunk in de wereld terug, in pixels van de buffer.
+static Vector2i get_chunk_origin(Tile_Map *tile_map, i32 chunk_x, i32 chunk_y) {
+    i32 chunk_size = CHUNK_TILES * tile_map->tile_size;
+    return to_render_pixels(Vector2f((f32)(chunk_x * chunk_size - tile_map->tile_size / 2),
+                                     (f32)(chunk_y * chunk_size - tile_map->tile_size / 2)));
+}
+
+static void bake_tile_chunk(Tile_Map *tile_map, Tile_Chunk *chunk) {
+    // Door het afronden op de render resolutie zijn niet alle chunks precies even groot.
+    Vector2i origin = get_chunk_origin(tile_map, chunk->chunk_x, chunk->chunk_y);
+    Vector2i end = get_chunk_origin(tile_map, chunk->chunk_x + 1, chunk->chunk_y + 1);
+    u32 width = end.x - origin.x;
+    u32 height = end.y - origin.y;
+
+    if (!chunk->sprite.pixels) {
+        if (chunk->no_memory) return;
+
+        u32 max_size = to_render_pixels((f32)(CHUNK_TILES * tile_map->tile_size)) + 2;
+        // De chunks blijven bestaan tot het einde, ook als we een andere map tekenen.
+        chunk->sprite.pixels = push_array(&permanent_arena, u32, max_size * max_size);
+        if (!chunk->sprite.pixels) {
+            chunk->no_memory = true;
+            return;
+        }
+        chunk->sprite.bits_per_pixel = 32;
+    }
+    chunk->sprite.width = width;
+    chunk->sprite.height = height;
+    chunk->sprite.pitch = width;
+
+    if (chunk->sprite.row_spans) {
+        free_pages(chunk->sprite.row_spans);
+        chunk->sprite.row_spans = 0;
+        chunk->sprite.spans = 0;
+    }
+
+    // Alles transparant maken, zodat de achtergrond er straks doorheen komt.
+    memset(chunk->sprite.pixels, 0, sizeof(u32) * width * height);
+
+    Offscreen_Buffer target = {};
+    target.memory = chunk->sprite.pixels;
+    target.width = width;
+    target.height = height;
+    target.bytes_per_pixel = 4;
+    target.pitch = width * 4;
+
+    i32 min_x = maximum(chunk->chunk_x * CHUNK_TILES - CHUNK_TILE_MARGIN, 0);
+    i32 max_x = minimum((chunk->chunk_x + 1) * CHUNK_TILES + CHUNK_TILE_MARGIN, tile_map->width);
+    i32 min_y = maximum(chunk->chunk_y * CHUNK_TILES - CHUNK_TILE_MARGIN, 0);
+    i32 max_y = minimum((chunk->chunk_y + 1) * CHUNK_TILES + CHUNK_TILE_MARGIN, tile_map->height);
+
+    // Dezelfde volgorde als waarin we de tiles vroeger los tekenden, dus van boven naar beneden.
+    // Lege tiles slaan we over met de bitsets.
+    for (i32 y = max_y - 1; y >= min_y; y--) {
+        for (i32 word = min_x / 64; word <= (max_x - 1) / 64; word++) {
+            u64 bits = get_tile_row_bits(tile_map, y, word, min_x, max_x - 1);
+            unsigned long bit;
+            while (_BitScanForward64(&bit, bits)) {
+                bits &= bits - 1;
+                i32 x = word * 64 + (i32)bit;
+
+                i32 y_offset;
+                Sprite *sprite = get_tile_sprite(tile_map, get_tile(tile_map, x, y), &y_offset);
+                if (!sprite) continue;
+
+                // Precies dezelfde berekening als in draw_sprite, anders kloppen de pixels niet.
+                Vector2i center = to_render_pixels(Vector2f(
+                    (f32)(x * tile_map->tile_size), (f32)(y * tile_map->tile_size + y_offset)));
+                Vector2i half_size = Vector2i(sprite->width / 2, sprite->height / 2);
+                Vector2i min = center - half_size - origin;
+                Vector2i max = center + half_size - origin;
+                blit_sprite(&target, sprite, min, max, buffer_rect(&target));
+            }
+        }
+    }
+
+    build_sprite_spans(&chunk->sprite);
+    chunk->valid = true;
+}
+
+// Zorg dat de chunks waar deze tile in getekend wordt opnieuw worden getekend.
+static void invalidate_tile(Tile_Chunk_Cache *cache, Tile_Map *tile_map, i32 tile_index) {
+    i32 tile_x = tile_index % tile_map->width;
+    i32 tile_y = tile_index / tile_map->width;
+
+    for (u32 i = 0; i < CHUNK_CACHE_SIZE; i++) {
+        Tile_Chunk *chunk = cache->chunks + i;
+        if ((tile_x >= chunk->chunk_x * CHUNK_TILES - CHUNK_TILE_MARGIN) &&
+            (tile_x < (chunk->chunk_x + 1) * CHUNK_TILES + CHUNK_TILE_MARGIN) &&
+            (tile_y >= chunk->chunk_y * CHUNK_TILES - CHUNK_TILE_MARGIN) &&
+            (tile_y < (chunk->chunk_y + 1) * CHUNK_TILES + CHUNK_TILE_MARGIN)) {
+            chunk->valid = false;
+        }
+    }
+}
+
+static Tile_Chunk *get_tile_chunk(Tile_Chunk_Cache *cache, Tile_Map *tile_map, i32 chunk_x,
+                                  i32 chunk_y) {
+    Tile_Chunk *result = 0;
+    Tile_Chunk *oldest = cache->chunks;
+
+    for (u32 i = 0; i < CHUNK_CACHE_SIZE; i++) {
+        Tile_Chunk *chunk = cache->chunks + i;
+        if (chunk->sprite.pixels && (chunk->chunk_x == chunk_x) && (chunk->chunk_y == chunk_y)) {
+            result = chunk;
+            break;
+        }
+
+        if (chunk->last_used < oldest->last_used) {
+            oldest = chunk;
+        }
+    }
+
+    if (!result) {
+        result = oldest;
+        result->chunk_x = chunk_x;
+        result->chunk_y = chunk_y;
+        result->valid = false;
+    }
+
+    if (!result->valid) {
+        bake_tile_chunk(tile_map, result);
+    }
+
+    result->last_used = cache->frame;
+    return result;
+}
+
+static void draw_tile_map(Window *window, Tile_Chunk_Cache *cache, Tile_Map *tile_map,
+                          Vector2f camera) {
+    // Als we een andere map tekenen dan de vorige keer, kloppen de chunks niet meer.
+    if (cache->level_chunks != tile_map->chunks) {
+        cache->level_chunks = tile_map->chunks;
+        for (u32 i = 0; i < CHUNK_CACHE_SIZE; i++) {
+            cache->chunks[i].valid = false;
+            cache->chunks[i].last_used = 0;
+        }
+    }
+    cache->frame++;
+
+    i32 chunk_size = maximum(to_render_pixels((f32)(CHUNK_TILES * tile_map->tile_size)), 1);
+    i32 chunks_x = (tile_map->width + CHUNK_TILES - 1) / CHUNK_TILES;
+    i32 chunks_y = (tile_map->height + CHUNK_TILES - 1) / CHUNK_TILES;
+
+    // Alle chunks die (een deel van) het scherm raken. Sprites aan de rand van de map steken
+    // soms buiten de map uit, daarom kijken we ook naar een rij chunks rondom de map.
+    Vector2i view_min = to_render_pixels(camera);
+    Vector2i view_max = view_min + Vector2i(window->buffer.width, window->buffer.height);
+
+    i32 min_x = maximum(view_min.x / chunk_size - 1, -1);
+    i32 min_y = maximum(view_min.y / chunk_size - 1, -1);
+    i32 max_x = minimum(view_max.x / chunk_size + 1, chunks_x);
+    i32 max_y = minimum(view_max.y / chunk_size + 1, chunks_y);
+
+    for (i32 chunk_y = max_y; chunk_y >= min_y; chunk_y--) {
+        for (i32 chunk_x = min_x; chunk_x <= max_x; chunk_x++) {
+            Vector2i origin = get_chunk_origin(tile_map, chunk_x, chunk_y);
+            Vector2i end = get_chunk_origin(tile_map, chunk_x + 1, chunk_y + 1);
+            if ((origin.x >= view_max.x) || (origin.y >= view_max.y) || (end.x <= view_min.x) ||
+                (end.y <= view_min.y)) {
+                continue;
+            }
+
+            Tile_Chunk *chunk = get_tile_chunk(cache, tile_map, chunk_x, chunk_y);
+            if (chunk->sprite.trim_max_y == 0) continue;
+
+            draw_sprite_at(window, &chunk->sprite, origin - view_min);
+        }
+    }
+}
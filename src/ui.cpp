@@ -5,6 +5,8 @@ struct Button {
     Vector2f position;
     bool is_pressed;
     bool is_hovered;
+    // Alleen als dit aan staat tekenen we de knop, zie draw_menu_screen.
+    bool needs_redraw;
     Sound select_sound;
 };
 
@@ -18,6 +20,12 @@ void update_button(Engine *engine, Button *button) {
     cursor.y = window_dim.bottom - cursor.y;
     cursor.x = cursor.x - window_dim.left;
 
+    // Knoppen staan in design pixels, het venster kan groter of kleiner zijn.
+    i32 window_width = maximum(window_dim.right - window_dim.left, 1);
+    i32 window_height = maximum(window_dim.bottom - window_dim.top, 1);
+    cursor.x = cursor.x * DESIGN_WIDTH / window_width;
+    cursor.y = cursor.y * DESIGN_HEIGHT / window_height;
+
     HCURSOR normal_cursor = LoadCursorA(0, IDC_ARROW);
     HCURSOR click_cursor = LoadCursorA(0, IDC_HAND);
 
@@ -26,6 +34,9 @@ void update_button(Engine *engine, Button *button) {
         (cursor.y > button->position.y - button->half_height) &&
         (cursor.y < button->position.y + button->half_height)) {
 
+        if (!button->is_hovered) {
+            button->needs_redraw = true;
+        }
         button->is_hovered = true;
         SetCursor(click_cursor);
 
@@ -38,8 +49,12 @@ void update_button(Engine *engine, Button *button) {
         }
     } else if (button->is_hovered) {
         button->is_hovered = false;
+        button->needs_redraw = true;
         SetCursor(normal_cursor);
     }
 
-    draw_sprite(&engine->window, Vector2f(), &button->sprite, button->position);
+    if (button->needs_redraw) {
+        button->needs_redraw = false;
+        draw_sprite(&engine->window, Vector2f(), &button->sprite, button->position);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+// NOTE: Uitleg muur kernels.
+// Bij een botsing rekenen we voor elke muur van elke tile uit wanneer de speler hem raakt. Vroeger
+// deed test_wall dat muur voor muur, nu verzamelen we de muren eerst in een Wall_Batch en rekent
+// een kernel ze in een keer uit. De batch is een structure of arrays, zodat de SSE2 en AVX2
+// kernels 4 of 8 muren tegelijk kunnen laden. Net als bij de rij-kernels in blit.cpp is de scalar
+// kernel de referentie, en kiezen we bij het opstarten met initialize_wall_solver de snelste.
+//
+// Een kernel schrijft per muur alleen de tijd waarop de speler hem raakt, of WALL_MISS. Welke muur
+// het eerst geraakt wordt (t_lowest) bepaalt de aanroeper daarna zelf, in dezelfde volgorde als
+// vroeger. De kernels doen precies dezelfde berekeningen als de scalar kernel (delen, geen rcp,
+// en geen fma), dus er komt ook bit voor bit hetzelfde uit.
+#define MAX_BATCH_WALLS 512
+// Groter dan elke t_lowest, dus deze muur wordt nooit geraakt.
+#define WALL_MISS 2.0f
+
+struct Wall_Batch {
+    // De muur ligt op wall_coord en loopt van wall_min tot wall_max op de andere as. rel_x en rel_y
+    // zijn de positie van de speler ten opzichte van de tile, delta_x en delta_y de beweging. Bij
+    // een horizontale muur zijn x en y omgedraaid.
+    f32 wall_coord[MAX_BATCH_WALLS];
+    f32 wall_min[MAX_BATCH_WALLS];
+    f32 wall_max[MAX_BATCH_WALLS];
+    f32 rel_x[MAX_BATCH_WALLS];
+    f32 rel_y[MAX_BATCH_WALLS];
+    f32 delta_x[MAX_BATCH_WALLS];
+    f32 delta_y[MAX_BATCH_WALLS];
+
+    // Wat de kernel uitrekent.
+    f32 t[MAX_BATCH_WALLS];
+    u32 count;
+};
+
+typedef void Solve_Walls(Wall_Batch *batch);
+
+static void push_wall(Wall_Batch *batch, f32 wall_coord, f32 wall_min, f32 wall_max, f32 rel_x,
+                      f32 rel_y, f32 delta_x, f32 delta_y) {
+    u32 i = batch->count++;
+    batch->wall_coord[i] = wall_coord;
+    batch->wall_min[i] = wall_min;
+    batch->wall_max[i] = wall_max;
+    batch->rel_x[i] = rel_x;
+    batch->rel_y[i] = rel_y;
+    batch->delta_x[i] = delta_x;
+    batch->delta_y[i] = delta_y;
+}
+
+static void solve_wall_range(Wall_Batch *batch, u32 first, u32 end) {
+    for (u32 i = first; i < end; i++) {
+        f32 t = WALL_MISS;
+        if (batch->delta_x[i] != 0.0f) {
+            // Reken uit wanneer de speler de muur raakt coordinaat.
+            f32 t_result = (batch->wall_coord[i] - batch->rel_x[i]) / batch->delta_x[i];
+
+            // Check of de y coordinaat ook op de muur ligt.
+            f32 y = batch->rel_y[i] + t_result * batch->delta_y[i];
+            if ((t_result >= 0) && (y >= batch->wall_min[i]) && (y <= batch->wall_max[i])) {
+                t = t_result;
+            }
+        }
+        batch->t[i] = t;
+    }
+}
+
+static void solve_walls_scalar(Wall_Batch *batch) {
+    solve_wall_range(batch, 0, batch->count);
+}
+
+// Een masker van de muren die geraakt worden, daarmee kiezen we per muur t_result of WALL_MISS.
+// Waar delta_x 0 is wordt t_result inf of NaN, maar die vallen toch buiten het masker.
+static void solve_walls_sse2(Wall_Batch *batch) {
+    __m128 zero = _mm_setzero_ps();
+    __m128 miss = _mm_set1_ps(WALL_MISS);
+
+    u32 i = 0;
+    for (; i + 4 <= batch->count; i += 4) {
+        __m128 delta_x = _mm_loadu_ps(batch->delta_x + i);
+        __m128 t = _mm_div_ps(
+            _mm_sub_ps(_mm_loadu_ps(batch->wall_coord + i), _mm_loadu_ps(batch->rel_x + i)),
+            delta_x);
+        __m128 y = _mm_add_ps(_mm_loadu_ps(batch->rel_y + i),
+                              _mm_mul_ps(t, _mm_loadu_ps(batch->delta_y + i)));
+
+        __m128 hit = _mm_and_ps(_mm_cmpneq_ps(delta_x, zero), _mm_cmpge_ps(t, zero));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(y, _mm_loadu_ps(batch->wall_min + i)));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(y, _mm_loadu_ps(batch->wall_max + i)));
+        _mm_storeu_ps(batch->t + i, _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, miss)));
+    }
+
+    solve_wall_range(batch, i, batch->count);
+}
+
+// Hetzelfde als de SSE2 kernel, maar dan met 8 muren tegelijk.
+TARGET_AVX2 static void solve_walls_avx2(Wall_Batch *batch) {
+    __m256 zero = _mm256_setzero_ps();
+    __m256 miss = _mm256_set1_ps(WALL_MISS);
+
+    u32 i = 0;
+    for (; i + 8 <= batch->count; i += 8) {
+        __m256 delta_x = _mm256_loadu_ps(batch->delta_x + i);
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(batch->wall_coord + i),
+                                               _mm256_loadu_ps(batch->rel_x + i)),
+                                 delta_x);
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(batch->rel_y + i),
+                                 _mm256_mul_ps(t, _mm256_loadu_ps(batch->delta_y + i)));
+
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(delta_x, zero, _CMP_NEQ_UQ),
+                                   _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+        __m256 wall_min = _mm256_loadu_ps(batch->wall_min + i);
+        __m256 wall_max = _mm256_loadu_ps(batch->wall_max + i);
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(y, wall_min, _CMP_GE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(y, wall_max, _CMP_LE_OQ));
+        _mm256_storeu_ps(batch->t + i, _mm256_blendv_ps(miss, t, hit));
+    }
+
+    solve_wall_range(batch, i, batch->count);
+}
+
+static Solve_Walls *solve_walls = solve_walls_scalar;
+
+static void initialize_wall_solver() {
+    Cpu_Features features = get_cpu_features();
+    if (features.avx2) {
+        solve_walls = solve_walls_avx2;
+    } else if (features.sse2) {
+        solve_walls = solve_walls_sse2;
+    } else {
+        solve_walls = solve_walls_scalar;
+    }
+}
+
+#if PROFILE
+// Reken een volle batch willekeurige muren een paar duizend keer uit met elke kernel, laat zien
+// hoe lang dat per muur duurt, en of er hetzelfde uitkomt als bij de scalar kernel.
+static void benchmark_wall_kernels() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    static Wall_Batch batch;
+    batch.count = 0;
+    u32 random_state = 1;
+    for (u32 i = 0; i < MAX_BATCH_WALLS; i++) {
+        f32 values[7];
+        for (u32 j = 0; j < 7; j++) {
+            random_state = random_state * 1664525u + 1013904223u;
+            values[j] = (f32)(random_state >> 8) / (f32)(1 << 24) * 200.0f - 100.0f;
+        }
+        // Een op de acht muren staat stil, zodat die tak ook meedoet.
+        if ((i & 7) == 0) values[5] = 0.0f;
+        push_wall(&batch, values[0], minimum(values[1], values[2]), maximum(values[1], values[2]),
+                  values[3], values[4], values[5], values[6]);
+    }
+
+    f32 reference[MAX_BATCH_WALLS];
+    solve_walls_scalar(&batch);
+    memcpy(reference, batch.t, sizeof(reference));
+
+    Cpu_Features features = get_cpu_features();
+    const char *names[] = {"scalar", "sse2", "avx2"};
+    Solve_Walls *kernels[] = {solve_walls_scalar, solve_walls_sse2, solve_walls_avx2};
+    bool supported[] = {true, features.sse2, features.avx2};
+
+    for (u32 kernel = 0; kernel < 3; kernel++) {
+        if (!supported[kernel]) continue;
+
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        for (u32 run = 0; run < 4096; run++) {
+            kernels[kernel](&batch);
+        }
+        QueryPerformanceCounter(&end);
+
+        f64 ns = (f64)(end.QuadPart - start.QuadPart) * 1000000000.0 / (f64)frequency.QuadPart /
+                 (4096.0 * MAX_BATCH_WALLS);
+        bool same = memcmp(reference, batch.t, sizeof(reference)) == 0;
+        char text[256];
+        StringCbPrintfA(text, 256, "Muren %s: %.3fns per muur%s\n", names[kernel], ns,
+                        same ? "" : ", ANDERS DAN SCALAR!");
+        OutputDebugStringA(text);
+    }
+}
+#endif